@@ -0,0 +1,261 @@
+// CMSC 341 - Spring 2024 - Project 4
+#ifndef BASICVACDB_H
+#define BASICVACDB_H
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <string>
+#include <utility>
+using namespace std;
+const size_t BASICMINCAP = 16;      // smallest table, always a power of two
+const float BASICMAXLOAD = 0.7;     // live and deleted slots that trigger a rehash
+static_assert(sizeof(size_t) == 8, "hash tags and strides use the top bits of a 64-bit hash");
+
+// Probing policies of BasicVacDB. offset(hash, step) is added to the home
+// slot at each step of a probe and must visit every slot of a power-of-two
+// table within capacity steps.
+
+// consecutive slots
+struct LinearProbe{
+    static size_t offset(size_t, size_t step) {return step;}
+};
+
+// triangular numbers 0, 1, 3, 6, ..., a permutation of a power-of-two table
+struct QuadraticProbe{
+    static size_t offset(size_t, size_t step) {return step * (step + 1) / 2;}
+};
+
+// steps of an odd stride taken from the high bits of the hash
+struct DoubleHashProbe{
+    static size_t offset(size_t hash, size_t step) {return step * ((hash >> 32) | 1);}
+};
+
+// The textbook 33-multiplier hash of the tests as a functor, so the table
+// can inline it
+struct NameHash{
+    unsigned int operator()(const string& str) const {
+        unsigned int val = 0;
+        for (size_t i = 0; i < str.length(); i++)
+            val = val * 33 + str[i];
+        return val;
+    }
+};
+
+// Calls a hash_fn style function through its pointer, the way VacDB does
+template <class Key>
+struct FunctionHash{
+    unsigned int (*function)(Key);
+    unsigned int operator()(const Key& key) const {return function(key);}
+};
+
+// Open addressing engine of VacDB for any record type: staff badges,
+// vaccine lots, or patients. The hasher, the probing policy and the
+// allocator are template parameters, so hashing and probing inline into
+// every lookup. Entries are held by value in the slots. A slot's metadata
+// byte is EMPTY, DELETED or a 7-bit hash tag, which rejects most other
+// keys before they are compared. Keys are unique. Everything lives in
+// this header. VacDB is not an instance of it: its probing policy changes
+// at run time through changeProbPolicy, and the prefix and fuzzy
+// indexes hold Patient pointers that entries stored by value would move.
+template <class Key, class Value, class Hash = NameHash, class Policy = LinearProbe,
+          class Alloc = allocator<pair<Key, Value>>>
+class BasicVacDB{
+    public:
+    typedef pair<Key, Value> Entry;
+
+    explicit BasicVacDB(size_t size = BASICMINCAP, const Hash& hash = Hash(), const Alloc& alloc = Alloc());
+    ~BasicVacDB();
+    BasicVacDB(const BasicVacDB&) = delete;
+    BasicVacDB& operator=(const BasicVacDB&) = delete;
+
+    // Returns false if the key is stored already
+    bool insert(const Key& key, const Value& value);
+    bool remove(const Key& key);
+    // Returns the value stored with the key, or nullptr
+    Value* find(const Key& key);
+    const Value* find(const Key& key) const;
+    bool contains(const Key& key) const {return find(key) != nullptr;}
+    size_t size() const {return m_size;}
+    size_t capacity() const {return m_mask + 1;}
+    // Returns the share of slots that are live
+    float lambda() const {return float(m_size) / capacity();}
+    // Calls f(key, value) on every live entry, in slot order
+    template <class F> void forEach(F f) const;
+
+    private:
+    enum : uint8_t {EMPTY = 0, DELETED = 1};
+    struct Slot{
+        uint8_t meta;           // EMPTY, DELETED or 0x80 | hash tag
+        union {Entry entry;};   // constructed while the slot is live
+        Slot() : meta(EMPTY) {}
+        ~Slot() {}
+    };
+    typedef typename allocator_traits<Alloc>::template rebind_alloc<Slot> SlotAlloc;
+    typedef typename allocator_traits<Alloc>::template rebind_alloc<Entry> EntryAlloc;
+    typedef allocator_traits<SlotAlloc> SlotTraits;
+    typedef allocator_traits<EntryAlloc> EntryTraits;
+
+    Hash m_hash;
+    SlotAlloc m_slotAlloc;
+    EntryAlloc m_entryAlloc;
+    Slot* m_slots;
+    size_t m_mask;      // capacity - 1
+    size_t m_size;      // live slots
+    size_t m_deleted;   // deleted slots
+
+    size_t hashKey(const Key& key) const;
+    static uint8_t tagOf(size_t hash) {return uint8_t(0x80 | (hash >> 57));}
+    size_t findSlot(const Key& key, size_t hash) const;
+    Slot* allocate(size_t cap);
+    void release(Slot* slots, size_t cap);
+    void rehash(size_t cap);
+};
+
+template <class Key, class Value, class Hash, class Policy, class Alloc>
+BasicVacDB<Key, Value, Hash, Policy, Alloc>::BasicVacDB(size_t size, const Hash& hash, const Alloc& alloc)
+    : m_hash(hash), m_slotAlloc(alloc), m_entryAlloc(alloc), m_size(0), m_deleted(0) {
+    size_t cap = BASICMINCAP;
+    while (cap < size)
+        cap *= 2;
+    m_slots = allocate(cap);
+    m_mask = cap - 1;
+}
+
+template <class Key, class Value, class Hash, class Policy, class Alloc>
+BasicVacDB<Key, Value, Hash, Policy, Alloc>::~BasicVacDB() {
+    release(m_slots, capacity());
+}
+
+// The hasher's value scrambled with the 64-bit MurmurHash3 finalizer: the
+// low bits pick the home slot and the top seven bits make the tag
+template <class Key, class Value, class Hash, class Policy, class Alloc>
+size_t BasicVacDB<Key, Value, Hash, Policy, Alloc>::hashKey(const Key& key) const {
+    uint64_t hash = m_hash(key);
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return (size_t)hash;
+}
+
+// Returns the slot holding the key, or capacity() if it is not stored
+template <class Key, class Value, class Hash, class Policy, class Alloc>
+size_t BasicVacDB<Key, Value, Hash, Policy, Alloc>::findSlot(const Key& key, size_t hash) const {
+    const uint8_t tag = tagOf(hash);
+    const size_t home = hash & m_mask;
+    for (size_t step = 0; step <= m_mask; step++) {
+        size_t index = (home + Policy::offset(hash, step)) & m_mask;
+        const Slot& slot = m_slots[index];
+        if (slot.meta == EMPTY)
+            break;
+        if (slot.meta == tag && slot.entry.first == key)
+            return index;
+    }
+    return capacity();
+}
+
+template <class Key, class Value, class Hash, class Policy, class Alloc>
+bool BasicVacDB<Key, Value, Hash, Policy, Alloc>::insert(const Key& key, const Value& value) {
+    const size_t hash = hashKey(key);
+    if (findSlot(key, hash) != capacity())
+        return false;
+    if (m_size + m_deleted + 1 > capacity() * BASICMAXLOAD) {
+        // grow when live entries fill the table, otherwise only drop the tombstones
+        rehash((m_size + 1 > capacity() * BASICMAXLOAD / 2) ? capacity() * 2 : capacity());
+    }
+    // the key is absent, so the first slot that is not live takes it
+    const size_t home = hash & m_mask;
+    for (size_t step = 0; ; step++) {
+        Slot& slot = m_slots[(home + Policy::offset(hash, step)) & m_mask];
+        if (slot.meta & 0x80)
+            continue;
+        EntryTraits::construct(m_entryAlloc, &slot.entry, key, value);
+        m_deleted -= (slot.meta == DELETED);
+        slot.meta = tagOf(hash);
+        m_size++;
+        return true;
+    }
+}
+
+template <class Key, class Value, class Hash, class Policy, class Alloc>
+bool BasicVacDB<Key, Value, Hash, Policy, Alloc>::remove(const Key& key) {
+    size_t index = findSlot(key, hashKey(key));
+    if (index == capacity())
+        return false;
+    EntryTraits::destroy(m_entryAlloc, &m_slots[index].entry);
+    m_slots[index].meta = DELETED;
+    m_size--;
+    m_deleted++;
+    return true;
+}
+
+template <class Key, class Value, class Hash, class Policy, class Alloc>
+Value* BasicVacDB<Key, Value, Hash, Policy, Alloc>::find(const Key& key) {
+    size_t index = findSlot(key, hashKey(key));
+    return (index == capacity()) ? nullptr : &m_slots[index].entry.second;
+}
+
+template <class Key, class Value, class Hash, class Policy, class Alloc>
+const Value* BasicVacDB<Key, Value, Hash, Policy, Alloc>::find(const Key& key) const {
+    size_t index = findSlot(key, hashKey(key));
+    return (index == capacity()) ? nullptr : &m_slots[index].entry.second;
+}
+
+template <class Key, class Value, class Hash, class Policy, class Alloc>
+template <class F>
+void BasicVacDB<Key, Value, Hash, Policy, Alloc>::forEach(F f) const {
+    for (size_t index = 0; index <= m_mask; index++) {
+        if (m_slots[index].meta & 0x80)
+            f(m_slots[index].entry.first, m_slots[index].entry.second);
+    }
+}
+
+// allocates a table of cap empty slots
+template <class Key, class Value, class Hash, class Policy, class Alloc>
+typename BasicVacDB<Key, Value, Hash, Policy, Alloc>::Slot*
+BasicVacDB<Key, Value, Hash, Policy, Alloc>::allocate(size_t cap) {
+    Slot* slots = SlotTraits::allocate(m_slotAlloc, cap);
+    for (size_t index = 0; index < cap; index++)
+        SlotTraits::construct(m_slotAlloc, slots + index);
+    return slots;
+}
+
+// destroys the live entries of a table and frees it
+template <class Key, class Value, class Hash, class Policy, class Alloc>
+void BasicVacDB<Key, Value, Hash, Policy, Alloc>::release(Slot* slots, size_t cap) {
+    for (size_t index = 0; index < cap; index++) {
+        if (slots[index].meta & 0x80)
+            EntryTraits::destroy(m_entryAlloc, &slots[index].entry);
+        SlotTraits::destroy(m_slotAlloc, slots + index);
+    }
+    SlotTraits::deallocate(m_slotAlloc, slots, cap);
+}
+
+// moves the live entries into a new table of cap slots, dropping the tombstones
+template <class Key, class Value, class Hash, class Policy, class Alloc>
+void BasicVacDB<Key, Value, Hash, Policy, Alloc>::rehash(size_t cap) {
+    Slot* old = m_slots;
+    size_t oldCap = capacity();
+    m_slots = allocate(cap);
+    m_mask = cap - 1;
+    for (size_t index = 0; index < oldCap; index++) {
+        if (!(old[index].meta & 0x80))
+            continue;
+        Entry& entry = old[index].entry;
+        const size_t hash = hashKey(entry.first);
+        const size_t home = hash & m_mask;
+        for (size_t step = 0; ; step++) {
+            Slot& slot = m_slots[(home + Policy::offset(hash, step)) & m_mask];
+            if (slot.meta == EMPTY) {
+                EntryTraits::construct(m_entryAlloc, &slot.entry, std::move(entry));
+                slot.meta = tagOf(hash);
+                break;
+            }
+        }
+    }
+    m_deleted = 0;
+    release(old, oldCap);
+}
+#endif
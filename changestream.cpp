@@ -0,0 +1,209 @@
+// CMSC 341 - Spring 2024 - Project 4
+#include "changestream.h"
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+ChangeStream::ChangeStream()
+    : m_header(nullptr), m_ring(nullptr), m_mask(0), m_head(0), m_tailCache(0), m_length(0) {}
+
+
+ChangeStream::~ChangeStream() {
+    close();
+}
+
+
+/**
+ * Name: open
+ * Desc: Creates the shared memory segment with a StreamHeader in front of the ring. A segment
+ *       left by a primary that crashed is unlinked first, so a standby still attached to it
+ *       keeps its old view and never sees this one.
+ * Preconditions: name is a valid shm_open name without the leading slash.
+ * Postconditions: Returns false, leaving the stream closed, if the segment cannot be made.
+ */
+bool ChangeStream::open(const string& name, size_t bytes) {
+    close();
+    uint64_t capacity = 4096;
+    while (capacity < bytes)
+        capacity *= 2;
+    string path = "/" + name;
+    shm_unlink(path.c_str());
+    int fd = shm_open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) return false;
+    size_t length = sizeof(StreamHeader) + capacity;
+    void* base = MAP_FAILED;
+    if (ftruncate(fd, length) == 0)
+        base = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        shm_unlink(path.c_str());
+        return false;
+    }
+    // the fresh segment is zero, the magic is written last so a reader never sees half a header
+    m_header = (StreamHeader*)base;
+    m_header->version = STREAMVERSION;
+    m_header->capacity = capacity;
+    atomic_thread_fence(memory_order_release);
+    m_header->magic = STREAMMAGIC;
+    m_ring = (char*)base + sizeof(StreamHeader);
+    m_mask = capacity - 1;
+    m_head = 0;
+    m_tailCache = 0;
+    m_length = length;
+    m_name = path;
+    return true;
+}
+
+
+/**
+ * Name: publish
+ * Desc: Copies a record and its name into the ring, in two pieces when it wraps, then
+ *       publishes it with a release store of head. The tail of the standby is read only when
+ *       the cached value says the ring is full, so the primary rarely touches that cache line.
+ * Preconditions: Called from one thread at a time.
+ * Postconditions: Returns false and marks the stream lost if the record does not fit.
+ */
+bool ChangeStream::publish(trace_t op, const string& name, int serial, long long arg, bool outcome) {
+    if (m_header == nullptr || m_header->lost.load(memory_order_relaxed))
+        return false;
+    uint16_t length = (uint16_t)min<size_t>(name.size(), UINT16_MAX);
+    TraceRecord record = {(uint8_t)op, (uint8_t)outcome, length, serial, arg};
+    const uint64_t bytes = sizeof(record) + length;
+    if (m_head + bytes - m_tailCache > m_mask + 1) {
+        m_tailCache = m_header->tail.load(memory_order_acquire);
+        if (m_head + bytes - m_tailCache > m_mask + 1) {
+            m_header->lost.store(1, memory_order_release);
+            return false;
+        }
+    }
+    copyIn(m_head, &record, sizeof(record));
+    copyIn(m_head + sizeof(record), name.data(), length);
+    m_head += bytes;
+    m_header->head.store(m_head, memory_order_release);
+    return true;
+}
+
+
+// copies bytes into the ring at stream position to, in two pieces when it wraps
+void ChangeStream::copyIn(uint64_t to, const void* from, size_t bytes) {
+    uint64_t at = to & m_mask;
+    size_t first = min<uint64_t>(bytes, m_mask + 1 - at);
+    memcpy(m_ring + at, from, first);
+    memcpy(m_ring, (const char*)from + first, bytes - first);
+}
+
+
+void ChangeStream::close() {
+    if (m_header == nullptr) return;
+    m_header->closed.store(1, memory_order_release);
+    munmap(m_header, m_length);
+    shm_unlink(m_name.c_str());
+    m_header = nullptr;
+    m_ring = nullptr;
+}
+
+
+uint64_t ChangeStream::backlog() const {
+    if (m_header == nullptr) return 0;
+    return m_head - m_header->tail.load(memory_order_acquire);
+}
+
+
+ChangeReader::ChangeReader()
+    : m_header(nullptr), m_ring(nullptr), m_mask(0), m_tail(0), m_headCache(0), m_length(0) {}
+
+
+ChangeReader::~ChangeReader() {
+    if (m_header != nullptr)
+        munmap(m_header, m_length);
+}
+
+
+/**
+ * Name: open
+ * Desc: Maps the segment of a running primary and checks its header. The reader starts at
+ *       the first record, so the primary's OPEN and SEED records come first.
+ * Preconditions: No other reader consumes the same stream.
+ * Postconditions: Returns false if the segment is missing or is not a change stream.
+ */
+bool ChangeReader::open(const string& name) {
+    string path = "/" + name;
+    int fd = shm_open(path.c_str(), O_RDWR, 0);
+    if (fd < 0) return false;
+    struct stat info;
+    void* base = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && (size_t)info.st_size > sizeof(StreamHeader))
+        base = mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) return false;
+    // the magic is written last, so it is read first and the fields behind it after the fence
+    StreamHeader* header = (StreamHeader*)base;
+    uint32_t magic = header->magic;
+    atomic_thread_fence(memory_order_acquire);
+    uint64_t capacity = header->capacity;
+    if (magic != STREAMMAGIC || header->version != STREAMVERSION ||
+        sizeof(StreamHeader) + capacity != (size_t)info.st_size) {
+        munmap(base, info.st_size);
+        return false;
+    }
+    if (m_header != nullptr)
+        munmap(m_header, m_length);
+    m_header = header;
+    m_ring = (const char*)base + sizeof(StreamHeader);
+    m_mask = capacity - 1;
+    m_tail = header->tail.load(memory_order_acquire);
+    m_headCache = m_tail;
+    m_length = info.st_size;
+    return true;
+}
+
+
+// copies bytes of the ring starting at stream position from, in two pieces when it wraps
+void ChangeReader::copyOut(uint64_t from, void* to, size_t bytes) const {
+    uint64_t at = from & m_mask;
+    size_t first = min<uint64_t>(bytes, m_mask + 1 - at);
+    memcpy(to, m_ring + at, first);
+    memcpy((char*)to + first, m_ring, bytes - first);
+}
+
+
+/**
+ * Name: next
+ * Desc: Decodes the record at the tail and hands its bytes back to the primary with a
+ *       release store of tail. head is read with acquire only when the cached value is
+ *       reached, which also makes the record bytes visible.
+ * Preconditions: open returned true.
+ * Postconditions: Returns false, leaving entry alone, if no record is waiting.
+ */
+bool ChangeReader::next(TraceEntry& entry) {
+    if (m_header == nullptr) return false;
+    if (m_tail == m_headCache) {
+        m_headCache = m_header->head.load(memory_order_acquire);
+        if (m_tail == m_headCache) return false;
+    }
+    TraceRecord record;
+    copyOut(m_tail, &record, sizeof(record));
+    entry.op = (trace_t)record.op;
+    entry.outcome = record.outcome != 0;
+    entry.name.resize(record.nameLength);
+    copyOut(m_tail + sizeof(record), &entry.name[0], record.nameLength);
+    entry.serial = record.serial;
+    entry.arg = record.arg;
+    m_tail += sizeof(record) + record.nameLength;
+    m_header->tail.store(m_tail, memory_order_release);
+    return true;
+}
+
+
+bool ChangeReader::closed() const {
+    if (m_header == nullptr) return true;
+    bool stopped = m_header->closed.load(memory_order_acquire) || m_header->lost.load(memory_order_acquire);
+    return stopped && m_tail == m_header->head.load(memory_order_acquire);
+}
+
+
+bool ChangeReader::lost() const {
+    return m_header != nullptr && m_header->lost.load(memory_order_acquire);
+}
@@ -0,0 +1,93 @@
+// CMSC 341 - Spring 2024 - Project 4
+#ifndef CHANGESTREAM_H
+#define CHANGESTREAM_H
+#include "tracelog.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+using namespace std;
+const size_t STREAMBYTES = 64 << 20;        // default ring size, a power of two
+const uint32_t STREAMMAGIC = 0x5253564d;    // "MVSR"
+const uint32_t STREAMVERSION = 5;      // 2 carries 64-bit deadlines, 3 WHEEL records,
+                                        // 4 exact serials for removes and updates,
+                                        // 5 MAXLOAD, BOOK and the removals of expire
+
+// Start of the shared memory segment. head and tail count bytes since the
+// stream opened and sit on their own cache lines, since only the primary
+// writes head and only the standby writes tail.
+struct StreamHeader{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;                      // bytes of the ring that follows, a power of two
+    alignas(64) atomic<uint64_t> head;      // bytes published
+    atomic<uint32_t> lost;                  // set when the ring overflowed, records were dropped
+    atomic<uint32_t> closed;                // set when the primary stopped the stream
+    alignas(64) atomic<uint64_t> tail;      // bytes consumed
+};
+
+// Primary end of a change stream: a single-producer, single-consumer ring
+// of trace records (tracelog.h) in a POSIX shared memory segment. Publishing
+// copies the record into the ring and moves head with a release store; it
+// never waits. When the standby falls a whole ring behind, the stream is
+// marked lost and publishing stops, so a dead standby cannot stall the
+// primary. The standby then has to be seeded again.
+class ChangeStream{
+    public:
+    ChangeStream();
+    ~ChangeStream();
+    ChangeStream(const ChangeStream&) = delete;
+    ChangeStream& operator=(const ChangeStream&) = delete;
+    // creates the segment /name of bytes rounded up to a power of two,
+    // replacing any left by an earlier primary
+    // Returns false if it cannot be created or mapped
+    bool open(const string& name, size_t bytes = STREAMBYTES);
+    // Returns false if the record was dropped because the ring is full or lost
+    bool publish(trace_t op, const string& name, int serial, long long arg, bool outcome);
+    // marks the stream closed, unmaps and unlinks the segment
+    void close();
+    bool lost() const {return m_header != nullptr && m_header->lost.load(memory_order_relaxed);}
+    // bytes published and not consumed yet
+    uint64_t backlog() const;
+
+    private:
+    StreamHeader* m_header;
+    char* m_ring;
+    uint64_t m_mask;        // capacity - 1
+    uint64_t m_head;        // private copy of head
+    uint64_t m_tailCache;   // tail as last read, refreshed only when the ring looks full
+    size_t m_length;        // bytes mapped
+    string m_name;
+
+    void copyIn(uint64_t to, const void* from, size_t bytes);
+};
+
+// Standby end of a change stream
+class ChangeReader{
+    public:
+    ChangeReader();
+    ~ChangeReader();
+    ChangeReader(const ChangeReader&) = delete;
+    ChangeReader& operator=(const ChangeReader&) = delete;
+    // maps the segment /name of a running primary
+    // Returns false if there is none
+    bool open(const string& name);
+    // takes the next record without waiting
+    // Returns false if none is published yet
+    bool next(TraceEntry& entry);
+    // true once every record before a close or an overflow was read
+    bool closed() const;
+    bool lost() const;
+    // bytes consumed so far
+    uint64_t position() const {return m_tail;}
+
+    private:
+    StreamHeader* m_header;
+    const char* m_ring;
+    uint64_t m_mask;
+    uint64_t m_tail;        // private copy of tail
+    uint64_t m_headCache;   // head as last read, refreshed only when it is reached
+    size_t m_length;
+
+    void copyOut(uint64_t from, void* to, size_t bytes) const;
+};
+#endif
@@ -0,0 +1,226 @@
+// CMSC 341 - Spring 2024 - Project 4
+#include "compactdb.h"
+#include <cstring>
+
+const uint64_t MAXARENA = 0xffffffffULL;    // offsets are 32 bits
+
+// slot state and hash tag of an entry
+static inline int state(uint16_t meta) {return meta & 3;}
+static inline uint16_t tagOf(unsigned int hash) {return (uint16_t)((hash >> 18) << 2);}
+
+/**
+ * Name: CompactVacDB Constructor
+ * Desc: Creates an empty table of at least size slots, rounded up to a power of two.
+ * Preconditions: hash is a valid hash function.
+ * Postconditions: The table and the arena are empty.
+ */
+CompactVacDB::CompactVacDB(int size, hash_fn hash)
+    : m_hash(hash), m_size(0), m_deleted(0), m_deadBytes(0) {
+    size_t cap = COMPACTMINCAP;
+    while (cap < (size_t)size)
+        cap *= 2;
+    m_table.assign(cap, Entry{0, 0, EMPTY});
+}
+
+
+// the user hash, mixed so that its low bits can pick the home slot
+// (MurmurHash3 fmix32)
+unsigned int CompactVacDB::hashName(const string& name) const {
+    unsigned int hash = m_hash(name);
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6b;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+
+// reads the varint length of the name at offset and moves offset to its first byte
+size_t CompactVacDB::readLength(uint32_t& offset) const {
+    size_t length = 0;
+    unsigned char byte;
+    int shift = 0;
+    do {
+        byte = m_arena[offset++];
+        length |= (size_t)(byte & 127) << shift;
+        shift += 7;
+    } while (byte >= 128);
+    return length;
+}
+
+
+// Returns the number of arena bytes of the name at offset, prefix included
+size_t CompactVacDB::nameBytes(uint32_t offset) const {
+    uint32_t start = offset;
+    size_t length = readLength(offset);
+    return offset - start + length;
+}
+
+
+string CompactVacDB::nameAt(uint32_t offset) const {
+    size_t length = readLength(offset);
+    return string(&m_arena[offset], length);
+}
+
+
+bool CompactVacDB::nameEquals(uint32_t offset, const string& name) const {
+    size_t length = readLength(offset);
+    return length == name.size() && memcmp(&m_arena[offset], name.data(), length) == 0;
+}
+
+
+/**
+ * Name: appendName
+ * Desc: Appends a name to an arena as a varint length followed by its bytes.
+ * Preconditions: None.
+ * Postconditions: Returns false, leaving the arena unchanged, if it would pass MAXARENA bytes.
+ */
+bool CompactVacDB::appendName(const string& name, vector<char>& arena, uint32_t& offset) const {
+    if (arena.size() + name.size() + 5 > MAXARENA)
+        return false;
+    offset = (uint32_t)arena.size();
+    size_t length = name.size();
+    do {
+        arena.push_back((char)((length & 127) | (length > 127 ? 128 : 0)));
+        length >>= 7;
+    } while (length > 0);
+    arena.insert(arena.end(), name.begin(), name.end());
+    return true;
+}
+
+
+/**
+ * Name: find
+ * Desc: Walks the probe sequence from the home slot until an empty slot. The hash tag is
+ *       compared before the arena is read.
+ * Preconditions: hash is hashName(name).
+ * Postconditions: Returns the slot of a live entry with the name and serial, where serial 0
+ *                 matches any serial, or -1.
+ */
+int CompactVacDB::find(const string& name, int serial, unsigned int hash) const {
+    const size_t mask = m_table.size() - 1;
+    const uint16_t tag = tagOf(hash);
+    for (size_t index = hash & mask; ; index = (index + 1) & mask) {
+        const Entry& entry = m_table[index];
+        if (state(entry.meta) == EMPTY)
+            return -1;
+        if (entry.meta == (tag | LIVE) && (serial == 0 || entry.serial == serial - MINID)
+            && nameEquals(entry.name, name))
+            return (int)index;
+    }
+}
+
+
+/**
+ * Name: insert
+ * Desc: Stores the patient in the first empty or deleted slot of its probe sequence and
+ *       rehashes once live and deleted entries pass COMPACTMAXLOAD.
+ * Preconditions: None.
+ * Postconditions: Returns false if the serial is out of range, the patient is already stored
+ *                 or the arena is full.
+ */
+bool CompactVacDB::insert(Patient patient) {
+    if (patient.getSerial() < MINID || patient.getSerial() > MAXID)
+        return false;
+    unsigned int hash = hashName(patient.getKey());
+    if (find(patient.getKey(), patient.getSerial(), hash) != -1)
+        return false;
+    uint32_t offset;
+    if (!appendName(patient.getKey(), m_arena, offset))
+        return false;
+
+    const size_t mask = m_table.size() - 1;
+    size_t index = hash & mask;
+    while (state(m_table[index].meta) == LIVE)
+        index = (index + 1) & mask;
+    if (state(m_table[index].meta) == DELETED)
+        m_deleted--;
+    m_table[index] = Entry{offset, (uint16_t)(patient.getSerial() - MINID), (uint16_t)(tagOf(hash) | LIVE)};
+    m_size++;
+
+    if (lambda() > COMPACTMAXLOAD) {
+        // grow when live entries fill half the threshold, otherwise only purge tombstones
+        size_t cap = m_table.size();
+        if (m_size > cap * COMPACTMAXLOAD / 2)
+            cap *= 2;
+        rehash(cap);
+    }
+    return true;
+}
+
+
+/**
+ * Name: remove
+ * Desc: Marks the first live entry with the name deleted. Its arena bytes stay until the
+ *       next rehash.
+ * Preconditions: None.
+ * Postconditions: Returns false if no patient has the name.
+ */
+bool CompactVacDB::remove(Patient patient) {
+    int index = find(patient.getKey(), 0, hashName(patient.getKey()));
+    if (index == -1)
+        return false;
+    m_deadBytes += nameBytes(m_table[index].name);
+    m_table[index].meta = (m_table[index].meta & ~3) | DELETED;
+    m_size--;
+    m_deleted++;
+    return true;
+}
+
+
+const Patient CompactVacDB::getPatient(string name, int serial) const {
+    int index = find(name, serial, hashName(name));
+    if (index == -1)
+        return Patient();
+    return Patient(nameAt(m_table[index].name), m_table[index].serial + MINID, true);
+}
+
+
+bool CompactVacDB::updateSerialNumber(Patient patient, int serial) {
+    if (serial < MINID || serial > MAXID)
+        return false;
+    int index = find(patient.getKey(), 0, hashName(patient.getKey()));
+    if (index == -1)
+        return false;
+    m_table[index].serial = (uint16_t)(serial - MINID);
+    return true;
+}
+
+
+float CompactVacDB::lambda() const {
+    return float(m_size + m_deleted) / m_table.size();
+}
+
+
+size_t CompactVacDB::memoryUsage() const {
+    return sizeof(CompactVacDB) + m_table.capacity() * sizeof(Entry) + m_arena.capacity();
+}
+
+
+/**
+ * Name: rehash
+ * Desc: Moves the live entries into a table of cap slots and copies their names into a fresh
+ *       arena, which drops the tombstones and the bytes of deleted names.
+ * Preconditions: cap is a power of two larger than the number of live entries.
+ * Postconditions: m_deleted and m_deadBytes are 0.
+ */
+void CompactVacDB::rehash(size_t cap) {
+    vector<Entry> table(cap, Entry{0, 0, EMPTY});
+    vector<char> arena;
+    arena.reserve(m_arena.size() - m_deadBytes);
+    const size_t mask = cap - 1;
+    for (const Entry& entry : m_table) {
+        if (state(entry.meta) != LIVE) continue;
+        string name = nameAt(entry.name);
+        size_t index = hashName(name) & mask;
+        while (state(table[index].meta) == LIVE)
+            index = (index + 1) & mask;
+        table[index] = entry;
+        appendName(name, arena, table[index].name);
+    }
+    m_table.swap(table);
+    m_arena.swap(arena);
+    m_deleted = 0;
+    m_deadBytes = 0;
+}
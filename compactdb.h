@@ -0,0 +1,59 @@
+// CMSC 341 - Spring 2024 - Project 4
+#ifndef COMPACTDB_H
+#define COMPACTDB_H
+#include "vacdb.h"
+#include <cstdint>
+const float COMPACTMAXLOAD = 0.8;   // live and deleted entries that trigger a rehash
+const int COMPACTMINCAP = 16;       // smallest table, always a power of two
+static_assert(MAXID - MINID < 65536, "serial offsets must fit in 16 bits");
+
+// Memory-lean variant of VacDB for very large registries. A slot is an
+// 8-byte Entry held by value: the name is a 32-bit offset into one shared
+// arena of length-prefixed names, the serial a 16-bit offset from MINID,
+// and the slot state sits in two bits next to a 14-bit hash tag that
+// rejects most mismatches without reading the arena. The table is linear
+// probed with a power-of-two capacity. Lookups follow VacDB: entries are
+// keyed by name and serial, and remove and updateSerialNumber match the
+// name with any serial.
+class CompactVacDB{
+    public:
+    friend class Tester;
+    CompactVacDB(int size, hash_fn hash);
+    // Returns false if the serial is out of range, the patient is stored
+    // already or the arena would pass 4 GB
+    bool insert(Patient patient);
+    bool remove(Patient patient);
+    const Patient getPatient(string name, int serial) const;
+    // Returns false if the patient is not found or serial is out of range
+    bool updateSerialNumber(Patient patient, int serial);
+    // Returns the share of slots that are live or deleted
+    float lambda() const;
+    int size() const {return m_size;}
+    // Returns the number of bytes of the table and the arena
+    size_t memoryUsage() const;
+
+    private:
+    struct Entry{
+        uint32_t name;      // offset of the name in m_arena
+        uint16_t serial;    // serial - MINID
+        uint16_t meta;      // slot state in bits 0-1, hash tag in bits 2-15
+    };
+    enum {EMPTY = 0, LIVE = 1, DELETED = 2};
+
+    hash_fn m_hash;
+    vector<Entry> m_table;
+    vector<char> m_arena;   // every name as a varint length and its bytes
+    int m_size;             // live entries
+    int m_deleted;          // deleted entries
+    uint64_t m_deadBytes;   // arena bytes of deleted names, reclaimed by rehash
+
+    unsigned int hashName(const string& name) const;
+    int find(const string& name, int serial, unsigned int hash) const;
+    size_t readLength(uint32_t& offset) const;
+    bool nameEquals(uint32_t offset, const string& name) const;
+    string nameAt(uint32_t offset) const;
+    size_t nameBytes(uint32_t offset) const;
+    bool appendName(const string& name, vector<char>& arena, uint32_t& offset) const;
+    void rehash(size_t cap);
+};
+#endif
@@ -0,0 +1,164 @@
+// CMSC 341 - Spring 2024 - Project 4
+#include "exportwriter.h"
+#include <cerrno>
+#include <charconv>
+#include <climits>
+#include <cstring>
+
+const size_t MAXIOV = IOV_MAX;  // iovecs a single writev accepts
+
+/**
+ * Name: ExportWriter Constructor
+ * Desc: Allocates the buffer once, it is reused for every batch.
+ * Preconditions: fd is open for writing and capacity is at least a few hundred bytes.
+ * Postconditions: Nothing is written until the buffer fills or flush is called.
+ */
+ExportWriter::ExportWriter(int fd, size_t capacity)
+    : m_fd(fd), m_buffer(capacity), m_used(0), m_bytes(0), m_failed(false) {
+    m_iov.reserve(MAXIOV);
+}
+
+
+ExportWriter::~ExportWriter() {
+    flush();
+}
+
+
+// Returns room for length bytes in the buffer, flushing first if they do not fit
+char* ExportWriter::reserve(size_t length) {
+    if (m_used + length > m_buffer.size() || m_iov.size() + 2 > MAXIOV)
+        flush();
+    return m_buffer.data() + m_used;
+}
+
+
+// queues the next length bytes of the buffer, extending the last iovec when they follow it
+void ExportWriter::commit(size_t length) {
+    char* start = m_buffer.data() + m_used;
+    if (!m_iov.empty() && (char*)m_iov.back().iov_base + m_iov.back().iov_len == start)
+        m_iov.back().iov_len += length;
+    else
+        m_iov.push_back({start, length});
+    m_used += length;
+}
+
+
+// queues bytes that live outside the buffer
+void ExportWriter::gather(const char* data, size_t length) {
+    if (m_iov.size() + 2 > MAXIOV)
+        flush();
+    m_iov.push_back({(void*)data, length});
+}
+
+
+/**
+ * Name: writeText
+ * Desc: Formats one tab separated line into the buffer. A name longer than the buffer is
+ *       written in place right away instead.
+ * Preconditions: None.
+ * Postconditions: The line is written at the latest by the next flush.
+ */
+void ExportWriter::writeText(const string& name, int serial, int slot) {
+    const size_t numbers = 2 * 12 + 3;
+    char* out;
+    if (name.size() + numbers > m_buffer.size()) {
+        gather(name.data(), name.size());
+        flush();
+        out = reserve(numbers);
+    } else {
+        out = reserve(name.size() + numbers);
+        memcpy(out, name.data(), name.size());
+        commit(name.size());
+        out += name.size();
+    }
+    char* start = out;
+    *out++ = '\t';
+    out = to_chars(out, out + 12, serial).ptr;
+    *out++ = '\t';
+    out = to_chars(out, out + 12, slot).ptr;
+    *out++ = '\n';
+    commit(out - start);
+}
+
+
+void ExportWriter::writeHeader() {
+    ExportHeader header = {EXPORTMAGIC, EXPORTVERSION};
+    memcpy(reserve(sizeof(header)), &header, sizeof(header));
+    commit(sizeof(header));
+}
+
+
+/**
+ * Name: writeBinary
+ * Desc: Copies the fixed part of a record into the buffer. The name is copied as well when it is
+ *       short, since an iovec per name would cost more than the copy. Longer names are gathered.
+ * Preconditions: A gathered name is neither changed nor freed before the next flush.
+ * Postconditions: The record is written at the latest by the next flush.
+ */
+void ExportWriter::writeBinary(const string& name, int serial, int slot) {
+    ExportRecord record = {serial, slot, (uint32_t)name.size()};
+    if (name.size() < GATHERMIN) {
+        char* out = reserve(sizeof(record) + name.size());
+        memcpy(out, &record, sizeof(record));
+        memcpy(out + sizeof(record), name.data(), name.size());
+        commit(sizeof(record) + name.size());
+    } else {
+        memcpy(reserve(sizeof(record)), &record, sizeof(record));
+        commit(sizeof(record));
+        gather(name.data(), name.size());
+    }
+}
+
+
+/**
+ * Name: write
+ * Desc: Copies raw bytes into the buffer. Data longer than the buffer is written in place
+ *       right away instead.
+ * Preconditions: None.
+ * Postconditions: The bytes are written at the latest by the next flush.
+ */
+void ExportWriter::write(const char* data, size_t length) {
+    if (length == 0) {
+        return;     // data may be the null pointer of an empty vector
+    }
+    if (length > m_buffer.size()) {
+        gather(data, length);
+        flush();
+        return;
+    }
+    memcpy(reserve(length), data, length);
+    commit(length);
+}
+
+
+/**
+ * Name: flush
+ * Desc: Hands the queued iovecs to writev, IOV_MAX at a time, and resumes after short writes.
+ * Preconditions: None.
+ * Postconditions: The buffer is empty. Returns false if this or an earlier write failed.
+ */
+bool ExportWriter::flush() {
+    size_t first = 0;
+    while (!m_failed && first < m_iov.size()) {
+        int count = (int)min(m_iov.size() - first, MAXIOV);
+        ssize_t written = writev(m_fd, &m_iov[first], count);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            m_failed = true;
+            break;
+        }
+        m_bytes += written;
+        // skip what was written, the last iovec may be cut
+        while (first < m_iov.size() && (size_t)written >= m_iov[first].iov_len) {
+            written -= m_iov[first].iov_len;
+            first++;
+        }
+        if (written > 0) {
+            m_iov[first].iov_base = (char*)m_iov[first].iov_base + written;
+            m_iov[first].iov_len -= written;
+        }
+    }
+    m_iov.clear();
+    m_used = 0;
+    return !m_failed;
+}
@@ -0,0 +1,62 @@
+// CMSC 341 - Spring 2024 - Project 4
+#ifndef EXPORTWRITER_H
+#define EXPORTWRITER_H
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <sys/uio.h>
+using namespace std;
+
+const size_t EXPORTBUFFER = 1 << 20;        // bytes gathered before each system call
+const size_t GATHERMIN = 64;                // names at least this long are not copied
+const uint32_t EXPORTMAGIC = 0x4244564d;    // "MVDB" in a little endian file
+const uint32_t EXPORTVERSION = 1;
+
+// Start of a binary export
+struct ExportHeader{
+    uint32_t magic;
+    uint32_t version;
+};
+
+// Fixed part of a binary record, followed by nameLength bytes of name
+struct ExportRecord{
+    int32_t serial;
+    int32_t slot;
+    uint32_t nameLength;
+};
+
+// Streams export output to a file descriptor through one large user-space
+// buffer. Text lines are formatted straight into the buffer. Binary records
+// are gathered with writev: the fixed parts and short names are copied into
+// the buffer, long names are written from where they are stored, so they
+// must stay alive until the next flush. Write errors are sticky.
+class ExportWriter{
+    public:
+    ExportWriter(int fd, size_t capacity = EXPORTBUFFER);
+    // flushes what is left
+    ~ExportWriter();
+    // appends "name<TAB>serial<TAB>slot\n"
+    void writeText(const string& name, int serial, int slot);
+    void writeHeader();
+    void writeBinary(const string& name, int serial, int slot);
+    // appends raw bytes, for other binary formats sharing the writer
+    void write(const char* data, size_t length);
+    // Returns false if a write failed
+    bool flush();
+    // Returns the number of bytes written so far, or -1 after a write error
+    long long bytes() const {return m_failed ? -1 : m_bytes;}
+
+    private:
+    int m_fd;
+    vector<char> m_buffer;  // never grows, so the iovecs into it stay valid
+    size_t m_used;
+    vector<iovec> m_iov;    // pending output in order, pieces of m_buffer and long names
+    long long m_bytes;
+    bool m_failed;
+
+    char* reserve(size_t length);
+    void commit(size_t length);
+    void gather(const char* data, size_t length);
+};
+#endif
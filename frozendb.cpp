@@ -0,0 +1,338 @@
+// CMSC 341 - Spring 2024 - Project 4
+#include "frozendb.h"
+#include <algorithm>
+#include <cstring>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Sizes of the parts of a saved snapshot, after its ExportHeader
+struct FrozenHeader{
+    uint64_t records;
+    uint64_t levels;
+    uint64_t bitWords;
+    uint64_t fallback;
+    uint64_t arena;
+};
+
+// MurmurHash3 fmix64
+static inline uint64_t mix64(uint64_t hash) {
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+// bit of a key on a level of size bits, by multiply and shift instead of a division
+static inline uint64_t levelBit(uint64_t hash, size_t level, uint64_t size) {
+    uint64_t mixed = mix64(hash + (level + 1) * 0x9e3779b97f4a7c15ULL);
+    return (uint64_t)(((unsigned __int128)mixed * size) >> 64);
+}
+
+static inline bool testBit(const vector<uint64_t>& bits, uint64_t bit) {
+    return (bits[bit >> 6] >> (bit & 63)) & 1;
+}
+
+static inline void setBit(vector<uint64_t>& bits, uint64_t bit) {
+    bits[bit >> 6] |= 1ULL << (bit & 63);
+}
+
+// reads exactly length bytes, Returns false at the end of the file or on an error
+static bool readAll(int fd, void* data, size_t length) {
+    char* out = static_cast<char*>(data);
+    while (length > 0) {
+        ssize_t n = read(fd, out, length);
+        if (n <= 0) return false;
+        out += n;
+        length -= n;
+    }
+    return true;
+}
+
+// reads count elements into out a chunk at a time, so sizes claimed by a damaged snapshot on a
+// pipe allocate no more than the data that actually arrives
+template <class T>
+static bool readArray(int fd, vector<T>& out, uint64_t count) {
+    const uint64_t step = max<uint64_t>(1, FROZENREADCHUNK / sizeof(T));
+    while (out.size() < count) {
+        size_t from = out.size();
+        out.resize(from + min(step, count - from));
+        if (!readAll(fd, out.data() + from, (out.size() - from) * sizeof(T)))
+            return false;
+    }
+    return true;
+}
+
+
+FrozenVacDB::FrozenVacDB() {}
+
+
+/**
+ * Name: FrozenVacDB Constructor
+ * Desc: Builds the levels of the minimal perfect hash over the live patients of db. Every level
+ *       hashes the keys that are left into FROZENGAMMA bits per key; keys that hit a bit alone
+ *       set it and stay there, the others go on to the next level. Once the ranks are known each
+ *       patient is copied to the record at its index and its name to the arena. Keys left after
+ *       FROZENMAXLEVELS levels, in practice only keys with equal 64-bit hashes, take the last
+ *       indexes and are found through the sorted fallback.
+ * Preconditions: db holds fewer than 2^32 patients and arena bytes.
+ * Postconditions: Every live patient of db is found by getPatient.
+ */
+FrozenVacDB::FrozenVacDB(const VacDB& db) {
+    struct Key{
+        uint64_t hash;
+        const Patient* patient;
+    };
+    vector<Key> keys;
+    size_t nameBytes = 0;
+    db.forEach([&](const Patient& patient) {
+        keys.push_back({keyHash(patient.m_name, patient.m_serial), &patient});
+        nameBytes += patient.m_name.size();
+    });
+
+    vector<Key> remaining(keys), next;
+    vector<uint64_t> seen, collided;
+    for (size_t level = 0; !remaining.empty() && level < (size_t)FROZENMAXLEVELS; level++) {
+        uint64_t size = ((uint64_t)(FROZENGAMMA * remaining.size()) + 63) / 64 * 64;
+        seen.assign(size / 64, 0);
+        collided.assign(size / 64, 0);
+        for (const Key& key : remaining) {
+            uint64_t bit = levelBit(key.hash, level, size);
+            if (testBit(seen, bit))
+                setBit(collided, bit);
+            setBit(seen, bit);
+        }
+        Level entry = {m_bits.size() * 64, size};
+        m_bits.resize(m_bits.size() + size / 64, 0);
+        next.clear();
+        for (const Key& key : remaining) {
+            uint64_t bit = levelBit(key.hash, level, size);
+            if (testBit(collided, bit))
+                next.push_back(key);
+            else
+                setBit(m_bits, entry.offset + bit);
+        }
+        m_levels.push_back(entry);
+        remaining.swap(next);
+    }
+    buildRanks();
+
+    // a collided bit is never set, so exactly the keys left are on no level
+    m_records.resize(keys.size());
+    m_arena.reserve(nameBytes);
+    auto store = [this](int index, const Patient& patient) {
+        m_records[index] = {(uint32_t)m_arena.size(), (uint32_t)patient.m_name.size(), patient.m_serial, patient.m_slot};
+        m_arena.insert(m_arena.end(), patient.m_name.begin(), patient.m_name.end());
+    };
+    for (const Key& key : keys) {
+        int index = position(key.hash);
+        if (index != -1)
+            store(index, *key.patient);
+    }
+    uint32_t placed = (uint32_t)(keys.size() - remaining.size());
+    for (const Key& key : remaining) {
+        m_fallback.push_back({key.hash, placed, 0});
+        store(placed++, *key.patient);
+    }
+    sort(m_fallback.begin(), m_fallback.end(), [](const Fallback& lhs, const Fallback& rhs) {
+        return lhs.hash < rhs.hash;
+    });
+}
+
+
+/**
+ * Name: getPatient
+ * Desc: Looks the key up with one record read.
+ * Preconditions: None.
+ * Postconditions: Returns a copy of the stored patient marked used, or an empty Patient.
+ */
+const Patient FrozenVacDB::getPatient(string name, int serial) const {
+    int index = find(name, serial);
+    if (index == -1)
+        return Patient();
+    return Patient(name, serial, true, m_records[index].slot);
+}
+
+
+// Returns the index of the record that may hold the key, or -1 if it is on
+// no level; the record still has to be compared
+int FrozenVacDB::position(uint64_t hash) const {
+    for (size_t level = 0; level < m_levels.size(); level++) {
+        uint64_t bit = m_levels[level].offset + levelBit(hash, level, m_levels[level].size);
+        if (testBit(m_bits, bit))
+            return (int)rank(bit);
+    }
+    return -1;
+}
+
+
+// Returns the index of the record of the key, or -1 if it is not stored
+int FrozenVacDB::find(const string& name, int serial) const {
+    uint64_t hash = keyHash(name, serial);
+    int index = position(hash);
+    if (index != -1)
+        return matches(index, name, serial) ? index : -1;
+    auto it = lower_bound(m_fallback.begin(), m_fallback.end(), hash,
+                          [](const Fallback& entry, uint64_t value) {return entry.hash < value;});
+    for (; it != m_fallback.end() && it->hash == hash; ++it) {
+        if (matches(it->index, name, serial))
+            return it->index;
+    }
+    return -1;
+}
+
+
+bool FrozenVacDB::matches(int index, const string& name, int serial) const {
+    const Record& record = m_records[index];
+    return record.serial == serial && record.length == name.size() &&
+           memcmp(m_arena.data() + record.name, name.data(), name.size()) == 0;
+}
+
+
+// Returns the number of set bits before a bit of m_bits
+uint64_t FrozenVacDB::rank(uint64_t bit) const {
+    uint64_t word = bit >> 6;
+    uint64_t count = m_ranks[word >> 3];
+    for (uint64_t w = word & ~7ULL; w < word; w++)
+        count += __builtin_popcountll(m_bits[w]);
+    return count + __builtin_popcountll(m_bits[word] & ((1ULL << (bit & 63)) - 1));
+}
+
+
+// counts the set bits before every block of 8 words
+void FrozenVacDB::buildRanks() {
+    m_ranks.assign(m_bits.size() / 8 + 1, 0);
+    uint32_t count = 0;
+    for (size_t word = 0; word < m_bits.size(); word++) {
+        if (word % 8 == 0)
+            m_ranks[word / 8] = count;
+        count += __builtin_popcountll(m_bits[word]);
+    }
+}
+
+
+/**
+ * Name: keyHash
+ * Desc: 64-bit hash of a name and serial, eight name bytes at a time (MurmurHash64A steps)
+ *       finished with fmix64. It does not depend on the user hash, whose 32 bits would give
+ *       equal hashes to some keys of a large table.
+ * Preconditions: None.
+ * Postconditions: Returns the hash.
+ */
+uint64_t FrozenVacDB::keyHash(const string& name, int serial) {
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    uint64_t hash = (uint64_t)(uint32_t)serial * 0x9e3779b97f4a7c15ULL ^ (name.size() * m);
+    size_t i = 0;
+    for (; i + 8 <= name.size(); i += 8) {
+        uint64_t chunk;
+        memcpy(&chunk, name.data() + i, 8);
+        chunk *= m;
+        chunk ^= chunk >> 47;
+        chunk *= m;
+        hash ^= chunk;
+        hash *= m;
+    }
+    if (i < name.size()) {
+        uint64_t tail = 0;
+        memcpy(&tail, name.data() + i, name.size() - i);
+        hash ^= tail;
+        hash *= m;
+    }
+    return mix64(hash);
+}
+
+
+/**
+ * Name: memoryUsage
+ * Desc: Adds up the bit arrays, ranks, fallback, records and arena.
+ * Preconditions: None.
+ * Postconditions: Returns the number of bytes.
+ */
+size_t FrozenVacDB::memoryUsage() const {
+    return sizeof(FrozenVacDB) + m_levels.size() * sizeof(Level) + m_bits.size() * sizeof(uint64_t) +
+           m_ranks.size() * sizeof(uint32_t) + m_fallback.size() * sizeof(Fallback) +
+           m_records.size() * sizeof(Record) + m_arena.size();
+}
+
+
+/**
+ * Name: save
+ * Desc: Writes an ExportHeader with FROZENMAGIC, the sizes of the parts and the levels, bit
+ *       arrays, fallback, records and arena as they are in memory. The ranks are rebuilt by load.
+ * Preconditions: fd is open for writing.
+ * Postconditions: Returns false if a write failed.
+ */
+bool FrozenVacDB::save(int fd) const {
+    ExportWriter writer(fd);
+    ExportHeader header = {FROZENMAGIC, FROZENVERSION};
+    FrozenHeader sizes = {m_records.size(), m_levels.size(), m_bits.size(), m_fallback.size(), m_arena.size()};
+    writer.write((const char*)&header, sizeof(header));
+    writer.write((const char*)&sizes, sizeof(sizes));
+    writer.write((const char*)m_levels.data(), m_levels.size() * sizeof(Level));
+    writer.write((const char*)m_bits.data(), m_bits.size() * sizeof(uint64_t));
+    writer.write((const char*)m_fallback.data(), m_fallback.size() * sizeof(Fallback));
+    writer.write((const char*)m_records.data(), m_records.size() * sizeof(Record));
+    writer.write(m_arena.data(), m_arena.size());
+    return writer.flush();
+}
+
+
+/**
+ * Name: load
+ * Desc: Reads a snapshot written by save and checks that every level, index and name lies within
+ *       the arrays read, so a damaged file cannot make lookups read out of bounds. The sizes in
+ *       the header are checked against the rest of a regular file before anything is allocated,
+ *       other descriptors are read in chunks.
+ * Preconditions: fd is open for reading at the start of a snapshot.
+ * Postconditions: Returns true with the snapshot loaded, or false with it empty.
+ */
+bool FrozenVacDB::load(int fd) {
+    clear();
+    ExportHeader header;
+    FrozenHeader sizes;
+    if (!readAll(fd, &header, sizeof(header)) || header.magic != FROZENMAGIC || header.version != FROZENVERSION ||
+        !readAll(fd, &sizes, sizeof(sizes)) || sizes.levels > (uint64_t)FROZENMAXLEVELS ||
+        sizes.records >= (1ULL << 31) || sizes.fallback > sizes.records || sizes.arena >= (1ULL << 32) ||
+        sizes.bitWords > 4 * sizes.records + 64 * FROZENMAXLEVELS) {
+        return false;
+    }
+    uint64_t payload = sizes.levels * sizeof(Level) + sizes.bitWords * sizeof(uint64_t) +
+                       sizes.fallback * sizeof(Fallback) + sizes.records * sizeof(Record) + sizes.arena;
+    struct stat info;
+    off_t at = lseek(fd, 0, SEEK_CUR);
+    if (at >= 0 && fstat(fd, &info) == 0 && S_ISREG(info.st_mode) &&
+        (info.st_size < at || payload > (uint64_t)(info.st_size - at))) {
+        return false;
+    }
+    bool valid = readArray(fd, m_levels, sizes.levels) && readArray(fd, m_bits, sizes.bitWords) &&
+                 readArray(fd, m_fallback, sizes.fallback) && readArray(fd, m_records, sizes.records) &&
+                 readArray(fd, m_arena, sizes.arena);
+    for (const Level& level : m_levels)
+        valid = valid && level.offset % 64 == 0 && level.size > 0 && level.size <= m_bits.size() * 64 &&
+                level.offset <= m_bits.size() * 64 - level.size;
+    for (const Fallback& entry : m_fallback)
+        valid = valid && entry.index < m_records.size();
+    for (const Record& record : m_records)
+        valid = valid && (uint64_t)record.name + record.length <= m_arena.size();
+    if (valid) {
+        buildRanks();
+        uint64_t setBits = 0;
+        for (uint64_t word : m_bits)
+            setBits += __builtin_popcountll(word);
+        valid = (setBits + m_fallback.size() == m_records.size());
+    }
+    if (!valid)
+        clear();
+    return valid;
+}
+
+
+void FrozenVacDB::clear() {
+    m_levels.clear();
+    m_bits.clear();
+    m_ranks.clear();
+    m_fallback.clear();
+    m_records.clear();
+    m_arena.clear();
+}
@@ -0,0 +1,71 @@
+// CMSC 341 - Spring 2024 - Project 4
+#ifndef FROZENDB_H
+#define FROZENDB_H
+#include "vacdb.h"
+#include <cstdint>
+const float FROZENGAMMA = 2.0;              // bits per remaining key on every level
+const int FROZENMAXLEVELS = 32;             // keys still colliding after this go to a sorted list
+const uint32_t FROZENMAGIC = 0x5a46564d;    // "MVFZ" in a little endian file
+const uint32_t FROZENVERSION = 1;
+const size_t FROZENREADCHUNK = 1 << 20;     // bytes a part grows by while load reads it
+
+// Read-only snapshot of a VacDB for the end-of-day archive. A minimal
+// perfect hash in the style of BBHash maps every stored (name, serial)
+// to its own index in a dense array of records: level l is a bit array
+// of FROZENGAMMA bits per key that collided on all earlier levels, a key
+// sits on the first level where its bit is set, and its index is the
+// rank of that bit over all levels. A lookup tests about 1.6 bits and
+// reads one record, whose name and serial reject keys that were never
+// stored. Names are packed in one arena. The whole structure can be
+// saved to and loaded from a file.
+class FrozenVacDB{
+    public:
+    friend class Tester;
+    FrozenVacDB();
+    // freezes the live patients of db
+    explicit FrozenVacDB(const VacDB& db);
+    // Returns the patient as VacDB does, an empty Patient if it is not stored
+    const Patient getPatient(string name, int serial) const;
+    bool contains(const string& name, int serial) const {return find(name, serial) != -1;}
+    int size() const {return (int)m_records.size();}
+    int levels() const {return (int)m_levels.size();}
+    // Returns the number of bytes of the hash, the records and the arena
+    size_t memoryUsage() const;
+    // Returns false if a write failed
+    bool save(int fd) const;
+    // replaces the contents with a saved snapshot
+    // Returns false, leaving the snapshot empty, if the file is cut or not a snapshot
+    bool load(int fd);
+
+    private:
+    struct Level{
+        uint64_t offset;    // first bit of the level in m_bits, a multiple of 64
+        uint64_t size;      // bits of the level
+    };
+    struct Fallback{
+        uint64_t hash;
+        uint32_t index;
+        uint32_t unused;
+    };
+    struct Record{
+        uint32_t name;      // offset of the name in m_arena
+        uint32_t length;
+        int32_t serial;
+        int32_t slot;
+    };
+    vector<Level> m_levels;
+    vector<uint64_t> m_bits;            // the levels back to back
+    vector<uint32_t> m_ranks;           // set bits before every block of 8 words of m_bits
+    vector<Fallback> m_fallback;        // keys on no level, by hash
+    vector<Record> m_records;           // by index
+    vector<char> m_arena;
+
+    static uint64_t keyHash(const string& name, int serial);
+    uint64_t rank(uint64_t bit) const;
+    int position(uint64_t hash) const;
+    bool matches(int index, const string& name, int serial) const;
+    int find(const string& name, int serial) const;
+    void buildRanks();
+    void clear();
+};
+#endif
@@ -0,0 +1,286 @@
+// CMSC 341 - Spring 2024 - Project 4
+#include "fuzzyindex.h"
+#include "vacdb.h"
+#include <algorithm>
+#include <cctype>
+
+const int NUMTRIGRAMS = 1 << 18;    // trigrams of three 6-bit letter codes
+const int MAXPATTERN = 64;          // longest query of the bit-parallel kernel
+const int MAXLENGTH = 255;          // longer names share the last length class
+
+static inline unsigned char fold(char c) {
+    return (unsigned char)tolower((unsigned char)c);
+}
+
+// Match masks of a query for the bit-parallel kernel: bit i of peq[c]
+// is set when the i-th letter of the query is c
+struct Pattern{
+    uint64_t peq[256];
+    int length;
+    Pattern(const string& text) : length((int)text.size()) {
+        fill(peq, peq + 256, 0);
+        for (int i = 0; i < length && i < MAXPATTERN; i++)
+            peq[fold(text[i])] |= 1ULL << i;
+    }
+};
+
+/**
+ * Name: myersDistance
+ * Desc: Bit-parallel Levenshtein distance (Myers 1999, Hyyro's global variant). One column of
+ *       the DP matrix is held as vertical +1/-1 delta bits in two 64-bit words and advanced with
+ *       a handful of word operations per text letter. Stops once the distance cannot come back
+ *       under maxEdits.
+ * Preconditions: The pattern has 1 to 64 letters.
+ * Postconditions: Returns the distance, or maxEdits + 1 if it exceeds maxEdits.
+ */
+static int myersDistance(const Pattern& pattern, const char* text, int n, int maxEdits) {
+    const int m = pattern.length;
+    const uint64_t high = 1ULL << (m - 1);
+    uint64_t pv = ~0ULL;
+    uint64_t mv = 0;
+    int score = m;
+    for (int j = 0; j < n; j++) {
+        uint64_t eq = pattern.peq[fold(text[j])];
+        uint64_t xv = eq | mv;
+        uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        uint64_t ph = mv | ~(xh | pv);
+        uint64_t mh = pv & xh;
+        if (ph & high) score++;
+        else if (mh & high) score--;
+        ph = (ph << 1) | 1;
+        mh = mh << 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+        // each remaining letter lowers the distance by at most one
+        if (score - (n - j - 1) > maxEdits) return maxEdits + 1;
+    }
+    return (score <= maxEdits) ? score : maxEdits + 1;
+}
+
+/**
+ * Name: dpDistance
+ * Desc: Two-row dynamic programming Levenshtein distance for queries longer than 64 letters.
+ * Preconditions: None.
+ * Postconditions: Returns the distance, or maxEdits + 1 if it exceeds maxEdits.
+ */
+static int dpDistance(const string& a, const char* b, int n, int maxEdits) {
+    vector<int> prev(n + 1), curr(n + 1);
+    for (int j = 0; j <= n; j++) prev[j] = j;
+    for (size_t i = 1; i <= a.size(); i++) {
+        curr[0] = (int)i;
+        int rowMin = curr[0];
+        for (int j = 1; j <= n; j++) {
+            int cost = (fold(a[i - 1]) == fold(b[j - 1])) ? 0 : 1;
+            curr[j] = min(min(prev[j] + 1, curr[j - 1] + 1), prev[j - 1] + cost);
+            rowMin = min(rowMin, curr[j]);
+        }
+        if (rowMin > maxEdits) return maxEdits + 1;
+        swap(prev, curr);
+    }
+    return (prev[n] <= maxEdits) ? prev[n] : maxEdits + 1;
+}
+
+// distance of a query to a name, with the pattern of the query built beforehand
+static int distance(const Pattern& pattern, const string& query, const char* text, int n, int maxEdits) {
+    int diff = (int)query.size() - n;
+    if (diff > maxEdits || -diff > maxEdits) return maxEdits + 1;
+    if (query.empty()) return n;
+    if (query.size() > (size_t)MAXPATTERN) return dpDistance(query, text, n, maxEdits);
+    return myersDistance(pattern, text, n, maxEdits);
+}
+
+// posting list key of a trigram among the names of a length
+static inline uint32_t postingKey(int length, int gram) {
+    return ((uint32_t)min(length, MAXLENGTH) << 18) | gram;
+}
+
+// 6-bit code of a letter: 0 pads the name, then letters, digits and space,
+// any other byte shares the remaining codes
+static inline int letterCode(char c) {
+    unsigned char ch = fold(c);
+    if (ch >= 'a' && ch <= 'z') return 1 + (ch - 'a');
+    if (ch >= '0' && ch <= '9') return 27 + (ch - '0');
+    if (ch == ' ') return 37;
+    return 38 + ch % 26;
+}
+
+// appends the distinct trigrams of a name, padded with one code 0 at both ends
+static void trigrams(const string& name, vector<int>& grams) {
+    int n = (int)name.size();
+    int window = 0;
+    for (int i = -1; i <= n; i++) {
+        int code = (i >= 0 && i < n) ? letterCode(name[i]) : 0;
+        window = ((window << 6) | code) & (NUMTRIGRAMS - 1);
+        if (i >= 1 || (i == n && n < 2))
+            grams.push_back(window);
+    }
+    sort(grams.begin(), grams.end());
+    grams.erase(unique(grams.begin(), grams.end()), grams.end());
+}
+
+
+FuzzyIndex::FuzzyIndex() : m_byLength(MAXLENGTH + 1), m_dead(0) {}
+
+
+/**
+ * Name: boundedDistance
+ * Desc: Case-insensitive Levenshtein distance of two names, bounded by maxEdits.
+ * Preconditions: maxEdits is non-negative.
+ * Postconditions: Returns the distance, or maxEdits + 1 if it exceeds maxEdits.
+ */
+int FuzzyIndex::boundedDistance(const string& a, const string& b, int maxEdits) {
+    return distance(Pattern(a), a, b.data(), (int)b.size(), maxEdits);
+}
+
+
+/**
+ * Name: add
+ * Desc: Gives the patient the next id, copies its name to the arena and appends the id to the
+ *       posting list of every trigram of its name. Ids only grow, so the lists stay sorted.
+ * Preconditions: patient points to an entry of the hash table that is not indexed yet.
+ * Postconditions: The patient can be found by search.
+ */
+void FuzzyIndex::add(const Patient* patient) {
+    int id = (int)m_entries.size();
+    m_entries.push_back(patient);
+    m_info.push_back({(uint32_t)m_arena.size(), (uint16_t)min<size_t>(patient->m_name.size(), 65535), true});
+    m_arena.append(patient->m_name, 0, m_info.back().length);
+    m_ids[patient] = id;
+    index(id);
+}
+
+
+/**
+ * Name: remove
+ * Desc: Marks the id of the patient dead. Its postings are skipped by searches and dropped by
+ *       compact() once dead ids outnumber live ones, which keeps removal O(1) amortized.
+ * Preconditions: patient was added and has not been freed.
+ * Postconditions: The patient is no longer returned by search.
+ */
+void FuzzyIndex::remove(const Patient* patient) {
+    auto it = m_ids.find(patient);
+    if (it == m_ids.end()) return;
+    m_entries[it->second] = nullptr;
+    m_info[it->second].live = false;
+    m_ids.erase(it);
+    m_dead++;
+    if (m_dead > 1024 && m_dead > (int)m_ids.size())
+        compact();
+}
+
+
+/**
+ * Name: search
+ * Desc: One edit destroys at most three trigrams, so a name within maxEdits edits of the query
+ *       keeps all but 3 * maxEdits of the query's distinct trigrams and must contain one of the
+ *       3 * maxEdits + 1 rarest ones. For every name length within maxEdits of the query, only
+ *       those posting lists are read, and the shortlisted names are ranked with the bit-parallel
+ *       kernel straight from the arena. Queries with too few trigrams to filter read every name
+ *       of a reachable length. A name on several of the lists is checked once; the ids are
+ *       gathered and deduplicated per call, so the search writes nothing shared.
+ * Preconditions: maxEdits and k are non-negative.
+ * Postconditions: Returns up to k matches, by distance and then by name.
+ */
+vector<FuzzyMatch> FuzzyIndex::search(const string& name, int maxEdits, int k) const {
+    vector<FuzzyMatch> matches;
+    vector<int> grams;
+    vector<int> candidates;
+    trigrams(name, grams);
+
+    Pattern pattern(name);
+    auto verify = [&](int id) {
+        const IdInfo& info = m_info[id];
+        if (!info.live) return;
+        int d = distance(pattern, name, m_arena.data() + info.offset, info.length, maxEdits);
+        if (d <= maxEdits)
+            matches.push_back({m_entries[id], d});
+    };
+
+    const int length = (int)name.size();
+    const int shortlist = 3 * maxEdits + 1;
+    vector<const vector<int>*> lists;
+    for (int l = max(0, length - maxEdits); l <= min(length + maxEdits, MAXLENGTH); l++) {
+        if ((int)grams.size() < shortlist) {
+            for (int id : m_byLength[l])
+                verify(id);
+            continue;
+        }
+        lists.clear();
+        bool absent = false;
+        for (int gram : grams) {
+            auto it = m_postings.find(postingKey(l, gram));
+            if (it == m_postings.end()) {
+                absent = true;  // an empty list is the rarest of all
+                lists.push_back(nullptr);
+            } else {
+                lists.push_back(&it->second);
+            }
+        }
+        sort(lists.begin(), lists.end(), [](const vector<int>* lhs, const vector<int>* rhs) {
+            return (lhs ? lhs->size() : 0) < (rhs ? rhs->size() : 0);
+        });
+        // with shortlist or more absent trigrams no name of this length is close enough
+        if (absent && lists[shortlist - 1] == nullptr) continue;
+        candidates.clear();
+        for (int g = 0; g < shortlist; g++) {
+            if (lists[g] != nullptr)
+                candidates.insert(candidates.end(), lists[g]->begin(), lists[g]->end());
+        }
+        sort(candidates.begin(), candidates.end());
+        candidates.erase(unique(candidates.begin(), candidates.end()), candidates.end());
+        for (int id : candidates)
+            verify(id);
+    }
+
+    sort(matches.begin(), matches.end(), [](const FuzzyMatch& lhs, const FuzzyMatch& rhs) {
+        if (lhs.distance != rhs.distance) return lhs.distance < rhs.distance;
+        return lhs.patient->m_name < rhs.patient->m_name;
+    });
+    if ((int)matches.size() > k)
+        matches.resize(k);
+    return matches;
+}
+
+
+// appends an id to the length list and to the posting lists of the trigrams of its name
+void FuzzyIndex::index(int id) {
+    vector<int> grams;
+    int length = m_info[id].length;
+    trigrams(string(m_arena, m_info[id].offset, length), grams);
+    for (int gram : grams)
+        m_postings[postingKey(length, gram)].push_back(id);
+    m_byLength[min(length, MAXLENGTH)].push_back(id);
+}
+
+
+/**
+ * Name: compact
+ * Desc: Renumbers the live entries in their current order and rebuilds the arena and the
+ *       lists without the dead ids.
+ * Preconditions: None.
+ * Postconditions: m_dead is 0 and every id in the lists is live.
+ */
+void FuzzyIndex::compact() {
+    vector<const Patient*> live;
+    vector<IdInfo> info;
+    string arena;
+    live.reserve(m_ids.size());
+    info.reserve(m_ids.size());
+    for (size_t id = 0; id < m_entries.size(); id++) {
+        if (m_entries[id] != nullptr) {
+            m_ids[m_entries[id]] = (int)live.size();
+            live.push_back(m_entries[id]);
+            info.push_back({(uint32_t)arena.size(), m_info[id].length, true});
+            arena.append(m_arena, m_info[id].offset, m_info[id].length);
+        }
+    }
+    m_entries.swap(live);
+    m_info.swap(info);
+    m_arena.swap(arena);
+    m_postings.clear();
+    for (vector<int>& list : m_byLength)
+        list.clear();
+    for (int id = 0; id < (int)m_entries.size(); id++)
+        index(id);
+    m_dead = 0;
+}
@@ -0,0 +1,57 @@
+// CMSC 341 - Spring 2024 - Project 4
+#ifndef FUZZYINDEX_H
+#define FUZZYINDEX_H
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+class Patient;
+class Tester;
+
+// A match of a fuzzy search and its edit distance to the query
+struct FuzzyMatch{
+    const Patient* patient;
+    int distance;
+};
+
+// Trigram inverted index over the names of the stored patients, split by
+// name length. A search shortlists the names of a reachable length that
+// share a rare trigram with the query and ranks them with a bit-parallel
+// bounded edit distance. Like PrefixIndex it holds the table's pointers,
+// so entries must be removed before they are freed. Letters are compared
+// case-insensitively.
+class FuzzyIndex{
+    public:
+    friend class Tester;
+    FuzzyIndex();
+    void add(const Patient* patient);
+    void remove(const Patient* patient);
+    // Returns up to k patients within maxEdits edits of name, closest first.
+    // Concurrent searches are safe as long as nothing is added or removed
+    vector<FuzzyMatch> search(const string& name, int maxEdits, int k) const;
+    int size() const {return (int)m_ids.size();}
+
+    // Levenshtein distance of a and b, or maxEdits + 1 once it exceeds maxEdits
+    static int boundedDistance(const string& a, const string& b, int maxEdits);
+
+    private:
+    // what a search reads about an id, kept together so a candidate
+    // costs one cache miss here and one in the arena
+    struct IdInfo{
+        uint32_t offset;                    // start of the name in m_arena
+        uint16_t length;
+        bool live;
+    };
+    vector<const Patient*> m_entries;       // by id, nullptr once removed
+    vector<IdInfo> m_info;                  // by id
+    string m_arena;                         // names of all ids back to back
+    unordered_map<uint32_t, vector<int>> m_postings; // ids by (length, trigram), ascending
+    vector<vector<int>> m_byLength;         // ids by name length, for short queries
+    unordered_map<const Patient*, int> m_ids;
+    int m_dead;                             // removed ids still in the lists
+
+    void index(int id);
+    void compact();
+};
+#endif
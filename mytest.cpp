@@ -1,10 +1,23 @@
 // CMSC 341 - Spring 2024 - Project 4
 #include "vacdb.h"
+#include "compactdb.h"
+#include "requestserver.h"
+#include "basicvacdb.h"
+#include "frozendb.h"
+#include "changestream.h"
+#include "workload.h"
+#include "snapshot.h"
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <fcntl.h>
 #include <math.h>
 #include <random>
 #include <vector>
 #include <algorithm>
 #include <ctime>     //used to get the current time
+#include <cstring>
+#include <atomic>
+#include <unistd.h>
 // We can use the Random class to generate the test data randomly!
 enum RANDOM {UNIFORMINT, UNIFORMREAL, NORMAL, SHUFFLE};
 class Random {
@@ -100,8 +113,9 @@ public:
         // to use ASCII char the number range in constructor must be set to 97 - 122
         // and the Random type must be UNIFORMINT (it is default in constructor)
         string output = "";
+        output.reserve(size);
         for (int i=0;i<size;i++){
-            output = output + (char)getRandNum();
+            output += (char)getRandNum();
         }
         return output;
     }
@@ -137,6 +151,43 @@ public:
     static void testInsertionBoundarySerialNumbers();
     static void testRemoveNonExistent();
     static void testRemoveAcrossTables();
+    static void testRobinHoodColliding();
+    static void testRobinHoodRemove();
+    static void testCuckooColliding();
+    static void testCuckooStashAndRehash();
+    static void testSlotBookFindNext();
+    static void testSlotReleaseOnRemove();
+    static void testPrefixSearch();
+    static void testEditDistanceKernel();
+    static void testFuzzySearch();
+    static void testExportText();
+    static void testExportBinary();
+    static void testSerialAllocator();
+    static void testSerialUniqueness();
+    static void testNameFilter();
+    static void testFilterAcrossRehash();
+    static void testCompactInsertFind();
+    static void testCompactRemoveRehash();
+    static void testIteration();
+    static void testParallelReduce();
+    static void testRequestProtocol();
+    static void testRequestServerBatch();
+    static void testTraceRecord();
+    static void testTraceReplay();
+    static void testBasicBadges();
+    static void testBasicAllocator();
+    static void testTimingWheel();
+    static void testExpiry();
+    static void testFreezeLookup();
+    static void testFreezeSaveLoad();
+    static void testPageAllocator();
+    static void testPagePolicyTable();
+    static void testChangeStreamRing();
+    static void testStandbyReplica();
+    static void testZipfTable();
+    static void testWorkloadDeterminism();
+    static void testSnapshotConsistency();
+    static void testSnapshotConcurrentScan();
 };
 
 
@@ -558,6 +609,81 @@ unsigned int hashCode(const string str);
 
 string namesDB[6] = {"john", "serina", "mike", "celina", "alexander", "jessica"};
 
+// A staff badge, the record of a BasicVacDB keyed by badge number
+struct Badge{
+    string holder;
+    int level;
+};
+
+struct BadgeHash{
+    unsigned int operator()(int number) const {return (unsigned int)number;}
+};
+
+// inserts, removes and reinserts 5000 badges under a probing policy
+template <class Policy>
+bool checkBadges() {
+    BasicVacDB<int, Badge, BadgeHash, Policy> badges;
+    bool pass = true;
+    for (int number = 0; number < 5000; number++)
+        pass &= badges.insert(number, {namesDB[number % 6], number % 3});
+    pass &= !badges.insert(42, {"copy", 0});                  // duplicate key
+    pass &= (badges.size() == 5000 && badges.lambda() <= BASICMAXLOAD);
+    pass &= ((badges.capacity() & (badges.capacity() - 1)) == 0);
+    for (int number = 0; number < 5000; number += 2)
+        pass &= badges.remove(number);
+    pass &= !badges.remove(0) && !badges.contains(4998);
+    for (int number = 1; number < 5000; number += 2) {
+        const Badge* badge = badges.find(number);
+        pass &= (badge != nullptr && badge->holder == namesDB[number % 6] && badge->level == number % 3);
+    }
+    // the tombstones are reused or dropped, the table does not keep growing
+    size_t capacity = badges.capacity();
+    for (int round = 0; round < 20; round++) {
+        for (int number = 0; number < 5000; number += 2)
+            pass &= badges.insert(number, {"temp", round});
+        for (int number = 0; number < 5000; number += 2)
+            pass &= badges.remove(number);
+    }
+    pass &= (badges.capacity() == capacity && badges.size() == 2500);
+    badges.find(7)->level = 9;
+    int count = 0;
+    long long sum = 0;
+    badges.forEach([&](int number, const Badge& badge) { count++; sum += number + badge.level; });
+    long long expected = 9 - 7 % 3;
+    for (int number = 1; number < 5000; number += 2)
+        expected += number + number % 3;
+    pass &= (count == 2500 && sum == expected);
+    return pass;
+}
+
+// counts the bytes a table takes from and returns to its allocator
+static long long allocatedBytes = 0;
+template <class T>
+struct CountingAllocator{
+    typedef T value_type;
+    CountingAllocator() {}
+    template <class U> CountingAllocator(const CountingAllocator<U>&) {}
+    T* allocate(size_t n) {
+        allocatedBytes += n * sizeof(T);
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+    void deallocate(T* p, size_t n) {
+        allocatedBytes -= n * sizeof(T);
+        ::operator delete(p);
+    }
+    template <class U> bool operator==(const CountingAllocator<U>&) const {return true;}
+    template <class U> bool operator!=(const CountingAllocator<U>&) const {return false;}
+};
+
+// A vaccine lot, counting its live copies
+static int liveLots = 0;
+struct Lot{
+    int doses;
+    Lot(int count = 0) : doses(count) {liveLots++;}
+    Lot(const Lot& rhs) : doses(rhs.doses) {liveLots++;}
+    ~Lot() {liveLots--;}
+};
+
 unsigned int hashCode(const string str) {
    unsigned int val = 0 ;
    const unsigned int thirtyThree = 33 ;  // magic number from textbook
@@ -613,6 +739,1658 @@ void Tester::testRemoveAcrossTables() {
 }
 
 
+void Tester::testRobinHoodColliding() {
+    cout << "Testing Robin Hood Probing for Colliding Keys..." << endl;
+
+    // Everything lands in 5 home buckets, so the clusters overlap heavily
+    VacDB db(101, [](string key) -> unsigned int {
+        return static_cast<unsigned int>(hash<string>{}(key) % 5);
+    }, ROBINHOOD);
+
+    bool pass = true;
+    for (int i = 0; i < 80; i++) {
+        pass &= db.insert(Patient("Patient" + to_string(i), 2000 + i));
+    }
+    // 80 entries stay under RHMAXLOAD in 101 buckets, no rehash happens
+    pass &= (db.m_currentCap == 101 && db.getCurrentSize() == 80);
+
+    // every resident must sit at its recorded distance from its home bucket
+    for (int i = 0; i < db.m_currentCap; i++) {
+        if (db.m_currentTable[i] != nullptr) {
+            int home = VacDB::mixHash(db.m_hash(db.m_currentTable[i]->getKey())) % db.m_currentCap;
+            pass &= ((home + db.m_currentDist[i]) % db.m_currentCap == i);
+        }
+    }
+    for (int i = 0; i < 80; i++) {
+        pass &= (db.getPatient("Patient" + to_string(i), 2000 + i).getSerial() == 2000 + i);
+    }
+    pass &= (db.getPatient("Missing", 2000).getSerial() == 0);
+    pass &= !db.insert(Patient("Patient7", 2007)); // duplicate
+
+    cout << "Robin Hood Colliding Test: " << (pass ? "PASS" : "FAIL") << endl;
+}
+
+void Tester::testRobinHoodRemove() {
+    cout << "Testing Robin Hood Removal and Policy Change..." << endl;
+
+    VacDB db(101, hashCode, LINEAR);
+    db.changeProbPolicy(ROBINHOOD);
+    for (int i = 0; i < 60; i++) {
+        db.insert(Patient("Patient" + to_string(i), 3000 + i));
+    }
+    // crossing MAXLOAD rehashed the table into the requested policy
+    bool pass = (db.m_currProbing == ROBINHOOD && db.m_currentDist != nullptr);
+
+    for (int i = 0; i < 60; i += 2) {
+        pass &= db.remove(Patient("Patient" + to_string(i), 3000 + i));
+    }
+    pass &= !db.remove(Patient("Patient0", 3000));
+    // backward shift deletion leaves no deleted buckets behind
+    pass &= (db.m_currNumDeleted == 0 && db.getCurrentSize() == 30);
+    for (int i = 0; i < 60; i++) {
+        bool found = db.getPatient("Patient" + to_string(i), 3000 + i).getUsed();
+        pass &= (found == (i % 2 == 1));
+    }
+    pass &= db.updateSerialNumber(Patient("Patient1", 3001), 4001);
+    pass &= (db.getPatient("Patient1", 4001).getSerial() == 4001);
+
+    cout << "Robin Hood Remove Test: " << (pass ? "PASS" : "FAIL") << endl;
+}
+
+void Tester::testCuckooColliding() {
+    cout << "Testing Cuckoo Hashing for Colliding Keys..." << endl;
+
+    // the user hash only yields 5 first buckets, the second bucket comes from altHash
+    VacDB db(101, [](string key) -> unsigned int {
+        return static_cast<unsigned int>(hash<string>{}(key) % 5);
+    }, CUCKOO);
+
+    bool pass = true;
+    for (int i = 0; i < 60; i++) {
+        pass &= db.insert(Patient("Patient" + to_string(i), 2000 + i));
+    }
+    // every entry sits in one of its two buckets or in the stash
+    for (int i = 0; i < db.m_currentCap + db.m_stashCap; i++) {
+        if (db.m_currentTable[i] != nullptr) {
+            int first, second;
+            db.cuckooBuckets(db.m_currentTable[i]->getKey(), db.m_currentCap, first, second);
+            int bucket = i / CUCKOOSLOTS;
+            pass &= (i >= db.m_currentCap || bucket == first || bucket == second);
+        }
+    }
+    for (int i = 0; i < 60; i++) {
+        pass &= (db.getPatient("Patient" + to_string(i), 2000 + i).getSerial() == 2000 + i);
+    }
+    pass &= (db.getPatient("Missing", 2000).getSerial() == 0);
+    pass &= !db.insert(Patient("Patient3", 2003)); // duplicate
+    for (int i = 0; i < 60; i += 3) {
+        pass &= db.remove(Patient("Patient" + to_string(i), 2000 + i));
+    }
+    pass &= (db.getCurrentSize() == 40 && db.m_currNumDeleted == 0);
+    pass &= !db.getPatient("Patient0", 2000).getUsed();
+    pass &= db.getPatient("Patient1", 2001).getUsed();
+
+    cout << "Cuckoo Colliding Test: " << (pass ? "PASS" : "FAIL") << endl;
+}
+
+void Tester::testCuckooStashAndRehash() {
+    cout << "Testing Cuckoo Stash and Rehash..." << endl;
+
+    VacDB db(101, hashCode, CUCKOO);
+    bool pass = true;
+    // patients sharing a name share both buckets, the ninth one needs the stash
+    // and the thirteenth one a larger stash, the table itself does not grow
+    const int crowd = 40;
+    for (int i = 0; i < crowd; i++) {
+        pass &= db.insert(Patient("jessica", 5000 + i));
+    }
+    pass &= (db.m_currentCap == 101 && db.m_stashCap >= crowd - 2 * CUCKOOSLOTS);
+    pass &= !db.insert(Patient("jessica", 5003)); // duplicate
+    for (int i = 0; i < crowd; i++) {
+        pass &= (db.getPatient("jessica", 5000 + i).getSerial() == 5000 + i);
+    }
+    // remove takes any patient of the name, stashed ones included, and the slots are reused
+    for (int i = 0; i < crowd; i++) {
+        pass &= db.remove(Patient("jessica", 5000 + i));
+    }
+    pass &= !db.remove(Patient("jessica", 5000));
+    int first, second;
+    db.cuckooBuckets("jessica", db.m_currentCap, first, second);
+    pass &= (db.getCurrentSize() == 0 && db.m_currentDist[first] == 0);
+    for (int i = 0; i < crowd; i++) {
+        pass &= db.insert(Patient("jessica", 5000 + i));
+    }
+
+    // growing past CKMAXLOAD keeps the stashed patients
+    int cap = db.m_currentCap;
+    for (int i = 0; db.m_currentCap == cap; i++) {
+        pass &= db.insert(Patient("Patient" + to_string(i), 3000 + i % 1000));
+    }
+    pass &= (db.m_currProbing == CUCKOO);
+    for (int i = 0; i < crowd; i++) {
+        pass &= (db.getPatient("jessica", 5000 + i).getSerial() == 5000 + i);
+    }
+
+    // switching a table with a crowded name to CUCKOO rehashes to the next size only
+    VacDB other(101, hashCode, QUADRATIC);
+    for (int i = 0; i < 20; i++) {
+        pass &= other.insert(Patient("john smith", 4000 + i));
+    }
+    other.changeProbPolicy(CUCKOO);
+    for (int i = 0; other.m_currProbing != CUCKOO; i++) {
+        pass &= other.insert(Patient("Patient" + to_string(i), 3000 + i));
+    }
+    pass &= (other.m_currentCap < 1000);
+    for (int i = 0; i < 20; i++) {
+        pass &= other.getPatient("john smith", 4000 + i).getUsed();
+    }
+
+    cout << "Cuckoo Stash and Rehash Test: " << (pass ? "PASS" : "FAIL") << endl;
+}
+
+void Tester::testSlotBookFindNext() {
+    cout << "Testing Slot Book Find Next Free..." << endl;
+
+    // 3 days x 2 stations x 5000 slots makes three bitmap levels per station
+    SlotBook book(3, 2, 5000, 2);
+    bool pass = true;
+    // fill day 0 at station 1 from slot 10 on, two patients per slot
+    for (int time = 10; time < 5000; time++) {
+        pass &= (book.book(0, 1, 10) == book.slotId(0, 1, time));
+        pass &= (book.book(0, 1, 10) == book.slotId(0, 1, time));
+    }
+    // the search crosses the words of all levels into the next day
+    pass &= (book.findNextFree(0, 1, 10) == book.slotId(1, 1, 0));
+    pass &= (book.findNextFree(0, 1, 3) == book.slotId(0, 1, 3));
+    pass &= (book.findNextFree(0, 0, 4000) == book.slotId(0, 0, 4000));
+
+    // a cancellation reopens the slot
+    int slot = book.slotId(0, 1, 4321);
+    pass &= (book.booked(slot) == 2 && book.cancel(slot) && book.booked(slot) == 1);
+    pass &= (book.findNextFree(0, 1, 10) == slot);
+    pass &= !book.cancel(book.slotId(2, 0, 0));
+
+    // closing a station on the last day leaves no room after it
+    pass &= book.setCapacity(2, 0, 0);
+    pass &= (book.findNextFree(2, 0, 0) == NOSLOT);
+    pass &= (book.bookAny(2, 0) == book.slotId(2, 1, 0));
+    pass &= (book.getDay(slot) == 0 && book.getStation(slot) == 1 && book.getTime(slot) == 4321);
+
+    cout << "Slot Book Find Next Test: " << (pass ? "PASS" : "FAIL") << endl;
+}
+
+void Tester::testSlotReleaseOnRemove() {
+    cout << "Testing Slot Release on Remove..." << endl;
+
+    SlotBook book(1, 1, 8, 1);
+    VacDB db(101, hashCode, DOUBLEHASH);
+    db.setSlotBook(&book);
+    bool pass = true;
+    for (int i = 0; i < 8; i++) {
+        db.insert(Patient(namesDB[i % 6] + to_string(i), MINID + i));
+        pass &= (db.bookSlot(namesDB[i % 6] + to_string(i), MINID + i, 0, 0, 0) == i);
+    }
+    pass &= (db.bookSlot("john0", MINID, 0, 0, 0) == NOSLOT); // every slot is booked
+    pass &= (db.getPatient("mike2", MINID + 2).getSlot() == 2);
+
+    // cancelling the appointment releases its slot for the next patient
+    pass &= db.remove(Patient("mike2", MINID + 2));
+    pass &= (book.findNextFree(0, 0, 0) == 2);
+    db.insert(Patient("walkin", MINID));
+    pass &= (db.bookSlot("walkin", MINID, 0, 0, 0) == 2);
+    pass &= (db.bookSlot("nobody", MINID, 0, 0, 0) == NOSLOT);
+    pass &= (db.bookSlot("walkin", MINID + 1, 0, 0, 0) == NOSLOT);     // another serial
+
+    // a slot passed in with the patient is not a booking, remove leaves slot 5 alone
+    pass &= db.insert(Patient("forged", MINID + 100, false, 5));
+    pass &= (db.getPatient("forged", MINID + 100).getSlot() == NOSLOT);
+    pass &= db.remove(Patient("forged", MINID + 100));
+    pass &= (book.booked(5) == 1);
+
+    // with names repeated the appointment goes to the patient with the serial asked for
+    SlotBook shared(1, 1, 4, 1);
+    VacDB twins(101, hashCode, LINEAR);
+    twins.setSlotBook(&shared);
+    for (int i = 0; i < 3; i++)
+        twins.insert(Patient("john", MINID + i));
+    pass &= (twins.bookSlot("john", MINID + 2, 0, 0, 0) == 0);
+    pass &= (twins.getPatient("john", MINID + 2).getSlot() == 0);
+    pass &= (twins.getPatient("john", MINID).getSlot() == NOSLOT);
+
+    cout << "Slot Release on Remove Test: " << (pass ? "PASS" : "FAIL") << endl;
+}
+
+void Tester::testPrefixSearch() {
+    cout << "Testing Prefix Search..." << endl;
+
+    VacDB db(101, hashCode, QUADRATIC);
+    for (int i = 0; i < 120; i++) {
+        db.insert(Patient(namesDB[i % 6] + to_string(i), MINID + i));
+    }
+    // enabling the index picks up the patients already stored, across rehashes
+    db.enablePrefixIndex(true);
+    db.insert(Patient("johnathan", 2000));
+    db.insert(Patient("john", 2001));
+
+    bool pass = true;
+    vector<Patient> found = db.prefixSearch("john", 3);
+    pass &= (found.size() == 3 && found[0].getKey() == "john" && found[1].getKey() == "john0"
+             && found[2].getKey() == "john102" && found[2].getSerial() == MINID + 102);
+    pass &= (db.prefixSearch("jo", 1000).size() == 22);
+    pass &= (db.prefixSearch("johnathan", 10).size() == 1);
+    pass &= db.prefixSearch("zed", 10).empty();
+
+    // remove and update keep the index current
+    db.remove(Patient("john", 2001));
+    db.updateSerialNumber(Patient("john0", MINID), 3000);
+    found = db.prefixSearch("john", 1);
+    pass &= (found.size() == 1 && found[0].getKey() == "john0" && found[0].getSerial() == 3000);
+    pass &= (db.m_prefix->size() == db.getCurrentSize());
+
+    db.enablePrefixIndex(false);
+    pass &= db.prefixSearch("john", 1).empty();
+
+    cout << "Prefix Search Test: " << (pass ? "PASS" : "FAIL") << endl;
+}
+
+void Tester::testEditDistanceKernel() {
+    cout << "Testing Bit-Parallel Edit Distance..." << endl;
+
+    // compare the kernel against the textbook DP on random names
+    Random RndLetter(97, 100);  // a small alphabet makes close strings common
+    Random RndLength(0, 12);
+    bool pass = (FuzzyIndex::boundedDistance("jesica", "jessica", 2) == 1);
+    pass &= (FuzzyIndex::boundedDistance("JESSICA", "jessica", 0) == 0);
+    pass &= (FuzzyIndex::boundedDistance("celina", "serina", 1) == 2); // over the bound
+    pass &= (FuzzyIndex::boundedDistance(string(70, 'a'), string(69, 'a') + "b", 3) == 1);
+    for (int trial = 0; trial < 2000; trial++) {
+        string a = RndLetter.getRandString(RndLength.getRandNum());
+        string b = RndLetter.getRandString(RndLength.getRandNum());
+        vector<vector<int>> dp(a.size() + 1, vector<int>(b.size() + 1));
+        for (size_t i = 0; i <= a.size(); i++) dp[i][0] = i;
+        for (size_t j = 0; j <= b.size(); j++) dp[0][j] = j;
+        for (size_t i = 1; i <= a.size(); i++)
+            for (size_t j = 1; j <= b.size(); j++)
+                dp[i][j] = min({dp[i-1][j] + 1, dp[i][j-1] + 1, dp[i-1][j-1] + (a[i-1] != b[j-1])});
+        int expected = min(dp[a.size()][b.size()], 4);
+        pass &= (FuzzyIndex::boundedDistance(a, b, 3) == expected);
+    }
+
+    cout << "Edit Distance Kernel Test: " << (pass ? "PASS" : "FAIL") << endl;
+}
+
+void Tester::testFuzzySearch() {
+    cout << "Testing Fuzzy Search..." << endl;
+
+    VacDB db(101, hashCode, ROBINHOOD);
+    db.enableFuzzyIndex(true);
+    for (int i = 0; i < 3000; i++) {
+        db.insert(Patient(namesDB[i % 6] + to_string(i), MINID + i % 9000));
+    }
+    for (int i = 0; i < 6; i++) {
+        db.insert(Patient(namesDB[i], 9000 + i));
+    }
+
+    bool pass = true;
+    vector<Patient> found = db.fuzzySearch("jesica", 2, 5);
+    pass &= (found.size() == 2 && found[0].getKey() == "jessica" && found[0].getSerial() == 9005);
+    pass &= (found[1].getKey() == "jessica5");
+    found = db.fuzzySearch("Serena", 1, 5);
+    pass &= (found.size() == 1 && found[0].getKey() == "serina");
+    found = db.fuzzySearch("mike2O", 1, 10);   // letter O typed for zero
+    pass &= (found.size() == 3 && found[0].getKey() == "mike2" && found[1].getKey() == "mike20");
+    pass &= db.fuzzySearch("zzzzzz", 2, 5).empty();
+    pass &= (db.fuzzySearch("jon", 2, 50).size() == 3); // short query scans every entry
+
+    // concurrent readers get the same answers as one reader
+    vector<Patient> alone = db.fuzzySearch("celna1", 2, 100);
+    atomic<int> differ(0);
+    vector<thread> readers;
+    for (int t = 0; t < 4; t++) {
+        readers.emplace_back([&]() {
+            for (int q = 0; q < 50; q++)
+                differ += !(db.fuzzySearch("celna1", 2, 100) == alone);
+        });
+    }
+    for (thread& reader : readers)
+        reader.join();
+    pass &= (differ == 0 && alone.size() > 1);
+
+    // removals are skipped, and compaction keeps the index consistent
+    for (int i = 0; i < 3000; i++) {
+        db.remove(Patient(namesDB[i % 6] + to_string(i), MINID + i % 9000));
+    }
+    pass &= (db.m_fuzzy->m_dead < 1024 && db.m_fuzzy->size() == 6);
+    found = db.fuzzySearch("alexandr", 1, 5);
+    pass &= (found.size() == 1 && found[0].getKey() == "alexander");
+
+    cout << "Fuzzy Search Test: " << (pass ? "PASS" : "FAIL") << endl;
+}
+
+// reads back everything written to a temporary file
+static string readBack(FILE* file) {
+    string content;
+    char chunk[4096];
+    lseek(fileno(file), 0, SEEK_SET);
+    ssize_t n;
+    while ((n = read(fileno(file), chunk, sizeof(chunk))) > 0)
+        content.append(chunk, n);
+    return content;
+}
+
+void Tester::testExportText() {
+    cout << "Testing Text Export..." << endl;
+
+    VacDB db(MINPRIME, hashCode, LINEAR);
+    vector<string> expected;
+    for (int i = 0; i < 500; i++) {
+        Patient patient(namesDB[i % 6] + to_string(i), MINID + i);
+        db.insert(patient);
+        expected.push_back(patient.getKey() + "\t" + to_string(patient.getSerial()) + "\t-1");
+    }
+    // deleted entries are not exported
+    for (int i = 0; i < 100; i++) {
+        db.remove(Patient(namesDB[i % 6] + to_string(i), MINID + i));
+    }
+    expected.erase(expected.begin(), expected.begin() + 100);
+
+    FILE* file = tmpfile();
+    long long bytes = db.exportText(fileno(file));
+    string content = readBack(file);
+    fclose(file);
+
+    vector<string> lines;
+    size_t start = 0;
+    for (size_t end; (end = content.find('\n', start)) != string::npos; start = end + 1)
+        lines.push_back(content.substr(start, end - start));
+    sort(lines.begin(), lines.end());
+    sort(expected.begin(), expected.end());
+    bool pass = (bytes == (long long)content.size() && start == content.size() && lines == expected);
+
+    // a small buffer flushes many times and must produce the same bytes
+    file = tmpfile();
+    {
+        ExportWriter writer(fileno(file), 100);
+        for (int i = 0; i < 1000; i++)
+            writer.writeText(namesDB[i % 6], i, -1);
+        writer.writeText(string(300, 'x'), 1, 2);   // longer than the buffer
+    }
+    content = readBack(file);
+    fclose(file);
+    string reference;
+    for (int i = 0; i < 1000; i++)
+        reference += namesDB[i % 6] + "\t" + to_string(i) + "\t-1\n";
+    reference += string(300, 'x') + "\t1\t2\n";
+    pass &= (content == reference);
+    pass &= (db.exportText(-1) == -1);
+
+    cout << "Text Export Test: " << (pass ? "PASS" : "FAIL") << endl;
+}
+
+void Tester::testExportBinary() {
+    cout << "Testing Binary Export..." << endl;
+
+    VacDB db(MINPRIME, hashCode, CUCKOO);
+    SlotBook book(7, 2, 10, 5);
+    db.setSlotBook(&book);
+    for (int i = 0; i < 300; i++) {
+        // every third name is long enough to be gathered instead of copied
+        string name = (i % 3 == 0) ? string(GATHERMIN + i, 'a' + i % 26) : namesDB[i % 6] + to_string(i);
+        db.insert(Patient(name, MINID + i));
+        if (i % 5 == 0)
+            db.bookSlot(name, MINID + i, 0, 0, 0);
+    }
+
+    FILE* file = tmpfile();
+    long long bytes = db.exportBinary(fileno(file));
+    string content = readBack(file);
+    fclose(file);
+
+    ExportHeader header;
+    memcpy(&header, content.data(), sizeof(header));
+    bool pass = (bytes == (long long)content.size() && header.magic == EXPORTMAGIC && header.version == EXPORTVERSION);
+    size_t pos = sizeof(header);
+    int records = 0;
+    while (pass && pos + sizeof(ExportRecord) <= content.size()) {
+        ExportRecord record;
+        memcpy(&record, content.data() + pos, sizeof(record));
+        pos += sizeof(record);
+        string name = content.substr(pos, record.nameLength);
+        pos += record.nameLength;
+        Patient stored = db.getPatient(name, record.serial);
+        pass &= (stored.getKey() == name && stored.getSlot() == record.slot);
+        records++;
+    }
+    pass &= (pos == content.size() && records == 300);
+
+    cout << "Binary Export Test: " << (pass ? "PASS" : "FAIL") << endl;
+}
+
+void Tester::testSerialAllocator() {
+    cout << "Testing Serial Allocator..." << endl;
+
+    bool pass = true;
+    SerialAllocator serials(MINID, MAXID);
+    pass &= (serials.allocate() == MINID && serials.allocate() == MINID + 1);
+    pass &= (serials.reserve(MINID + 2) && !serials.reserve(MINID + 2) && !serials.reserve(MAXID + 1));
+    pass &= (serials.allocate() == MINID + 3);
+    // released serials are handed out again only after the cursor wraps
+    pass &= (serials.release(MINID) && !serials.release(MINID) && serials.allocate() == MINID + 4);
+    int count = 4;  // serials in use so far
+    while (serials.allocate() != NOSERIAL)
+        count++;
+    pass &= (count == MAXID - MINID + 1 && serials.used() == MAXID - MINID + 1);
+    pass &= (serials.release(MINID + 5000) && serials.allocate() == MINID + 5000);
+
+    // a range wider than three bitmap levels, with an odd end
+    SerialAllocator wide(1, 64 * 64 * 64 * 3 + 7);
+    pass &= (wide.reserve(64 * 64 * 64 * 3 + 7) && wide.inUse(64 * 64 * 64 * 3 + 7) && !wide.inUse(5));
+    for (int serial = 1; serial <= 64 * 64 * 64 * 2; serial++)
+        wide.reserve(serial);
+    pass &= (wide.allocate() == 64 * 64 * 64 * 2 + 1);
+    wide.release(777);
+    pass &= (wide.allocate() == 64 * 64 * 64 * 2 + 2);
+
+    // a range across 0 skips it, 0 is NOSERIAL and matches any serial in lookups
+    SerialAllocator signedRange(-2, 2);
+    pass &= (!signedRange.contains(0) && !signedRange.reserve(0) && !signedRange.release(0));
+    int handed = 0;
+    for (int serial; (serial = signedRange.allocate()) != NOSERIAL; handed++)
+        pass &= (serial != 0);
+    pass &= (handed == 4 && signedRange.used() == 4);
+    VacDB db(MINPRIME, hashCode, DOUBLEHASH);
+    SerialAllocator around(-5, 5);
+    db.setSerialAllocator(&around);
+    pass &= db.insert(Patient("john", -1)) && !db.insert(Patient("john", 0));
+    pass &= !db.updateSerialNumber(Patient("john", -1), 0);
+
+    cout << "Serial Allocator Test: " << (pass ? "PASS" : "FAIL") << endl;
+}
+
+void Tester::testSerialUniqueness() {
+    cout << "Testing Serial Uniqueness..." << endl;
+
+    VacDB db(MINPRIME, hashCode, DOUBLEHASH);
+    db.insert(Patient("john", 1500));
+    db.insert(Patient("mike", 1500));       // no allocator yet, duplicates are allowed
+    SerialAllocator serials(MINID, 99999);
+    db.setSerialAllocator(&serials);
+    bool pass = (serials.used() == 1 && serials.inUse(1500));
+
+    pass &= !db.insert(Patient("serina", 1500));
+    pass &= db.insert(Patient("serina", 50000));    // the allocator widens the range
+    pass &= !db.insert(Patient("celina", 100000));
+    pass &= !db.updateSerialNumber(Patient("serina", 50000), 1500);
+    pass &= db.updateSerialNumber(Patient("serina", 50000), 2000);
+    pass &= (serials.inUse(2000) && !serials.inUse(50000));
+    pass &= db.updateSerialNumber(Patient("serina", 2000), 2000);
+
+    // remove frees the serial for the next patient
+    pass &= db.remove(Patient("serina", 2000)) && !serials.inUse(2000);
+    pass &= db.insert(Patient("celina", 2000));
+
+    // admitted patients get distinct serials across rehashes
+    for (int i = 0; i < 300; i++) {
+        int serial = db.admit(namesDB[i % 6] + to_string(i));
+        pass &= (serial != NOSERIAL && db.getPatient(namesDB[i % 6] + to_string(i), serial).getSerial() == serial);
+    }
+    pass &= (serials.used() == 302 && db.m_currentSize == 303);
+
+    cout << "Serial Uniqueness Test: " << (pass ? "PASS" : "FAIL") << endl;
+}
+
+void Tester::testNameFilter() {
+    cout << "Testing Name Filter..." << endl;
+
+    NameFilter filter(10000);
+    bool pass = true;
+    for (int i = 0; i < 10000; i++)
+        filter.add("patient" + to_string(i));
+    for (int i = 0; i < 10000; i++)
+        pass &= filter.mayContain("patient" + to_string(i));
+    int falsePositives = 0;
+    for (int i = 0; i < 10000; i++)
+        falsePositives += filter.mayContain("walkin" + to_string(i));
+    pass &= (falsePositives < 600);
+
+    // a name added twice survives one removal
+    filter.add("john");
+    filter.add("john");
+    filter.remove("john");
+    pass &= filter.mayContain("john");
+    for (int i = 0; i < 10000; i++)
+        filter.remove("patient" + to_string(i));
+    filter.remove("john");
+    int left = 0;
+    for (int i = 0; i < 10000; i++)
+        left += filter.mayContain("patient" + to_string(i));
+    pass &= (left < 100 && !filter.mayContain("john"));
+
+    // saturated counters stick, so a name is never forgotten early
+    NameFilter tiny(1);
+    for (int i = 0; i < 20; i++)
+        tiny.add("mike");
+    tiny.add("serina");
+    for (int i = 0; i < 19; i++)
+        tiny.remove("mike");
+    tiny.remove("serina");
+    pass &= tiny.mayContain("mike");
+
+    cout << "Name Filter Test: " << (pass ? "PASS" : "FAIL") << endl;
+}
+
+void Tester::testFilterAcrossRehash() {
+    cout << "Testing Filter Across Rehash..." << endl;
+
+    bool pass = true;
+    for (prob_t policy : {DOUBLEHASH, ROBINHOOD, CUCKOO}) {
+        VacDB db(MINPRIME, hashCode, policy);
+        db.insert(Patient("john", 1000));
+        db.enableFilter(true);
+        for (int i = 0; i < 2000; i++)
+            db.insert(Patient(namesDB[i % 6] + to_string(i), MINID + i % 9000));
+        pass &= (db.m_currentCap > 2000 && db.m_filter->memoryUsage() >= db.m_currentCap * db.maxLoad() * FILTERCOUNTERS / 2);
+
+        for (int i = 0; i < 2000; i += 2)
+            db.remove(Patient(namesDB[i % 6] + to_string(i), MINID + i % 9000));
+        pass &= (db.getPatient("john", 1000).getKey() == "john");
+        for (int i = 0; i < 2000; i++) {
+            string name = namesDB[i % 6] + to_string(i);
+            bool found = (db.getPatient(name, MINID + i % 9000).getKey() == name);
+            pass &= (found == (i % 2 == 1));
+        }
+        pass &= !db.remove(Patient("walkin", 1000));
+        pass &= !db.updateSerialNumber(Patient("walkin", 1000), 2000);
+        pass &= db.updateSerialNumber(Patient("john", 1000), 2000);
+        pass &= !db.insert(Patient("john", 2000));
+
+        db.enableFilter(false);
+        pass &= (db.m_filter == nullptr && db.getPatient("jessica5", MINID + 5).getKey() == "jessica5");
+    }
+
+    cout << "Filter Across Rehash Test: " << (pass ? "PASS" : "FAIL") << endl;
+}
+
+void Tester::testCompactInsertFind() {
+    cout << "Testing Compact Insert and Find..." << endl;
+
+    CompactVacDB db(MINPRIME, hashCode);
+    bool pass = (sizeof(CompactVacDB::Entry) == 8 && db.m_table.size() == 128);
+    pass &= (db.insert(Patient("john", MINID)) && db.insert(Patient("john", MAXID)));
+    pass &= (!db.insert(Patient("john", MINID)) && !db.insert(Patient("mike", MAXID + 1)));
+    string longName(300, 'q');      // needs a two byte length prefix
+    pass &= db.insert(Patient(longName, 5000));
+    for (int i = 0; i < 1000; i++)
+        pass &= db.insert(Patient(namesDB[i % 6] + to_string(i), MINID + i));
+
+    pass &= (db.size() == 1003 && db.lambda() <= COMPACTMAXLOAD);
+    Patient found = db.getPatient("john", MAXID);
+    pass &= (found.getKey() == "john" && found.getSerial() == MAXID && found.getUsed());
+    pass &= (db.getPatient(longName, 5000).getKey() == longName);
+    pass &= (db.getPatient("mike2", MINID + 2).getSerial() == MINID + 2);
+    pass &= (db.getPatient("mike2", MINID + 3).getKey().empty());
+    pass &= (db.getPatient("walkin", MINID).getKey().empty());
+
+    pass &= db.updateSerialNumber(Patient("mike2", 0), 9000);
+    pass &= !db.updateSerialNumber(Patient("mike2", 0), 99999);
+    pass &= (db.getPatient("mike2", 9000).getKey() == "mike2");
+
+    cout << "Compact Insert and Find Test: " << (pass ? "PASS" : "FAIL") << endl;
+}
+
+void Tester::testCompactRemoveRehash() {
+    cout << "Testing Compact Remove and Rehash..." << endl;
+
+    CompactVacDB db(16, hashCode);
+    bool pass = true;
+    // churn: the table must purge tombstones without growing for ever
+    for (int round = 0; round < 50; round++) {
+        for (int i = 0; i < 10; i++)
+            pass &= db.insert(Patient(namesDB[i % 6] + to_string(round * 10 + i), MINID + i));
+        for (int i = 0; i < 10; i++)
+            pass &= db.remove(Patient(namesDB[i % 6] + to_string(round * 10 + i), 0));
+    }
+    pass &= (db.size() == 0 && db.m_table.size() <= 64 && db.m_arena.size() <= 200);
+    pass &= !db.remove(Patient("john0", 0));
+
+    for (int i = 0; i < 5000; i++)
+        db.insert(Patient(namesDB[i % 6] + to_string(i), MINID + i % 9000));
+    for (int i = 0; i < 5000; i += 2)
+        db.remove(Patient(namesDB[i % 6] + to_string(i), 0));
+    for (int i = 0; i < 5000; i++) {
+        string name = namesDB[i % 6] + to_string(i);
+        pass &= ((db.getPatient(name, MINID + i % 9000).getKey() == name) == (i % 2 == 1));
+    }
+    pass &= (db.size() == 2500 && db.m_deadBytes <= db.m_arena.size());
+
+    cout << "Compact Remove and Rehash Test: " << (pass ? "PASS" : "FAIL") << endl;
+}
+
+void Tester::testIteration() {
+    cout << "Testing Iteration..." << endl;
+
+    bool pass = true;
+    for (prob_t policy : {QUADRATIC, ROBINHOOD, CUCKOO}) {
+        VacDB db(MINPRIME, hashCode, policy);
+        pass &= (db.begin() == db.end());
+        for (int i = 0; i < 500; i++)
+            db.insert(Patient(namesDB[i % 6] + to_string(i), MINID + i));
+        for (int i = 0; i < 500; i += 5)
+            db.remove(Patient(namesDB[i % 6] + to_string(i), MINID + i));
+
+        // an entry left in the old table is visited as well
+        Patient* old = new Patient("straggler", 5000, true);
+        db.m_oldTable = new Patient*[3] {nullptr, old, nullptr};
+        db.m_oldCap = 3;
+
+        vector<int> seen;
+        for (const Patient& patient : db)
+            seen.push_back(patient.getSerial());
+        sort(seen.begin(), seen.end());
+        vector<int> expected;
+        for (int i = 0; i < 500; i++)
+            if (i % 5 != 0) expected.push_back(MINID + i);
+        expected.push_back(5000);
+        sort(expected.begin(), expected.end());
+        pass &= (seen == expected);
+
+        int count = 0;
+        db.forEach([&count](const Patient& patient) {count += patient.getUsed();});
+        pass &= (count == 401 && distance(db.begin(), db.end()) == 401);
+    }
+
+    cout << "Iteration Test: " << (pass ? "PASS" : "FAIL") << endl;
+}
+
+void Tester::testParallelReduce() {
+    cout << "Testing Parallel Reduce..." << endl;
+
+    VacDB db(MINPRIME, hashCode, DOUBLEHASH);
+    long long expectedSum = 0;
+    for (int i = 0; i < 60000; i++) {
+        if (db.insert(Patient(namesDB[i % 6] + to_string(i), MINID + i % 9000)))
+            expectedSum += MINID + i % 9000;
+    }
+    bool pass = true;
+    for (int threads : {1, 2, 4, 0}) {
+        long long sum = db.parallelReduce(0LL, [](const Patient& patient) {return (long long)patient.getSerial();},
+                                          [](long long a, long long b) {return a + b;}, threads);
+        pass &= (sum == expectedSum);
+        // init is folded in once, whatever the number of threads
+        long long offset = db.parallelReduce(1000LL, [](const Patient& patient) {return (long long)patient.getSerial();},
+                                             [](long long a, long long b) {return a + b;}, threads);
+        pass &= (offset == expectedSum + 1000);
+        atomic<int> count(0);
+        db.parallelForEach([&count](const Patient&) {count++;}, threads);
+        pass &= (count == 60000);
+    }
+    // a small table runs on the calling thread alone
+    pass &= (db.threadCount(8) <= 8 && VacDB(MINPRIME, hashCode, LINEAR).threadCount(8) == 1);
+
+    cout << "Parallel Reduce Test: " << (pass ? "PASS" : "FAIL") << endl;
+}
+
+void Tester::testRequestProtocol() {
+    cout << "Testing Request Protocol..." << endl;
+
+    string wire;
+    bool pass = encodeRequest(wire, OPUPDATE, "serina", 1200, 1300);
+    pass &= encodeRequest(wire, OPGET, "", 0);
+    pass &= !encodeRequest(wire, OPGET, string(70000, 'x'), 0);
+    pass &= (wire.size() == 2 * sizeof(RequestHeader) + 6);
+
+    Request request;
+    pass &= (decodeRequest(wire.data(), sizeof(RequestHeader) + 5, request) == 0);  // frame cut short
+    size_t used = decodeRequest(wire.data(), wire.size(), request);
+    pass &= (used == sizeof(RequestHeader) + 6 && request.op == OPUPDATE && request.name == "serina");
+    pass &= (request.serial == 1200 && request.newSerial == 1300);
+    pass &= (decodeRequest(wire.data() + used, wire.size() - used, request) == sizeof(RequestHeader));
+    pass &= (request.op == OPGET && request.name.empty());
+
+    wire.clear();
+    encodeResponse(wire, STATUSOK, "mike", 4321);
+    encodeResponse(wire, STATUSFAIL);
+    Response response;
+    used = decodeResponse(wire.data(), wire.size(), response);
+    pass &= (response.status == STATUSOK && response.name == "mike" && response.serial == 4321);
+    pass &= (decodeResponse(wire.data() + used, wire.size() - used, response) == sizeof(ResponseHeader));
+    pass &= (response.status == STATUSFAIL && response.name.empty());
+
+    cout << "Request Protocol Test: " << (pass ? "PASS" : "FAIL") << endl;
+}
+
+void Tester::testRequestServerBatch() {
+    cout << "Testing Request Server Batch..." << endl;
+
+    VacDB db(MINPRIME, hashCode, DOUBLEHASH);
+    RequestServer server(db);
+    int ends[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, ends);
+    bool pass = server.addConnection(ends[0]);
+
+    // a pipelined burst is served as one batch, in order
+    string wire;
+    encodeRequest(wire, OPINSERT, "john", 1500);
+    encodeRequest(wire, OPGET, "john", 1500);
+    encodeRequest(wire, OPINSERT, "john", 1500);        // duplicate
+    encodeRequest(wire, OPUPDATE, "john", 1500, 1600);
+    encodeRequest(wire, OPGET, "john", 1600);
+    encodeRequest(wire, OPREMOVE, "john", 1600);
+    encodeRequest(wire, OPGET, "john", 1600);
+    string partial;
+    encodeRequest(partial, OPINSERT, "serina", 2000);
+    wire += partial.substr(0, 5);                       // rest arrives later
+    pass &= (write(ends[1], wire.data(), wire.size()) == (ssize_t)wire.size());
+    pass &= (server.poll(1000) == 7 && server.batches() == 1);
+
+    char buffer[4096];
+    string in;
+    ssize_t n = read(ends[1], buffer, sizeof(buffer));
+    if (n > 0) in.assign(buffer, n);
+    vector<Response> responses;
+    Response response;
+    size_t pos = 0;
+    while (size_t used = decodeResponse(in.data() + pos, in.size() - pos, response)) {
+        responses.push_back(response);
+        pos += used;
+    }
+    pass &= (responses.size() == 7);
+    if (responses.size() == 7) {
+        pass &= (responses[0].status == STATUSOK && responses[1].name == "john" && responses[1].serial == 1500);
+        pass &= (responses[2].status == STATUSFAIL && responses[3].status == STATUSOK);
+        pass &= (responses[4].serial == 1600 && responses[5].status == STATUSOK && responses[6].status == STATUSFAIL);
+    }
+
+    pass &= (write(ends[1], partial.data() + 5, partial.size() - 5) == (ssize_t)partial.size() - 5);
+    pass &= (server.poll(1000) == 1 && db.getPatient("serina", 2000).getKey() == "serina");
+    read(ends[1], buffer, sizeof(buffer));
+
+    // garbage is answered with STATUSBAD after the requests before it, then the connection closes
+    wire.clear();
+    encodeRequest(wire, OPGET, "serina", 2000);
+    char junk[sizeof(RequestHeader)] = {99};
+    wire.append(junk, sizeof(junk));
+    encodeRequest(wire, OPGET, "serina", 2000);         // never answered
+    write(ends[1], wire.data(), wire.size());
+    server.poll(1000);
+    in.clear();
+    while ((n = read(ends[1], buffer, sizeof(buffer))) > 0)
+        in.append(buffer, n);
+    responses.clear();
+    pos = 0;
+    while (size_t used = decodeResponse(in.data() + pos, in.size() - pos, response)) {
+        responses.push_back(response);
+        pos += used;
+    }
+    pass &= (server.connections() == 0 && responses.size() == 2);
+    pass &= (responses.size() == 2 && responses[0].name == "serina" && responses[1].status == STATUSBAD);
+    close(ends[1]);
+
+    // a client that sends without reading: the server stops reading it above OUTHIGHWATER
+    socketpair(AF_UNIX, SOCK_STREAM, 0, ends);
+    pass &= server.addConnection(ends[0]);
+    fcntl(ends[1], F_SETFL, fcntl(ends[1], F_GETFL, 0) | O_NONBLOCK);
+    const int flooded = 300000;
+    string flood;
+    for (int i = 0; i < flooded; i++)
+        encodeRequest(flood, OPGET, "nobody", MINID);
+    size_t sent = 0;
+    for (int round = 0; round < 500 && sent < flood.size(); round++) {
+        n = write(ends[1], flood.data() + sent, flood.size() - sent);
+        if (n > 0) sent += n;
+        server.poll(0);
+    }
+    RequestServer::Connection* slow = server.m_connections[ends[0]];
+    size_t queued = slow->out.size();
+    pass &= (queued >= OUTHIGHWATER && sent < flood.size());
+    server.poll(0);
+    pass &= (slow->out.size() == queued);                   // nothing more was read
+
+    // the client sends the rest and hangs up its side, then reads a little: the server takes
+    // the rest and the hang-up, and stops watching for input while the answers wait
+    size_t answered = 0;                                    // bytes, frames may split over reads
+    auto drainAnswers = [&](size_t limit) {
+        size_t taken = 0;
+        while (taken < limit && (n = read(ends[1], buffer, sizeof(buffer))) > 0) {
+            answered += n;
+            taken += n;
+        }
+    };
+    for (int round = 0; round < 1000 && sent < flood.size(); round++) {
+        drainAnswers(1 << 16);
+        n = write(ends[1], flood.data() + sent, flood.size() - sent);
+        if (n > 0) sent += n;
+        server.poll(0);
+    }
+    shutdown(ends[1], SHUT_WR);
+    for (int round = 0; round < 100 && !slow->closed; round++) {
+        drainAnswers(1 << 16);
+        server.poll(0);
+    }
+    pass &= (sent == flood.size() && slow->closed && !slow->out.empty());
+    epoll_event event;
+    pass &= (epoll_wait(server.m_epoll, &event, 1, 0) == 0);   // no busy loop on the hang-up
+    for (int round = 0; round < 1000 && server.connections() > 0; round++) {
+        drainAnswers(SIZE_MAX);
+        server.poll(0);
+    }
+    drainAnswers(SIZE_MAX);
+    pass &= (server.connections() == 0 && answered == flooded * sizeof(ResponseHeader));
+    close(ends[1]);
+
+    cout << "Request Server Batch Test: " << (pass ? "PASS" : "FAIL") << endl;
+}
+
+void Tester::testTraceRecord() {
+    cout << "Testing Trace Record..." << endl;
+
+    VacDB db(MINPRIME, hashCode, LINEAR);
+    db.insert(Patient("john", 1000));              // stored before recording
+    FILE* file = tmpfile();
+    db.startTrace(fileno(file));
+    db.insert(Patient("serina", 2000));
+    db.insert(Patient("serina", 2000));            // duplicate
+    db.getPatient("john", 1000);
+    db.getPatient("mike", 1000);
+    db.updateSerialNumber(Patient("serina", 2000), 2500);
+    db.remove(Patient("celina", 1000));
+    db.changeProbPolicy(ROBINHOOD);
+    for (int i = 0; i < 100; i++)                  // enough to rehash
+        db.insert(Patient(namesDB[i % 6] + to_string(i), MINID + i));
+    bool pass = db.stopTrace() && db.m_trace == nullptr;
+
+    lseek(fileno(file), 0, SEEK_SET);
+    vector<TraceEntry> entries;
+    pass &= readTrace(fileno(file), entries);
+    fclose(file);
+    pass &= (entries.size() >= 109);
+    if (entries.size() >= 9) {
+        pass &= (entries[0].op == TRACEOPEN && entries[0].serial == MINPRIME && entries[0].arg == LINEAR);
+        pass &= (entries[1].op == TRACESEED && entries[1].name == "john");
+        pass &= (entries[2].op == TRACEINSERT && entries[2].outcome && !entries[3].outcome);
+        pass &= (entries[4].op == TRACEGET && entries[4].outcome && !entries[5].outcome);
+        pass &= (entries[6].op == TRACEUPDATE && entries[6].serial == 2000 && entries[6].arg == 2500);
+        pass &= (entries[7].op == TRACEREMOVE && !entries[7].outcome);
+        pass &= (entries[8].op == TRACEPOLICY && entries[8].arg == ROBINHOOD);
+    }
+    int rehashes = 0;
+    for (const TraceEntry& entry : entries) {
+        if (entry.op == TRACEREHASH) {
+            rehashes++;
+            pass &= (entry.arg == ROBINHOOD);
+        }
+    }
+    pass &= (rehashes >= 1);
+
+    // a cut trace is reported, the whole records before the cut are kept
+    file = tmpfile();
+    TraceRecord record = {TRACEGET, 1, 10, 1000, 0};
+    ExportHeader header = {TRACEMAGIC, TRACEVERSION};
+    write(fileno(file), &header, sizeof(header));
+    write(fileno(file), &record, sizeof(record));
+    write(fileno(file), "jo", 2);
+    lseek(fileno(file), 0, SEEK_SET);
+    entries.clear();
+    pass &= (!readTrace(fileno(file), entries) && entries.empty());
+    fclose(file);
+
+    cout << "Trace Record Test: " << (pass ? "PASS" : "FAIL") << endl;
+}
+
+void Tester::testTraceReplay() {
+    cout << "Testing Trace Replay..." << endl;
+
+    VacDB db(MINPRIME, hashCode, QUADRATIC);
+    for (int i = 0; i < 50; i++)
+        db.insert(Patient(namesDB[i % 6] + to_string(i), MINID + i));
+    FILE* file = tmpfile();
+    db.startTrace(fileno(file));
+    Random pick(0, 299);
+    for (int i = 0; i < 3000; i++) {
+        int n = pick.getRandNum();
+        string name = namesDB[n % 6] + to_string(n);
+        switch (i % 4) {
+            case 0: db.insert(Patient(name, MINID + n)); break;
+            case 1: db.getPatient(name, MINID + n); break;
+            case 2: db.remove(Patient(name, MINID + n)); break;
+            case 3: db.updateSerialNumber(Patient(name, MINID + n), MINID + n); break;
+        }
+    }
+    db.stopTrace();
+    lseek(fileno(file), 0, SEEK_SET);
+    vector<TraceEntry> entries;
+    bool pass = readTrace(fileno(file), entries);
+    fclose(file);
+
+    // the same policy reproduces every outcome and the final contents
+    VacDB replica(MINPRIME, hashCode, QUADRATIC);
+    int diverged = 0;
+    for (const TraceEntry& entry : entries)
+        diverged += (applyTraceEntry(replica, entry) != entry.outcome);
+    pass &= (diverged == 0 && replica.m_currentSize == db.m_currentSize);
+    for (const Patient& patient : db)
+        pass &= (replica.getPatient(patient.getKey(), patient.getSerial()).getKey() == patient.getKey());
+
+    // repeated names: the recording removes and updates whichever "john" its probe
+    // finds first, the replay under other policies changes that same patient
+    VacDB twins(101, hashCode, LINEAR);
+    file = tmpfile();
+    twins.startTrace(fileno(file));
+    for (int serial = 1001; serial <= 1003; serial++)
+        twins.insert(Patient("john", serial));
+    pass &= twins.remove(Patient("john", 1003)) && twins.updateSerialNumber(Patient("john", 1003), 1004);
+    pass &= twins.updateSerialNumber("john", 1003, 1005) && twins.remove("john", 1005);
+    pass &= !twins.remove("john", 1003) && twins.getPatient("john", 1001).getKey().empty();
+    twins.stopTrace();
+    lseek(fileno(file), 0, SEEK_SET);
+    entries.clear();
+    pass &= readTrace(fileno(file), entries);
+    fclose(file);
+    // the name-only calls are recorded with the serials they changed
+    pass &= (entries[4].op == TRACEREMOVE && entries[4].serial == 1001);
+    pass &= (entries[5].op == TRACEUPDATE && entries[5].serial == 1002 && entries[5].arg == 1004);
+    for (prob_t policy : {LINEAR, QUADRATIC, DOUBLEHASH, ROBINHOOD, CUCKOO}) {
+        VacDB other(101, hashCode, policy);
+        for (const TraceEntry& entry : entries)
+            pass &= (applyTraceEntry(other, entry) == entry.outcome);
+        pass &= (other.m_currentSize == 1 && other.getPatient("john", 1004).getUsed());
+    }
+
+    // deadlines past 2^31 ticks come back whole
+    const long long far = 5000000000LL;
+    VacDB timed(MINPRIME, hashCode, QUADRATIC);
+    timed.enableExpiry(true, 1000);
+    timed.insert(Patient("john", MINID));
+    file = tmpfile();
+    timed.startTrace(fileno(file));
+    timed.insert(Patient("serina", MINID));
+    pass &= timed.setExpiry("serina", MINID, far) && timed.setExpiry("john", MINID, far + 1);
+    timed.stopTrace();
+    lseek(fileno(file), 0, SEEK_SET);
+    entries.clear();
+    pass &= readTrace(fileno(file), entries);
+    fclose(file);
+    VacDB timedReplica(MINPRIME, hashCode, QUADRATIC);
+    for (const TraceEntry& entry : entries)
+        pass &= (applyTraceEntry(timedReplica, entry) == entry.outcome);
+    // the wheel starts at the recorded tick
+    pass &= (entries.size() == 6 && entries[1].op == TRACEWHEEL && entries[1].arg == 1000);
+    pass &= (entries[4].op == TRACEDEADLINE && entries[4].arg == far);
+    pass &= (timedReplica.expiryEnabled() && timedReplica.m_wheel->now() == 1000);
+    pass &= (timedReplica.getPatient("serina", MINID).getExpiry() == far);
+    pass &= (timedReplica.getPatient("john", MINID).getExpiry() == far + 1);
+
+    cout << "Trace Replay Test: " << (pass ? "PASS" : "FAIL") << endl;
+}
+
+void Tester::testBasicBadges() {
+    cout << "Testing Basic Badges..." << endl;
+
+    bool pass = checkBadges<LinearProbe>();
+    pass &= checkBadges<QuadraticProbe>();
+    pass &= checkBadges<DoubleHashProbe>();
+
+    cout << "Basic Badges Test: " << (pass ? "PASS" : "FAIL") << endl;
+}
+
+void Tester::testBasicAllocator() {
+    cout << "Testing Basic Allocator..." << endl;
+
+    bool pass = true;
+    {
+        BasicVacDB<string, Lot, NameHash, QuadraticProbe, CountingAllocator<pair<string, Lot>>> lots;
+        BasicVacDB<string, Lot, FunctionHash<string>, QuadraticProbe> reference(BASICMINCAP, {hashCode});
+        for (int i = 0; i < 3000; i++) {
+            string lot = "LOT-" + to_string(i * 7919 % 100000);
+            pass &= lots.insert(lot, Lot(i));
+            pass &= reference.insert(lot, Lot(i));
+        }
+        for (int i = 0; i < 3000; i += 3)
+            pass &= lots.remove("LOT-" + to_string(i * 7919 % 100000));
+        pass &= (allocatedBytes > 0 && liveLots == 5000);      // 2000 + 3000
+        for (int i = 0; i < 3000; i++) {
+            string lot = "LOT-" + to_string(i * 7919 % 100000);
+            const Lot* found = lots.find(lot);
+            pass &= (i % 3 == 0) ? (found == nullptr) : (found != nullptr && found->doses == i);
+            pass &= (reference.find(lot) != nullptr && reference.find(lot)->doses == i);
+        }
+    }
+    // every slot and every entry is given back
+    pass &= (allocatedBytes == 0 && liveLots == 0);
+
+    cout << "Basic Allocator Test: " << (pass ? "PASS" : "FAIL") << endl;
+}
+
+void Tester::testTimingWheel() {
+    cout << "Testing Timing Wheel..." << endl;
+
+    // deadlines on every level, on level boundaries and past the top level
+    TimingWheel wheel(5);
+    mt19937 generator(11);
+    vector<long long> pending;
+    const long long edges[] = {3, 5, 6, 63, 64, 65, 4095, 4096, 4097, 262144, 16777216, 1LL << 30, 1LL << 32};
+    for (long long when : edges)
+        pending.push_back(when);
+    for (int i = 0; i < 5000; i++)
+        pending.push_back(generator() % (1 << 22));
+    for (long long when : pending)
+        wheel.schedule(namesDB[when % 6], MINID, when);
+    bool pass = (wheel.size() == pending.size() && wheel.due() == 2);  // 3 and 5 are due at once
+
+    sort(pending.begin(), pending.end());
+    size_t next = 0;                    // pending[next] is the earliest deadline not taken
+    long long now = 5;
+    while (now < (1LL << 32) + 10) {
+        now += (now < (1 << 22)) ? 1 + generator() % 3000 : (1LL << 28);
+        wheel.advance(now);
+        ExpiryTimer timer;
+        long long last = -1;
+        while (wheel.popDue(timer)) {
+            pass &= (next < pending.size() && timer.when == pending[next] && timer.when <= now);
+            pass &= (timer.when >= last && timer.name == namesDB[timer.when % 6]);
+            last = timer.when;
+            next++;
+        }
+        // nothing due is left on the wheel
+        pass &= (next == pending.size() || pending[next] > now);
+        // deadlines scheduled behind the current tick are due at once
+        if (next < 3) {
+            wheel.schedule("late", MINID, now - 1);
+            pass &= wheel.popDue(timer) && timer.name == "late";
+        }
+    }
+    pass &= (next == pending.size() && wheel.size() == 0 && wheel.now() == now);
+
+    // only the upper levels and the overflow slot hold timers, one advance takes them all
+    TimingWheel sparse(0);
+    const long long far[] = {1760000000LL, 1700000000LL, (1LL << 33) + 7, 262143, 16777217};
+    for (long long when : far)
+        sparse.schedule("far", MINID, when);
+    sparse.advance(1760000000LL);
+    ExpiryTimer timer;
+    long long order[4] = {0, 0, 0, 0};
+    for (int i = 0; i < 4; i++)
+        pass &= sparse.popDue(timer) && (order[i] = timer.when) > 0;
+    pass &= (order[0] == 262143 && order[1] == 16777217 && order[2] == 1700000000LL && order[3] == 1760000000LL);
+    pass &= !sparse.popDue(timer) && sparse.size() == 1;
+    sparse.advance((1LL << 33) + 6);
+    pass &= !sparse.popDue(timer);
+    sparse.advance((1LL << 33) + 7);
+    pass &= sparse.popDue(timer) && timer.when == (1LL << 33) + 7;
+
+    cout << "Timing Wheel Test: " << (pass ? "PASS" : "FAIL") << endl;
+}
+
+void Tester::testExpiry() {
+    cout << "Testing Expiry..." << endl;
+
+    VacDB db(MINPRIME, hashCode, DOUBLEHASH);
+    bool pass = !db.setExpiry("john0", MINID, 10);          // expiry is off
+    const int patients = 4000;
+    for (int i = 0; i < patients; i++)
+        db.insert(Patient(namesDB[i % 6] + to_string(i), MINID + i % 100));
+    db.enableExpiry(true);
+    // patient i expires on tick 100 + i / 10
+    for (int i = 0; i < patients; i++)
+        pass &= db.setExpiry(namesDB[i % 6] + to_string(i), MINID + i % 100, 100 + i / 10);
+    pass &= !db.setExpiry("nobody", MINID, 10);
+    int peakCap = db.m_currentCap;
+
+    pass &= db.setExpiry("john0", MINID, 100000);           // moved later
+    pass &= db.updateSerialNumber(Patient("serina1", MINID + 1), MINID + 7);
+    pass &= (db.expire(99) == 0);
+    pass &= (db.expire(109) == 99);                         // ticks 100-109 less john0
+    pass &= db.getPatient("john0", MINID).getUsed();
+    pass &= !db.getPatient("celina3", MINID + 3).getUsed();
+    pass &= !db.getPatient("serina1", MINID + 7).getUsed(); // followed its new serial
+    pass &= (db.expire(200, 50) == 50);                     // budget
+    pass &= (db.expire(200) == 860);
+    int removed = 0;
+    for (long long now = 201; now < 600; now += 7)
+        removed += db.expire(now);
+    pass &= (removed == patients - 1 - 99 - 50 - 860);
+    pass &= (db.m_currentSize == 1 && db.getPatient("john0", MINID).getExpiry() == 100000);
+    // compaction kept the deleted buckets down and shrank the table back
+    pass &= (db.m_currNumDeleted <= 1 && db.m_currentCap < peakCap);
+
+    // deadlines survive turning expiry off and on, a reinserted patient starts without one
+    db.enableExpiry(false);
+    pass &= (db.expire(200000) == 0);
+    db.enableExpiry(true, 200000);
+    pass &= (db.expire(200000) == 1 && db.m_currentSize == 0);
+    Patient copy("mike2", MINID + 2);
+    copy.m_expires = 50;
+    pass &= db.insert(copy) && db.getPatient("mike2", MINID + 2).getExpiry() == NOEXPIRY;
+
+    cout << "Expiry Test: " << (pass ? "PASS" : "FAIL") << endl;
+}
+
+void Tester::testFreezeLookup() {
+    cout << "Testing Freeze Lookup..." << endl;
+
+    SlotBook book(7, 4, 40, 100);
+    VacDB db(MINPRIME, hashCode, QUADRATIC);
+    db.setSlotBook(&book);
+    const int patients = 20000;
+    for (int i = 0; i < patients; i++)                       // 6 names share every number
+        db.insert(Patient(namesDB[i % 6] + to_string(i / 6), MINID + i % 1000));
+    for (int i = 0; i < patients; i += 5)
+        db.remove(Patient(namesDB[i % 6] + to_string(i / 6), MINID + i % 1000));
+    db.bookSlot("john1", MINID + 6, 2, 1, 7);
+    FrozenVacDB frozen = db.freeze();
+
+    bool pass = (frozen.size() == db.m_currentSize && frozen.levels() > 0);
+    for (int i = 0; i < patients; i++) {
+        string name = namesDB[i % 6] + to_string(i / 6);
+        Patient live = db.getPatient(name, MINID + i % 1000);
+        Patient archived = frozen.getPatient(name, MINID + i % 1000);
+        pass &= (archived.getUsed() == live.getUsed() && archived.getKey() == live.getKey());
+        pass &= (archived.getSlot() == live.getSlot());
+        pass &= !frozen.contains(name, MINID + (i + 1) % 1000);   // other serial
+        pass &= !frozen.contains(name + "x", MINID + i % 1000);
+    }
+    pass &= (frozen.getPatient("john1", MINID + 6).getSlot() == book.slotId(2, 1, 7));
+    // minimal: one set bit per key and no record left over
+    long long bits = 0;
+    for (uint64_t word : frozen.m_bits)
+        bits += __builtin_popcountll(word);
+    pass &= (bits + (long long)frozen.m_fallback.size() == frozen.size());
+    pass &= (frozen.m_bits.size() * 64 < 4.0 * frozen.size());
+    pass &= (frozen.memoryUsage() < db.memoryUsage() / 2);
+    // the snapshot does not follow the table
+    db.insert(Patient("serina", MINID));
+    pass &= !frozen.contains("serina", MINID);
+
+    VacDB empty(MINPRIME, hashCode, LINEAR);
+    FrozenVacDB none = empty.freeze();
+    pass &= (none.size() == 0 && !none.contains("john", MINID));
+
+    cout << "Freeze Lookup Test: " << (pass ? "PASS" : "FAIL") << endl;
+}
+
+void Tester::testFreezeSaveLoad() {
+    cout << "Testing Freeze Save Load..." << endl;
+
+    VacDB db(MINPRIME, hashCode, DOUBLEHASH);
+    for (int i = 0; i < 5000; i++)
+        db.insert(Patient(namesDB[i % 6] + to_string(i), MINID + i % 2000));
+    FrozenVacDB frozen = db.freeze();
+    FILE* file = tmpfile();
+    bool pass = frozen.save(fileno(file));
+    long long length = lseek(fileno(file), 0, SEEK_END);
+
+    FrozenVacDB loaded;
+    lseek(fileno(file), 0, SEEK_SET);
+    pass &= loaded.load(fileno(file));
+    pass &= (loaded.size() == 5000 && loaded.memoryUsage() == frozen.memoryUsage());
+    for (int i = 0; i < 5000; i++)
+        pass &= loaded.contains(namesDB[i % 6] + to_string(i), MINID + i % 2000);
+    pass &= !loaded.contains("john1", MINID + 1);
+
+    // a cut file is rejected and leaves the snapshot empty
+    pass &= (ftruncate(fileno(file), length - 3) == 0);
+    lseek(fileno(file), 0, SEEK_SET);
+    pass &= !loaded.load(fileno(file)) && loaded.size() == 0 && !loaded.contains("john0", MINID);
+    fclose(file);
+    // so is another kind of file
+    file = tmpfile();
+    db.exportBinary(fileno(file));
+    lseek(fileno(file), 0, SEEK_SET);
+    pass &= !loaded.load(fileno(file));
+    fclose(file);
+    // sizes larger than the data are refused before they are allocated, from a file and a pipe
+    ExportHeader header = {FROZENMAGIC, FROZENVERSION};
+    uint64_t sizes[5] = {0, 0, 0, 0, 3ULL << 30};       // records, levels, bit words, fallback, arena
+    file = tmpfile();
+    write(fileno(file), &header, sizeof(header));
+    write(fileno(file), sizes, sizeof(sizes));
+    write(fileno(file), "john", 4);
+    lseek(fileno(file), 0, SEEK_SET);
+    pass &= !loaded.load(fileno(file)) && loaded.size() == 0;
+    fclose(file);
+    int ends[2];
+    pass &= (pipe(ends) == 0);
+    write(ends[1], &header, sizeof(header));
+    write(ends[1], sizes, sizeof(sizes));
+    write(ends[1], "john", 4);
+    close(ends[1]);
+    pass &= !loaded.load(ends[0]) && loaded.size() == 0;
+    close(ends[0]);
+
+    cout << "Freeze Save Load Test: " << (pass ? "PASS" : "FAIL") << endl;
+}
+
+void Tester::testPageAllocator() {
+    cout << "Testing Page Allocator..." << endl;
+
+    // small arrays stay on the heap whatever is asked
+    const PagePolicy thp = {PAGETHP, NUMADEFAULT, 0};
+    char* small = (char*)allocatePages(1000, thp);
+    bool pass = (small != nullptr && pageBacking(small) == PAGESMALL && !numaPlaced(small));
+    pass &= ((uintptr_t)small % 64 == 0);
+    for (int i = 0; i < 1000; i++)
+        pass &= (small[i] == 0);
+    freePages(small);
+
+    // every request gets zeroed memory, falling back to what the kernel grants
+    const PagePolicy policies[] = {DEFPAGES, thp, {PAGEHUGETLB, NUMADEFAULT, 0},
+                                   {PAGETHP, NUMAINTERLEAVE, 0}, {PAGESMALL, NUMABIND, 0},
+                                   {PAGESMALL, NUMABIND, 1000}};
+    const size_t bytes = 3 * HUGEPAGE + 12345;
+    for (const PagePolicy& policy : policies) {
+        long long* data = (long long*)allocatePages(bytes, policy);
+        pass &= (data != nullptr && (uintptr_t)data % 64 == 0);
+        if (data == nullptr) continue;
+        size_t count = bytes / sizeof(long long);
+        for (size_t i = 0; i < count; i += 4096)
+            pass &= (data[i] == 0);
+        data[count - 1] = 7;
+        page_t backing = pageBacking(data);
+        pass &= (policy.pages == PAGESMALL) ? (backing == PAGESMALL) : (backing <= policy.pages);
+        if (policy.numa == NUMADEFAULT || policy.node >= 1000)
+            pass &= !numaPlaced(data);      // nothing asked, or no such node
+        freePages(data);
+    }
+    freePages(nullptr);
+
+    cout << "Page Allocator Test: " << (pass ? "PASS" : "FAIL") << endl;
+}
+
+void Tester::testPagePolicyTable() {
+    cout << "Testing Page Policy Table..." << endl;
+
+    bool pass = true;
+    prob_t probings[] = {DOUBLEHASH, ROBINHOOD, CUCKOO};
+    for (prob_t probing : probings) {
+        VacDB db(300000, hashCode, probing);
+        pass &= (db.tablePages() == PAGESMALL);
+        for (int i = 0; i < 20000; i++)
+            db.insert(Patient(namesDB[i % 6] + to_string(i), MINID + i % 5000));
+        // switching moves the buckets as they are
+        int cap = db.m_currentCap;
+        db.setPagePolicy({PAGETHP, NUMAINTERLEAVE, 0});
+        pass &= (db.m_currentCap == cap && db.m_currentSize == 20000);
+        pass &= (db.tablePages() == PAGETHP || db.tablePages() == PAGESMALL);
+        for (int i = 0; i < 20000; i++)
+            pass &= (db.getPatient(namesDB[i % 6] + to_string(i), MINID + i % 5000).getKey() != "");
+        // a rehash keeps the policy
+        for (int i = 20000; i < 400000; i++)
+            db.insert(Patient(namesDB[i % 6] + to_string(i), MINID + i % 5000));
+        pass &= (db.m_currentCap > cap && db.tablePages() != PAGEHUGETLB);
+        for (int i = 0; i < 400000; i += 21)
+            pass &= (db.getPatient(namesDB[i % 6] + to_string(i), MINID + i % 5000).getKey() != "");
+        for (int i = 0; i < 400000; i += 2)
+            db.remove(Patient(namesDB[i % 6] + to_string(i), MINID + i % 5000));
+        db.setPagePolicy(DEFPAGES);
+        pass &= (db.tablePages() == PAGESMALL && db.m_currentSize == 200000);
+        for (int i = 1; i < 400000; i += 42)
+            pass &= (db.getPatient(namesDB[i % 6] + to_string(i), MINID + i % 5000).getKey() != "");
+    }
+
+    cout << "Page Policy Table Test: " << (pass ? "PASS" : "FAIL") << endl;
+}
+
+void Tester::testChangeStreamRing() {
+    cout << "Testing Change Stream Ring..." << endl;
+
+    const string segment = "vacdb-test-ring-" + to_string(getpid());
+    ChangeStream stream;
+    ChangeReader reader;
+    bool pass = !reader.open(segment);
+    pass &= stream.open(segment, 1000);     // rounded up to 4096 bytes
+    pass &= reader.open(segment) && !reader.closed();
+    TraceEntry entry;
+    pass &= !reader.next(entry);
+    // records wrap around the end of the ring many times, long names included
+    int read = 0;
+    for (int i = 0; i < 3000; i++) {
+        string name = namesDB[i % 6] + string(i % 7 == 0 ? 300 : i % 5, 'x') + to_string(i);
+        pass &= stream.publish(TRACEINSERT, name, MINID + i, i, i % 2);
+        if (i % 3 == 2) {
+            while (reader.next(entry)) {
+                string expected = namesDB[read % 6] + string(read % 7 == 0 ? 300 : read % 5, 'x') + to_string(read);
+                pass &= (entry.op == TRACEINSERT && entry.name == expected && entry.serial == MINID + read);
+                pass &= (entry.arg == read && entry.outcome == (read % 2 == 1));
+                read++;
+            }
+        }
+    }
+    pass &= (read == 3000 && stream.backlog() == 0 && !stream.lost());
+    // a standby that stops reading makes the stream lost instead of stalling the primary
+    int published = 0;
+    while (published < 1000 && stream.publish(TRACEREMOVE, "john", MINID, 0, true))
+        published++;
+    pass &= (published > 0 && published < 1000 && stream.lost());
+    pass &= !stream.publish(TRACEREMOVE, "", MINID, 0, true);
+    while (reader.next(entry))
+        published--;
+    pass &= (published == 0 && reader.lost() && reader.closed());
+
+    // after a close the reader drains the rest and then sees the stream closed
+    pass &= stream.open(segment, 4096);
+    ChangeReader second;
+    pass &= second.open(segment);
+    stream.publish(TRACEPOLICY, "", 0, CUCKOO, true);
+    stream.publish(TRACEDEADLINE, "john", MINID, 5000000000LL, true);     // past 2^31 ticks
+    stream.close();
+    pass &= !second.closed() && second.next(entry) && entry.arg == CUCKOO;
+    pass &= second.next(entry) && entry.op == TRACEDEADLINE && entry.arg == 5000000000LL;
+    pass &= !second.next(entry) && second.closed() && !second.lost();
+    pass &= !second.open(segment);          // unlinked
+
+    cout << "Change Stream Ring Test: " << (pass ? "PASS" : "FAIL") << endl;
+}
+
+void Tester::testStandbyReplica() {
+    cout << "Testing Standby Replica..." << endl;
+
+    auto contents = [](const VacDB& db) {
+        vector<string> keys;
+        db.forEach([&keys](const Patient& p) {
+            keys.push_back(p.getKey() + "/" + to_string(p.getSerial()) + "/" + to_string(p.getExpiry()) + "/" + to_string(p.getSlot()));
+        });
+        sort(keys.begin(), keys.end());
+        return keys;
+    };
+    bool pass = true;
+    prob_t probings[] = {QUADRATIC, ROBINHOOD, CUCKOO};
+    for (prob_t probing : probings) {
+        const string segment = "vacdb-test-standby-" + to_string(getpid());
+        // the allocator range reaches below MINID and above MAXID, only the primary has it
+        SerialAllocator serials(1, 12000);
+        SlotBook book(7, 4, 40, 100), standbyBook(7, 4, 40, 100);
+        VacDB primary(MINPRIME, hashCode, probing);
+        primary.setSerialAllocator(&serials);
+        primary.setSlotBook(&book);
+        for (int i = 0; i < 500; i++)       // stored before streaming, sent as the seed
+            primary.insert(Patient(namesDB[i % 6] + to_string(i % 200), 1 + i));
+        primary.bookSlot("john0", 1, 2, 1, 7);
+        primary.enableExpiry(true);
+        primary.setExpiry("john0", 1, 40);
+        pass &= primary.startStream(segment, 4096);    // the seed alone is larger
+
+        ChangeReader reader;
+        pass &= reader.open(segment);
+        VacDB* standby = nullptr;
+        int diverged = 0;
+        auto drain = [&]() {
+            TraceEntry entry;
+            while (reader.next(entry)) {
+                if (entry.op == TRACEOPEN) {
+                    delete standby;
+                    standby = new VacDB(entry.serial, hashCode, (prob_t)entry.arg);
+                    standby->setSlotBook(&standbyBook);
+                } else if (standby != nullptr) {
+                    diverged += !standby->applyChange(entry);
+                }
+            }
+        };
+        for (int i = 0; i < 20000; i++) {
+            string name = namesDB[i % 6] + to_string(i % 3000);
+            int serial = 1 + i % 11000;
+            switch (i % 10) {
+                case 0: case 1: case 2: case 3: case 4:
+                    if (primary.insert(Patient(name, serial)) && i % 3 == 0)
+                        primary.bookSlot(name, serial, i % 7, i % 4, i % 40);
+                    break;
+                case 5: case 6:     // by name only, repeated names make it pick one
+                    primary.remove(Patient(name, 0)); break;
+                case 7:
+                    primary.updateSerialNumber(Patient(name, 0), 1 + i % 12000); break;
+                case 8:
+                    primary.setExpiry(name, 1 + (i - 8) % 11000, i / 100 + 50); break;
+                default:
+                    if (i % 1000 == 9) primary.expire(i / 100, 50);
+                    if (i % 5000 == 9) primary.changeProbPolicy((prob_t)((i / 5000) % 3));
+                    if (i == 10009) primary.setMaxLoad(0.4);
+            }
+            if (i % 97 == 0)
+                drain();
+        }
+        primary.stopStream();
+        drain();
+        pass &= (reader.closed() && !reader.lost() && diverged == 0 && standby != nullptr);
+        if (standby == nullptr) continue;
+        // same patients, deadlines and slots on both sides, grown the same way
+        vector<string> live = contents(primary);
+        pass &= (live == contents(*standby) && !live.empty());
+        pass &= (standby->m_maxLoad == primary.m_maxLoad && standby->capacity() == primary.capacity());
+        for (int slot = 0; slot < 7 * 4 * 40; slot++)
+            pass &= (standbyBook.booked(slot) == book.booked(slot));
+        delete standby;
+    }
+
+    // the reviewer's case: three patients of one name, the name-only calls pick by probe
+    // order on the primary and the copy under another policy follows the serials streamed
+    const string segment = "vacdb-test-twins-" + to_string(getpid());
+    VacDB primary(101, hashCode, LINEAR);
+    pass &= primary.startStream(segment, 4096);
+    ChangeReader reader;
+    pass &= reader.open(segment);
+    VacDB copy(101, hashCode, ROBINHOOD);
+    for (int serial = 1001; serial <= 1003; serial++)
+        primary.insert(Patient("john", serial));
+    pass &= !primary.insert(Patient("john", 1001));                 // fails, skipped
+    pass &= primary.remove(Patient("john", 1003)) && primary.updateSerialNumber(Patient("john", 1003), 1004);
+    primary.stopStream();
+    TraceEntry entry;
+    while (reader.next(entry))
+        pass &= (entry.op == TRACEOPEN || copy.applyChange(entry));
+    pass &= (contents(copy) == contents(primary) && copy.m_currentSize == 2);
+
+    cout << "Standby Replica Test: " << (pass ? "PASS" : "FAIL") << endl;
+}
+
+void Tester::testZipfTable() {
+    cout << "Testing Zipf Table..." << endl;
+
+    // draws follow (r + 1)^-s within a few standard deviations
+    bool pass = true;
+    const int draws = 1000000;
+    for (double s : {0.0, 0.7, 1.2}) {
+        const int n = 50;
+        ZipfTable table(n, s);
+        vector<int> counts(n, 0);
+        mt19937_64 bits(7);
+        for (int i = 0; i < draws; i++) {
+            int rank = table.sample(bits());
+            pass &= (rank >= 0 && rank < n);
+            if (rank >= 0 && rank < n) counts[rank]++;
+        }
+        double total = 0;
+        for (int r = 0; r < n; r++) total += pow(r + 1.0, -s);
+        for (int r = 0; r < n; r++) {
+            double expected = draws * pow(r + 1.0, -s) / total;
+            pass &= (fabs(counts[r] - expected) < 5 * sqrt(expected) + 1);
+        }
+    }
+    ZipfTable single(1, 1.0);
+    pass &= (single.sample(0) == 0 && single.sample(UINT64_MAX) == 0);
+
+    cout << "Zipf Table Test: " << (pass ? "PASS" : "FAIL") << endl;
+}
+
+void Tester::testWorkloadDeterminism() {
+    cout << "Testing Workload Determinism..." << endl;
+
+    WorkloadConfig config = DEFWORKLOAD;
+    config.operations = 5 * WORKCHUNK + 1234;
+    config.seed = 99;
+    Workload workload(config);
+    bool pass = (workload.chunks() == 6);
+    // the stream is the same on any number of threads and chunk by chunk
+    vector<TraceEntry> single, parallel, chunk;
+    workload.run(1, [&](const vector<TraceEntry>& ops) {single.insert(single.end(), ops.begin(), ops.end());});
+    workload.run(3, [&](const vector<TraceEntry>& ops) {parallel.insert(parallel.end(), ops.begin(), ops.end());});
+    pass &= (single.size() == (size_t)config.operations && parallel.size() == single.size());
+    workload.generate(4, chunk);
+    for (size_t i = 0; i < single.size() && i < parallel.size(); i++) {
+        pass &= (single[i].op == parallel[i].op && single[i].name == parallel[i].name);
+        pass &= (single[i].serial == parallel[i].serial && single[i].outcome == parallel[i].outcome);
+    }
+    for (int i = 0; i < WORKCHUNK; i++)
+        pass &= (chunk[i].name == single[4 * WORKCHUNK + i].name && chunk[i].op == single[4 * WORKCHUNK + i].op);
+
+    // exact shares, inserts number the patients in order, the others pick inserted ones
+    long long counts[3] = {0, 0, 0};
+    long long inserted = 0;
+    vector<string> names;
+    for (const TraceEntry& entry : single) {
+        counts[entry.op - TRACEINSERT]++;
+        if (entry.op == TRACEINSERT) {
+            pass &= (entry.name == workload.patientName(inserted) && entry.serial == workload.patientSerial(inserted));
+            pass &= (entry.serial >= MINID && entry.serial <= MAXID);
+            inserted++;
+        }
+        names.push_back(entry.name);
+    }
+    pass &= (counts[0] == 5 * (WORKCHUNK / 2) + 617);
+    pass &= (counts[2] == 5 * (WORKCHUNK * 4 / 10) + 1234 * 4 / 10);
+    pass &= (counts[0] + counts[1] + counts[2] == config.operations);
+    // popular names repeat, the corpus keeps most names apart
+    sort(names.begin(), names.end());
+    long long distinct = unique(names.begin(), names.end()) - names.begin();
+    pass &= (distinct > inserted / 2 && distinct < inserted);
+
+    // another seed is another population
+    config.seed = 100;
+    Workload other(config);
+    int same = 0;
+    for (int k = 0; k < 1000; k++)
+        same += (other.patientName(k) == workload.patientName(k));
+    pass &= (same < 100);
+
+    // every expected outcome holds when the operations run against a table one
+    // by one or a chunk at a time, also with the most common name repeated over
+    // a thousand times
+    prob_t probings[] = {DOUBLEHASH, ROBINHOOD};
+    for (prob_t probing : probings) {
+        VacDB db(MINPRIME, hashCode, probing);
+        int differ = 0, failed = 0;
+        for (const TraceEntry& entry : single) {
+            differ += (applyTraceEntry(db, entry) != entry.outcome);
+            failed += !entry.outcome;
+        }
+        pass &= (differ == 0 && failed > 0);
+    }
+    config.zipf = 1.0;
+    config.operations = 3 * WORKCHUNK;
+    Workload skewed(config);
+    VacDB db(MINPRIME, hashCode, DOUBLEHASH);
+    int differ = 0, removed = 0;
+    skewed.run(2, [&](vector<TraceEntry>& ops) {
+        vector<TraceEntry> batch = ops;
+        db.runBatch(batch);
+        for (size_t i = 0; i < ops.size(); i++) {
+            differ += (batch[i].outcome != ops[i].outcome);
+            removed += (ops[i].op == TRACEREMOVE && ops[i].outcome);
+        }
+    });
+    pass &= (differ == 0 && removed > 0);
+
+    cout << "Workload Determinism Test: " << (pass ? "PASS" : "FAIL") << endl;
+}
+
+void Tester::testSnapshotConsistency() {
+    cout << "Testing Snapshot Consistency..." << endl;
+
+    auto contents = [](const auto& view) {
+        vector<string> keys;
+        view.forEach([&keys](const Patient& p) {
+            keys.push_back(p.getKey() + "/" + to_string(p.getSerial()) + "/" + to_string(p.getExpiry()));
+        });
+        sort(keys.begin(), keys.end());
+        return keys;
+    };
+    bool pass = true;
+    for (prob_t policy : {QUADRATIC, DOUBLEHASH, LINEAR, ROBINHOOD, CUCKOO}) {
+        VacDB db(20011, hashCode, policy);
+        db.enableExpiry(true);
+        for (int i = 0; i < 3000; i++)
+            db.insert(Patient(namesDB[i % 6] + to_string(i), MINID + i));
+        for (int i = 0; i < 3000; i += 7)
+            db.setExpiry(namesDB[i % 6] + to_string(i), MINID + i, 100 + i);
+        vector<string> before = contents(db);
+        VacSnapshot view = db.snapshot();
+        pass &= (view.size() == 3000 && view.pagesCopied() == 0);
+
+        // every kind of write, each page is copied once at most
+        for (int i = 0; i < 3000; i += 3)
+            db.remove(Patient(namesDB[i % 6] + to_string(i), MINID + i));
+        for (int i = 1; i < 3000; i += 3)
+            db.updateSerialNumber(Patient(namesDB[i % 6] + to_string(i), MINID + i), MINID + 5000 + i);
+        for (int i = 2; i < 3000; i += 3)
+            db.setExpiry(namesDB[i % 6] + to_string(i), MINID + i, 7);
+        for (int i = 3000; i < 4000; i++)
+            db.insert(Patient(namesDB[i % 6] + to_string(i), MINID + i));
+        pass &= (db.capacity() == 20011);
+        pass &= (contents(view) == before && contents(db) != before);
+        pass &= (view.pagesCopied() > 0 && view.pagesCopied() <= (20011 + CUCKOOSTASH) / SNAPPAGE + 1);
+
+        // a rehash copies what is left and the view stays put
+        vector<string> after = contents(db);
+        VacSnapshot second = db.snapshot();
+        for (int i = 4000; i < 30000; i++)
+            db.insert(Patient(namesDB[i % 6] + to_string(i), 1000 + i % 9000));
+        pass &= (db.capacity() > 20011);
+        pass &= (contents(view) == before && contents(second) == after);
+
+        // writes after the handle is gone release the state
+        { VacSnapshot third = db.snapshot(); }
+        db.insert(Patient("after release", MINID));
+        pass &= (db.m_snapshot == nullptr);
+    }
+
+    cout << "Snapshot Consistency Test: " << (pass ? "PASS" : "FAIL") << endl;
+}
+
+void Tester::testSnapshotConcurrentScan() {
+    cout << "Testing Snapshot Concurrent Scan..." << endl;
+
+    bool pass = true;
+    for (prob_t policy : {DOUBLEHASH, ROBINHOOD}) {
+        VacDB* db = new VacDB(200003, hashCode, policy);
+        for (int i = 0; i < 60000; i++)
+            db->insert(Patient(namesDB[i % 6] + to_string(i), MINID + i % 9000));
+        long long expected = 0;
+        db->forEach([&expected](const Patient& p) {expected += p.getSerial() + p.getKey().size();});
+        VacSnapshot view = db->snapshot();
+
+        // readers scan the view again and again while the owner keeps writing
+        atomic<bool> writing(true);
+        atomic<int> scans(0), wrong(0);
+        thread reader([&]() {
+            while (writing.load() || scans.load() < 2) {
+                atomic<long long> sum(0), count(0);
+                view.parallelForEach([&](const Patient& p) {
+                    sum += p.getSerial() + p.getKey().size();
+                    count++;
+                }, 2);
+                wrong += (sum != expected || count != 60000);
+                scans++;
+            }
+        });
+        for (int i = 0; i < 120000; i++) {
+            string name = namesDB[i % 6] + to_string(i % 90000);
+            if (i % 2 == 0)
+                db->remove(Patient(name, MINID + i % 9000));
+            else
+                db->insert(Patient(name, MINID + (i + 1) % 9000));
+        }
+        writing = false;
+        reader.join();
+        pass &= (scans > 0 && wrong == 0 && view.pagesCopied() > 0);
+
+        // the view outlives the table
+        delete db;
+        long long sum = 0;
+        view.forEach([&sum](const Patient& p) {sum += p.getSerial() + p.getKey().size();});
+        pass &= (sum == expected);
+    }
+
+    cout << "Snapshot Concurrent Scan Test: " << (pass ? "PASS" : "FAIL") << endl;
+}
+
 
 int main() {
     vector<Patient> dataList;
@@ -638,6 +2416,43 @@ int main() {
     Tester::testInsertionBoundarySerialNumbers();
     Tester::testRemoveNonExistent();
     Tester::testRemoveAcrossTables();
+    Tester::testRobinHoodColliding();
+    Tester::testRobinHoodRemove();
+    Tester::testCuckooColliding();
+    Tester::testCuckooStashAndRehash();
+    Tester::testSlotBookFindNext();
+    Tester::testSlotReleaseOnRemove();
+    Tester::testPrefixSearch();
+    Tester::testEditDistanceKernel();
+    Tester::testFuzzySearch();
+    Tester::testExportText();
+    Tester::testExportBinary();
+    Tester::testSerialAllocator();
+    Tester::testSerialUniqueness();
+    Tester::testNameFilter();
+    Tester::testFilterAcrossRehash();
+    Tester::testCompactInsertFind();
+    Tester::testCompactRemoveRehash();
+    Tester::testIteration();
+    Tester::testParallelReduce();
+    Tester::testRequestProtocol();
+    Tester::testRequestServerBatch();
+    Tester::testTraceRecord();
+    Tester::testTraceReplay();
+    Tester::testBasicBadges();
+    Tester::testBasicAllocator();
+    Tester::testTimingWheel();
+    Tester::testExpiry();
+    Tester::testFreezeLookup();
+    Tester::testFreezeSaveLoad();
+    Tester::testPageAllocator();
+    Tester::testPagePolicyTable();
+    Tester::testChangeStreamRing();
+    Tester::testStandbyReplica();
+    Tester::testZipfTable();
+    Tester::testWorkloadDeterminism();
+    Tester::testSnapshotConsistency();
+    Tester::testSnapshotConcurrentScan();
 
 
 
@@ -0,0 +1,93 @@
+// CMSC 341 - Spring 2024 - Project 4
+#include "namefilter.h"
+
+/**
+ * Name: NameFilter Constructor
+ * Desc: Allocates FILTERCOUNTERS counters per expected name, rounded up to whole blocks.
+ *       With four probes the false positive rate stays around 3% up to capacity names.
+ * Preconditions: capacity is non-negative.
+ * Postconditions: The filter is empty.
+ */
+NameFilter::NameFilter(int capacity)
+    : m_blocks(((size_t)capacity * FILTERCOUNTERS + 127) / 128 + 1, Block{}) {}
+
+
+// 64-bit FNV-1a of the name, finished with the MurmurHash3 mixer so that
+// both halves of the result are usable
+uint64_t NameFilter::hashName(const string& name) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (char c : name) {
+        hash ^= (unsigned char)c;
+        hash *= 1099511628211ULL;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+
+// the block of a hash, picked from its upper 32 bits without a division
+size_t NameFilter::blockIndex(uint64_t hash) const {
+    return ((hash >> 32) * m_blocks.size()) >> 32;
+}
+
+
+/**
+ * Name: add
+ * Desc: Increments the FILTERPROBES counters of the name, each chosen by 7 bits of the hash.
+ * Preconditions: None.
+ * Postconditions: mayContain(name) is true until the name is removed as often as it was added.
+ */
+void NameFilter::add(const string& name) {
+    uint64_t hash = hashName(name);
+    Block& target = m_blocks[blockIndex(hash)];
+    for (int probe = 0; probe < FILTERPROBES; probe++) {
+        int counter = (hash >> (7 * probe)) & 127;
+        uint64_t& word = target.words[counter >> 4];
+        int shift = (counter & 15) * 4;
+        if (((word >> shift) & 15) != 15)
+            word += 1ULL << shift;
+    }
+}
+
+
+/**
+ * Name: remove
+ * Desc: Decrements the counters of the name. Saturated counters are left alone since they no
+ *       longer know how many names they count.
+ * Preconditions: The name was added and not removed since.
+ * Postconditions: The name is counted once less.
+ */
+void NameFilter::remove(const string& name) {
+    uint64_t hash = hashName(name);
+    Block& target = m_blocks[blockIndex(hash)];
+    for (int probe = 0; probe < FILTERPROBES; probe++) {
+        int counter = (hash >> (7 * probe)) & 127;
+        uint64_t& word = target.words[counter >> 4];
+        int shift = (counter & 15) * 4;
+        uint64_t count = (word >> shift) & 15;
+        if (count != 0 && count != 15)
+            word -= 1ULL << shift;
+    }
+}
+
+
+/**
+ * Name: mayContain
+ * Desc: Checks the counters of the name, all in one cache line.
+ * Preconditions: None.
+ * Postconditions: Returns false only if the name is not in the filter.
+ */
+bool NameFilter::mayContain(const string& name) const {
+    uint64_t hash = hashName(name);
+    const Block& target = m_blocks[blockIndex(hash)];
+    for (int probe = 0; probe < FILTERPROBES; probe++) {
+        int counter = (hash >> (7 * probe)) & 127;
+        if (((target.words[counter >> 4] >> ((counter & 15) * 4)) & 15) == 0)
+            return false;
+    }
+    return true;
+}
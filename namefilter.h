@@ -0,0 +1,36 @@
+// CMSC 341 - Spring 2024 - Project 4
+#ifndef NAMEFILTER_H
+#define NAMEFILTER_H
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+using namespace std;
+const int FILTERCOUNTERS = 8;   // 4-bit counters per expected name
+const int FILTERPROBES = 4;     // counters a name sets within its block
+
+// Blocked counting Bloom filter over patient names. All counters of a name
+// sit in one 64-byte block, so a lookup reads a single cache line. Counters
+// are 4 bits wide, which lets names be removed. A counter that reaches 15
+// sticks there, trading a little accuracy for never forgetting a name.
+class NameFilter{
+    public:
+    friend class Tester;
+    // sized for about capacity names
+    NameFilter(int capacity);
+    void add(const string& name);
+    void remove(const string& name);
+    // false means the name was never added or has been removed as often as added
+    bool mayContain(const string& name) const;
+    size_t memoryUsage() const {return m_blocks.size() * sizeof(Block);}
+
+    private:
+    struct alignas(64) Block{
+        uint64_t words[8];  // 128 counters, 16 per word
+    };
+    vector<Block> m_blocks;
+
+    static uint64_t hashName(const string& name);
+    size_t blockIndex(uint64_t hash) const;
+};
+#endif
@@ -0,0 +1,136 @@
+// CMSC 341 - Spring 2024 - Project 4
+#include "pagealloc.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+const int MAXNODES = 64;            // nodes a mask covers
+
+// Sits in front of every allocation and tells freePages how to release it
+struct alignas(64) PageHeader{
+    void* base;         // start of the mapping or of the heap block
+    size_t length;      // bytes mapped, 0 for a heap block
+    page_t backing;
+    bool placed;
+};
+
+static PageHeader* headerOf(const void* data) {
+    return (PageHeader*)data - 1;
+}
+
+// Returns the mask of the online NUMA nodes, node 0 if sysfs does not say
+static unsigned long onlineNodes() {
+    unsigned long mask = 0;
+    FILE* file = fopen("/sys/devices/system/node/online", "r");
+    if (file != nullptr) {
+        int first, last;
+        char separator;
+        // a list such as "0-3,5"
+        while (fscanf(file, "%d", &first) == 1) {
+            last = first;
+            if (fscanf(file, "%c", &separator) == 1 && separator == '-') {
+                if (fscanf(file, "%d", &last) != 1) break;
+                if (fscanf(file, "%c", &separator) != 1) separator = '\n';
+            }
+            for (int node = first; node <= last && node < MAXNODES; node++)
+                mask |= 1UL << node;
+            if (separator != ',') break;
+        }
+        fclose(file);
+    }
+    return mask ? mask : 1;
+}
+
+// applies the NUMA placement to a fresh mapping, before any page is touched
+static bool place(void* base, size_t length, const PagePolicy& policy) {
+    if (policy.numa == NUMADEFAULT) return false;
+    unsigned long mask;
+    int mode;
+    if (policy.numa == NUMAINTERLEAVE) {
+        mask = onlineNodes();
+        mode = MPOL_INTERLEAVE;
+    } else {
+        if (policy.node < 0 || policy.node >= MAXNODES) return false;
+        mask = 1UL << policy.node;
+        mode = MPOL_BIND;
+    }
+    return syscall(SYS_mbind, base, length, mode, &mask, MAXNODES + 1, 0) == 0;
+}
+
+// maps length bytes aligned to a huge page, so that every 2 MB of it can be one huge page
+static void* mapAligned(size_t length) {
+    void* raw = mmap(nullptr, length + HUGEPAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) return nullptr;
+    uintptr_t start = ((uintptr_t)raw + HUGEPAGE - 1) & ~(uintptr_t)(HUGEPAGE - 1);
+    size_t head = start - (uintptr_t)raw;
+    if (head > 0)
+        munmap(raw, head);
+    if (HUGEPAGE - head > 0)
+        munmap((char*)start + length, HUGEPAGE - head);
+    return (void*)start;
+}
+
+
+/**
+ * Name: allocatePages
+ * Desc: Arrays under HUGEPAGE, and arrays on ordinary pages with no NUMA placement, come from the
+ *       heap as before. Others are mapped: from the hugetlbfs pool when asked and reserved, else
+ *       aligned to a huge page and marked MADV_HUGEPAGE when asked, and placed with mbind before
+ *       the header touches the first page.
+ * Preconditions: bytes is not 0.
+ * Postconditions: Returns zeroed memory aligned to 64 bytes, released with freePages.
+ */
+void* allocatePages(size_t bytes, const PagePolicy& policy) {
+    const size_t total = bytes + sizeof(PageHeader);
+    PageHeader header = {nullptr, 0, PAGESMALL, false};
+    if (bytes < HUGEPAGE || (policy.pages == PAGESMALL && policy.numa == NUMADEFAULT)) {
+        header.base = aligned_alloc(alignof(PageHeader), (total + 63) / 64 * 64);
+        if (header.base == nullptr) return nullptr;
+        memset(header.base, 0, total);
+    } else {
+        header.length = (total + HUGEPAGE - 1) / HUGEPAGE * HUGEPAGE;
+        if (policy.pages == PAGEHUGETLB) {
+            void* base = mmap(nullptr, header.length, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (base != MAP_FAILED) {
+                header.base = base;
+                header.backing = PAGEHUGETLB;
+            }
+        }
+        if (header.base == nullptr) {
+            header.base = mapAligned(header.length);
+            if (header.base == nullptr) return nullptr;
+            if (policy.pages != PAGESMALL && madvise(header.base, header.length, MADV_HUGEPAGE) == 0)
+                header.backing = PAGETHP;
+        }
+        header.placed = place(header.base, header.length, policy);
+    }
+    PageHeader* at = (PageHeader*)header.base;
+    *at = header;
+    return at + 1;
+}
+
+
+void freePages(void* data) {
+    if (data == nullptr) return;
+    PageHeader* header = headerOf(data);
+    if (header->length == 0)
+        free(header->base);
+    else
+        munmap(header->base, header->length);
+}
+
+
+page_t pageBacking(const void* data) {
+    return headerOf(data)->backing;
+}
+
+
+bool numaPlaced(const void* data) {
+    return headerOf(data)->placed;
+}
@@ -0,0 +1,60 @@
+// CMSC 341 - Spring 2024 - Project 4
+#ifndef PAGEALLOC_H
+#define PAGEALLOC_H
+#include <cstddef>
+#include <new>
+using namespace std;
+const size_t HUGEPAGE = 2 << 20;    // x86-64 huge page, smaller arrays stay on the heap
+
+// Backing asked for and obtained: ordinary pages, transparent huge pages
+// requested with madvise, or pages of the reserved hugetlbfs pool
+enum page_t {PAGESMALL, PAGETHP, PAGEHUGETLB};
+// Placement over the NUMA nodes: first touch, interleaved over the online
+// nodes, or bound to one node
+enum numa_t {NUMADEFAULT, NUMAINTERLEAVE, NUMABIND};
+
+// How VacDB allocates its bucket arrays
+struct PagePolicy{
+    page_t pages;
+    numa_t numa;
+    int node;           // node of NUMABIND
+};
+const PagePolicy DEFPAGES = {PAGESMALL, NUMADEFAULT, 0};
+
+// Returns zeroed memory for bytes, or nullptr if even ordinary pages are
+// not available. HUGETLB falls back to THP and THP to ordinary pages when
+// the kernel refuses them, and a NUMA placement the kernel refuses is
+// skipped, so the policy is a request
+void* allocatePages(size_t bytes, const PagePolicy& policy);
+void freePages(void* data);
+// Returns the backing an allocation got
+page_t pageBacking(const void* data);
+// Returns true if the NUMA placement of the allocation was applied
+bool numaPlaced(const void* data);
+
+// Allocator that puts the storage of a standard container under a PagePolicy,
+// used for the SlotBook arrays. Any two compare equal since freePages takes
+// every allocation
+template <class T>
+class PageAllocator{
+    public:
+    typedef T value_type;
+    PageAllocator(const PagePolicy& policy = DEFPAGES) : m_policy(policy) {}
+    template <class U>
+    PageAllocator(const PageAllocator<U>& other) : m_policy(other.policy()) {}
+    T* allocate(size_t count) {
+        void* data = allocatePages(count * sizeof(T), m_policy);
+        if (data == nullptr) throw bad_alloc();
+        return (T*)data;
+    }
+    void deallocate(T* data, size_t) {freePages(data);}
+    const PagePolicy& policy() const {return m_policy;}
+    template <class U>
+    bool operator==(const PageAllocator<U>&) const {return true;}
+    template <class U>
+    bool operator!=(const PageAllocator<U>&) const {return false;}
+
+    private:
+    PagePolicy m_policy;
+};
+#endif
@@ -0,0 +1,64 @@
+// CMSC 341 - Spring 2024 - Project 4
+#include "prefixindex.h"
+#include "vacdb.h"
+
+/**
+ * Name: ByName
+ * Desc: Orders patients by name, then serial, then address so that patients sharing a
+ *       name and serial can coexist. A string compares equal to every entry with that name,
+ *       which keeps the mixed comparisons a strict weak ordering.
+ */
+bool PrefixIndex::ByName::operator()(const Patient* lhs, const Patient* rhs) const {
+    int cmp = lhs->m_name.compare(rhs->m_name);
+    if (cmp != 0) return cmp < 0;
+    if (lhs->m_serial != rhs->m_serial) return lhs->m_serial < rhs->m_serial;
+    return lhs < rhs;
+}
+
+bool PrefixIndex::ByName::operator()(const Patient* lhs, const string& rhs) const {
+    return lhs->m_name < rhs;
+}
+
+bool PrefixIndex::ByName::operator()(const string& lhs, const Patient* rhs) const {
+    return lhs < rhs->m_name;
+}
+
+
+/**
+ * Name: add
+ * Desc: Adds a stored patient to the index in O(log n).
+ * Preconditions: patient points to an entry of the hash table.
+ * Postconditions: The patient is returned by searches for any prefix of its name.
+ */
+void PrefixIndex::add(const Patient* patient) {
+    m_entries.insert(patient);
+}
+
+
+/**
+ * Name: remove
+ * Desc: Removes a patient from the index in O(log n).
+ * Preconditions: The name and serial of the patient have not changed since it was added.
+ * Postconditions: The patient is no longer returned by searches.
+ */
+void PrefixIndex::remove(const Patient* patient) {
+    m_entries.erase(patient);
+}
+
+
+/**
+ * Name: search
+ * Desc: Finds the first entry not smaller than the prefix and walks forward while the
+ *       names still start with it, so the cost is O(log n + k).
+ * Preconditions: k is non-negative.
+ * Postconditions: Returns up to k patients in name order. An empty prefix matches every name.
+ */
+vector<const Patient*> PrefixIndex::search(const string& prefix, int k) const {
+    vector<const Patient*> result;
+    for (auto it = m_entries.lower_bound(prefix); it != m_entries.end() && (int)result.size() < k; ++it) {
+        if ((*it)->m_name.compare(0, prefix.size(), prefix) != 0)
+            break;
+        result.push_back(*it);
+    }
+    return result;
+}
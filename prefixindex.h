@@ -0,0 +1,30 @@
+// CMSC 341 - Spring 2024 - Project 4
+#ifndef PREFIXINDEX_H
+#define PREFIXINDEX_H
+#include <set>
+#include <string>
+#include <vector>
+using namespace std;
+class Patient;
+
+// Orders patients by name, then serial. The index stores the pointers
+// held by the hash table, so the table must remove an entry from the
+// index before it changes the name or serial or frees the entry.
+class PrefixIndex{
+    public:
+    void add(const Patient* patient);
+    void remove(const Patient* patient);
+    // Returns up to k patients whose name starts with prefix, in name order
+    vector<const Patient*> search(const string& prefix, int k) const;
+    int size() const {return (int)m_entries.size();}
+
+    private:
+    struct ByName{
+        using is_transparent = void;
+        bool operator()(const Patient* lhs, const Patient* rhs) const;
+        bool operator()(const Patient* lhs, const string& rhs) const;
+        bool operator()(const string& lhs, const Patient* rhs) const;
+    };
+    set<const Patient*, ByName> m_entries;
+};
+#endif
@@ -0,0 +1,60 @@
+// CMSC 341 - Spring 2024 - Project 4
+#include "protocol.h"
+#include <cstring>
+
+/**
+ * Name: encodeRequest
+ * Desc: Appends a RequestHeader and the name to a send buffer.
+ * Preconditions: None.
+ * Postconditions: Returns false, leaving out unchanged, if the name is longer than 65535 bytes.
+ */
+bool encodeRequest(string& out, op_t op, const string& name, int serial, int newSerial) {
+    if (name.size() > UINT16_MAX)
+        return false;
+    RequestHeader header = {(uint8_t)op, 0, (uint16_t)name.size(), serial, newSerial};
+    out.append((const char*)&header, sizeof(header));
+    out.append(name);
+    return true;
+}
+
+
+void encodeResponse(string& out, status_t status, const string& name, int serial) {
+    ResponseHeader header = {(uint8_t)status, 0, (uint16_t)name.size(), serial};
+    out.append((const char*)&header, sizeof(header));
+    out.append(name);
+}
+
+
+/**
+ * Name: decodeRequest
+ * Desc: Reads one request frame. The op is copied as sent, the server rejects unknown ones.
+ * Preconditions: None.
+ * Postconditions: Returns the frame size, or 0 if the frame is not complete.
+ */
+size_t decodeRequest(const char* data, size_t size, Request& request) {
+    RequestHeader header;
+    if (size < sizeof(header))
+        return 0;
+    memcpy(&header, data, sizeof(header));
+    if (size < sizeof(header) + header.nameLength)
+        return 0;
+    request.op = (op_t)header.op;
+    request.name.assign(data + sizeof(header), header.nameLength);
+    request.serial = header.serial;
+    request.newSerial = header.newSerial;
+    return sizeof(header) + header.nameLength;
+}
+
+
+size_t decodeResponse(const char* data, size_t size, Response& response) {
+    ResponseHeader header;
+    if (size < sizeof(header))
+        return 0;
+    memcpy(&header, data, sizeof(header));
+    if (size < sizeof(header) + header.nameLength)
+        return 0;
+    response.status = (status_t)header.status;
+    response.name.assign(data + sizeof(header), header.nameLength);
+    response.serial = header.serial;
+    return sizeof(header) + header.nameLength;
+}
@@ -0,0 +1,57 @@
+// CMSC 341 - Spring 2024 - Project 4
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+#include <cstddef>
+#include <cstdint>
+#include <string>
+using namespace std;
+// Wire format between the request server and its clients. Fields are in
+// host byte order, the server only listens on local sockets. Requests and
+// responses are pipelined: a client may send many requests before reading,
+// and the responses of a connection come back in request order. OPREMOVE,
+// OPGET and OPUPDATE act on the patient with that name and serial, serial 0
+// matches any patient of the name; an OPGET hit returns the serial found.
+// Both codes have a fixed byte type, so any byte off the wire is a valid value to reject
+enum op_t : uint8_t {OPINSERT = 1, OPREMOVE = 2, OPGET = 3, OPUPDATE = 4};
+enum status_t : uint8_t {STATUSOK = 0, STATUSFAIL = 1, STATUSBAD = 2};
+const char* const SERVERSOCKET = "/tmp/vacdb.sock";   // default Unix socket
+
+// A request is this header followed by nameLength bytes of name
+struct RequestHeader{
+    uint8_t op;
+    uint8_t reserved;
+    uint16_t nameLength;
+    int32_t serial;
+    int32_t newSerial;      // OPUPDATE only
+};
+
+// A response is this header followed by nameLength bytes of name, only
+// OPGET hits carry a name
+struct ResponseHeader{
+    uint8_t status;
+    uint8_t reserved;
+    uint16_t nameLength;
+    int32_t serial;
+};
+
+struct Request{
+    op_t op;
+    string name;
+    int serial;
+    int newSerial;
+};
+
+struct Response{
+    status_t status;
+    string name;
+    int serial;
+};
+
+// appends a request to a send buffer, Returns false if the name is too long
+bool encodeRequest(string& out, op_t op, const string& name, int serial, int newSerial = 0);
+void encodeResponse(string& out, status_t status, const string& name = "", int serial = 0);
+// Decodes the frame at the start of data. Returns the bytes it takes, or 0
+// if data does not hold a whole frame yet
+size_t decodeRequest(const char* data, size_t size, Request& request);
+size_t decodeResponse(const char* data, size_t size, Response& response);
+#endif
@@ -0,0 +1,280 @@
+// CMSC 341 - Spring 2024 - Project 4
+#include "requestserver.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static bool setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags != -1 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1;
+}
+
+
+RequestServer::RequestServer(VacDB& db)
+    : m_db(db), m_epoll(epoll_create1(0)), m_listen(-1), m_running(0),
+      m_requests(0), m_batches(0) {}
+
+
+RequestServer::~RequestServer() {
+    while (!m_connections.empty())
+        close(m_connections.begin()->second);
+    if (m_listen != -1)
+        ::close(m_listen);
+    if (!m_unixPath.empty())
+        unlink(m_unixPath.c_str());
+    ::close(m_epoll);
+}
+
+
+// makes fd the listening socket and registers it with epoll
+bool RequestServer::startListening(int fd) {
+    if (listen(fd, SOMAXCONN) == -1 || !setNonBlocking(fd)) {
+        ::close(fd);
+        return false;
+    }
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &event);
+    m_listen = fd;
+    return true;
+}
+
+
+/**
+ * Name: listenUnix
+ * Desc: Binds a Unix domain stream socket at path. A file left at path by an earlier run is
+ *       removed first.
+ * Preconditions: The server is not listening yet.
+ * Postconditions: Returns false if the socket cannot be bound.
+ */
+bool RequestServer::listenUnix(const string& path) {
+    sockaddr_un address = {};
+    if (path.size() >= sizeof(address.sun_path))
+        return false;
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path.c_str());
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path.c_str());
+    if (fd == -1 || bind(fd, (sockaddr*)&address, sizeof(address)) == -1) {
+        if (fd != -1) ::close(fd);
+        return false;
+    }
+    m_unixPath = path;
+    return startListening(fd);
+}
+
+
+/**
+ * Name: listenTcp
+ * Desc: Binds a TCP socket on the loopback address.
+ * Preconditions: The server is not listening yet.
+ * Postconditions: Returns false if the port cannot be bound.
+ */
+bool RequestServer::listenTcp(int port) {
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int on = 1;
+    if (fd == -1 || setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) == -1
+        || bind(fd, (sockaddr*)&address, sizeof(address)) == -1) {
+        if (fd != -1) ::close(fd);
+        return false;
+    }
+    return startListening(fd);
+}
+
+
+bool RequestServer::addConnection(int fd) {
+    if (!setNonBlocking(fd))
+        return false;
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));  // fails harmlessly on Unix sockets
+    Connection* connection = new Connection{fd, "", "", false};
+    epoll_event event = {};
+    event.events = EPOLLIN | EPOLLRDHUP;
+    event.data.fd = fd;
+    if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &event) == -1) {
+        delete connection;
+        return false;
+    }
+    m_connections[fd] = connection;
+    return true;
+}
+
+
+void RequestServer::acceptAll() {
+    int fd;
+    while ((fd = accept(m_listen, nullptr, nullptr)) != -1) {
+        if (!addConnection(fd))
+            ::close(fd);
+    }
+}
+
+
+// Returns the table operation of a request op, 0 for an unknown op
+static trace_t traceOp(op_t op) {
+    switch (op) {
+        case OPINSERT: return TRACEINSERT;
+        case OPREMOVE: return TRACEREMOVE;
+        case OPGET: return TRACEGET;
+        case OPUPDATE: return TRACEUPDATE;
+        default: return (trace_t)0;
+    }
+}
+
+
+/**
+ * Name: readAll
+ * Desc: Reads until the socket would block, then decodes every complete request into the batch.
+ *       An unknown op still joins the batch, so its STATUSBAD answer follows those of the
+ *       requests before it, and marks the connection closed since the stream can no longer
+ *       be framed; whatever follows it is dropped.
+ * Preconditions: connection is open.
+ * Postconditions: Partial frames stay in connection->in for the next round.
+ */
+void RequestServer::readAll(Connection* connection) {
+    char chunk[READCHUNK];
+    while (true) {
+        ssize_t n = read(connection->fd, chunk, sizeof(chunk));
+        if (n > 0) {
+            connection->in.append(chunk, n);
+            continue;
+        }
+        if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+            connection->closed = true;
+        if (n == 0 || errno != EINTR)
+            break;
+    }
+    size_t pos = 0;
+    Request request;
+    while (size_t used = decodeRequest(connection->in.data() + pos, connection->in.size() - pos, request)) {
+        pos += used;
+        m_batch.push_back({traceOp(request.op), false, request.name, request.serial, request.newSerial});
+        m_senders.push_back(connection);
+        if (m_batch.back().op == 0) {
+            connection->closed = true;
+            connection->in.clear();
+            return;
+        }
+    }
+    connection->in.erase(0, pos);
+}
+
+
+// queues the response to a request of the batch that has run
+void RequestServer::answer(size_t request) {
+    const TraceEntry& op = m_batch[request];
+    string& out = m_senders[request]->out;
+    if (op.op == 0)
+        encodeResponse(out, STATUSBAD);
+    else if (op.op == TRACEGET && op.outcome)
+        encodeResponse(out, STATUSOK, op.name, op.serial);
+    else
+        encodeResponse(out, op.outcome ? STATUSOK : STATUSFAIL);
+}
+
+
+/**
+ * Name: flush
+ * Desc: Writes the queued responses until the socket would block. Leftovers make epoll report
+ *       the socket writable, the watch is dropped again once the buffer is empty. The socket is
+ *       watched for input only while it is open and its leftovers are under OUTHIGHWATER: a
+ *       closed peer would report its hang-up in every round, and a client that does not read
+ *       its answers is not read either.
+ * Preconditions: None.
+ * Postconditions: Returns false if the write failed.
+ */
+bool RequestServer::flush(Connection* connection) {
+    size_t pos = 0;
+    while (pos < connection->out.size()) {
+        ssize_t n = write(connection->fd, connection->out.data() + pos, connection->out.size() - pos);
+        if (n > 0) {
+            pos += n;
+        } else if (n == -1 && errno == EINTR) {
+            continue;
+        } else if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else {
+            return false;
+        }
+    }
+    bool waiting = pos < connection->out.size();
+    connection->out.erase(0, pos);
+    bool reading = !connection->closed && connection->out.size() < OUTHIGHWATER;
+    epoll_event event = {};
+    event.events = (reading ? (uint32_t)(EPOLLIN | EPOLLRDHUP) : 0u) | (waiting ? (uint32_t)EPOLLOUT : 0u);
+    event.data.fd = connection->fd;
+    epoll_ctl(m_epoll, EPOLL_CTL_MOD, connection->fd, &event);
+    return true;
+}
+
+
+void RequestServer::close(Connection* connection) {
+    epoll_ctl(m_epoll, EPOLL_CTL_DEL, connection->fd, nullptr);
+    ::close(connection->fd);
+    m_connections.erase(connection->fd);
+    delete connection;
+}
+
+
+/**
+ * Name: poll
+ * Desc: One round of the event loop: accepts new clients, reads every ready connection into one
+ *       batch, runs the batch through runBatch in arrival order and writes each connection's
+ *       responses with one call. Connections that hung up are closed after their answers are
+ *       sent. A connection over OUTHIGHWATER is only written to.
+ * Preconditions: None.
+ * Postconditions: Returns the number of requests served in the round.
+ */
+int RequestServer::poll(int timeoutMs) {
+    epoll_event events[MAXEVENTS];
+    int ready = epoll_wait(m_epoll, events, MAXEVENTS, timeoutMs);
+    vector<Connection*> touched;
+    for (int i = 0; i < ready; i++) {
+        int fd = events[i].data.fd;
+        if (fd == m_listen) {
+            acceptAll();
+            continue;
+        }
+        auto it = m_connections.find(fd);
+        if (it == m_connections.end()) continue;
+        Connection* connection = it->second;
+        bool readable = events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR);
+        if (readable && !connection->closed && connection->out.size() < OUTHIGHWATER)
+            readAll(connection);
+        touched.push_back(connection);
+    }
+
+    int served = (int)m_batch.size();
+    m_db.runBatch(m_batch);
+    for (size_t request = 0; request < m_batch.size(); request++)
+        answer(request);
+    m_batch.clear();
+    m_senders.clear();
+    if (served > 0) {
+        m_requests += served;
+        m_batches++;
+    }
+
+    for (Connection* connection : touched) {
+        if (!flush(connection) || (connection->closed && connection->out.empty()))
+            close(connection);
+    }
+    return served;
+}
+
+
+void RequestServer::run() {
+    m_running = 1;
+    while (m_running)
+        poll(100);
+}
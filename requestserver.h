@@ -0,0 +1,66 @@
+// CMSC 341 - Spring 2024 - Project 4
+#ifndef REQUESTSERVER_H
+#define REQUESTSERVER_H
+#include "vacdb.h"
+#include "protocol.h"
+#include <csignal>
+#include <unordered_map>
+const int MAXEVENTS = 256;          // sockets handled per epoll_wait
+const size_t READCHUNK = 64 * 1024; // bytes read per read() call
+const size_t OUTHIGHWATER = 1 << 20;    // unsent response bytes that stop reading a connection
+
+// Single-threaded epoll server in front of one VacDB. Every round of the
+// event loop reads whatever the ready connections sent, decodes all the
+// complete requests into one batch, runs the batch through VacDB::runBatch
+// in arrival order and answers every connection with one write. Pipelined
+// clients therefore cost a read and a write per round, not per request, and
+// the table fetches the buckets of the requests ahead while it serves one.
+// A client that sends faster than it reads is not read while its unsent
+// responses are above OUTHIGHWATER.
+class RequestServer{
+    public:
+    friend class Tester;
+    RequestServer(VacDB& db);
+    ~RequestServer();
+    // listens on a Unix domain socket, replacing a stale socket file
+    bool listenUnix(const string& path);
+    // listens on 127.0.0.1
+    bool listenTcp(int port);
+    // serves an already connected socket, the server closes it
+    bool addConnection(int fd);
+    // runs one round of the event loop, Returns the number of requests served
+    int poll(int timeoutMs);
+    // runs rounds until stop() is called
+    void run();
+    // safe to call from a signal handler
+    void stop() {m_running = 0;}
+    long long requests() const {return m_requests;}
+    long long batches() const {return m_batches;}
+    int connections() const {return (int)m_connections.size();}
+
+    private:
+    struct Connection{
+        int fd;
+        string in;          // received bytes not decoded yet
+        string out;         // encoded responses not written yet
+        bool closed;        // the peer hung up or sent garbage
+    };
+    VacDB& m_db;
+    int m_epoll;
+    int m_listen;
+    string m_unixPath;
+    unordered_map<int, Connection*> m_connections;
+    vector<TraceEntry> m_batch;         // the requests of a round, op 0 for an unknown op
+    vector<Connection*> m_senders;      // the connection of each request of the batch
+    volatile sig_atomic_t m_running;
+    long long m_requests;
+    long long m_batches;
+
+    bool startListening(int fd);
+    void acceptAll();
+    void readAll(Connection* connection);
+    void answer(size_t request);
+    bool flush(Connection* connection);
+    void close(Connection* connection);
+};
+#endif
@@ -0,0 +1,70 @@
+// CMSC 341 - Spring 2024 - Project 4
+#include "serialallocator.h"
+
+/**
+ * Name: SerialAllocator Constructor
+ * Desc: Creates an allocator for the serials low to high, all free. NOSERIAL is taken out of
+ *       the bitmap when the range spans it, so allocate never hands it out.
+ * Preconditions: low <= high and the range holds fewer than 2^31 serials.
+ * Postconditions: No serial is in use.
+ */
+SerialAllocator::SerialAllocator(int low, int high)
+    : m_low(low), m_high(high), m_free(high - low + 1, true), m_cursor(0), m_used(0) {
+    if (low <= NOSERIAL && NOSERIAL <= high)
+        m_free.clear(NOSERIAL - low);
+}
+
+
+/**
+ * Name: allocate
+ * Desc: Takes the first free serial at or after the cursor, wrapping around to the start of the
+ *       range once. Each lookup reads one word per bitmap level.
+ * Preconditions: None.
+ * Postconditions: Returns the serial, now in use, or NOSERIAL if the range is exhausted.
+ */
+int SerialAllocator::allocate() {
+    int bit = m_free.findNext(m_cursor);
+    if (bit == -1)
+        bit = m_free.findNext(0);
+    if (bit == -1)
+        return NOSERIAL;
+    m_free.clear(bit);
+    m_cursor = bit + 1;
+    m_used++;
+    return m_low + bit;
+}
+
+
+/**
+ * Name: reserve
+ * Desc: Marks a serial chosen by the caller in use.
+ * Preconditions: None.
+ * Postconditions: Returns false, changing nothing, if the serial is out of range or in use.
+ */
+bool SerialAllocator::reserve(int serial) {
+    if (!contains(serial) || !m_free.test(serial - m_low))
+        return false;
+    m_free.clear(serial - m_low);
+    m_used++;
+    return true;
+}
+
+
+/**
+ * Name: release
+ * Desc: Returns a serial to the free set.
+ * Preconditions: None.
+ * Postconditions: Returns false, changing nothing, if the serial is out of range or free.
+ */
+bool SerialAllocator::release(int serial) {
+    if (!contains(serial) || m_free.test(serial - m_low))
+        return false;
+    m_free.set(serial - m_low);
+    m_used--;
+    return true;
+}
+
+
+bool SerialAllocator::inUse(int serial) const {
+    return contains(serial) && !m_free.test(serial - m_low);
+}
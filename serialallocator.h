@@ -0,0 +1,35 @@
+// CMSC 341 - Spring 2024 - Project 4
+#ifndef SERIALALLOCATOR_H
+#define SERIALALLOCATOR_H
+#include "slotbook.h"
+const int NOSERIAL = 0;     // returned when no serial is left, never a serial of a range
+
+// Tracks which serial numbers of [low, high] are in use with a SlotBitmap of
+// the free ones, so checking, taking and releasing a serial never scans the
+// table. allocate() hands out serials round robin from a cursor, which keeps
+// a released serial out of circulation for as long as possible. A range
+// that spans 0 leaves it out: 0 is NOSERIAL and the "any serial" of lookups.
+class SerialAllocator{
+    public:
+    friend class Tester;
+    SerialAllocator(int low, int high);
+    // Returns the next free serial and marks it in use, NOSERIAL if none is left
+    int allocate();
+    // marks a serial in use, Returns false if it is out of range or already in use
+    bool reserve(int serial);
+    // Returns false if the serial is out of range or not in use
+    bool release(int serial);
+    bool inUse(int serial) const;
+    bool contains(int serial) const {return serial != NOSERIAL && serial >= m_low && serial <= m_high;}
+    int low() const {return m_low;}
+    int high() const {return m_high;}
+    int used() const {return m_used;}
+
+    private:
+    int m_low;
+    int m_high;
+    SlotBitmap m_free;      // bit serial - m_low is set while the serial is free
+    int m_cursor;           // where the next allocate() starts looking
+    int m_used;
+};
+#endif
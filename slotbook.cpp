@@ -0,0 +1,246 @@
+// CMSC 341 - Spring 2024 - Project 4
+#include "slotbook.h"
+#include <algorithm>
+
+/**
+ * Name: SlotBitmap Constructor
+ * Desc: Creates a bitmap of size bits. Levels are added until a level fits in one word.
+ *       A full bitmap is built word by word, not with a set per bit. The words are allocated under pages.
+ * Preconditions: size is non-negative.
+ * Postconditions: The bitmap holds size bits, all set if full is true and all clear otherwise.
+ */
+SlotBitmap::SlotBitmap(int size, bool full, const PagePolicy& pages) : m_size(size) {
+    long long bits = size;
+    int words = (size + 63) / 64;
+    do {
+        m_levels.push_back(vector<uint64_t, PageAllocator<uint64_t>>(words > 0 ? words : 1, 0, pages));
+        if (full && bits > 0) {
+            auto& level = m_levels.back();
+            fill(level.begin(), level.end(), ~0ULL);
+            if (bits % 64 != 0)
+                level[words - 1] = (1ULL << (bits % 64)) - 1;
+        }
+        bits = words;   // one summary bit per word of this level
+        words = (words + 63) / 64;
+    } while (m_levels.back().size() > 1);
+}
+
+
+/**
+ * Name: set
+ * Desc: Sets a bit and marks its word in the levels above. Stops climbing at the first
+ *       word that was already non-empty, since its summary bit is already set.
+ * Preconditions: index is in the range [0, size).
+ * Postconditions: The bit is set.
+ */
+void SlotBitmap::set(int index) {
+    for (size_t level = 0; level < m_levels.size(); level++) {
+        uint64_t& word = m_levels[level][index >> 6];
+        bool wasEmpty = (word == 0);
+        word |= 1ULL << (index & 63);
+        if (!wasEmpty) break;
+        index >>= 6;
+    }
+}
+
+
+/**
+ * Name: clear
+ * Desc: Clears a bit and clears the summary bits of the words that became empty.
+ * Preconditions: index is in the range [0, size).
+ * Postconditions: The bit is clear.
+ */
+void SlotBitmap::clear(int index) {
+    for (size_t level = 0; level < m_levels.size(); level++) {
+        uint64_t& word = m_levels[level][index >> 6];
+        word &= ~(1ULL << (index & 63));
+        if (word != 0) break;
+        index >>= 6;
+    }
+}
+
+
+bool SlotBitmap::test(int index) const {
+    return (m_levels[0][index >> 6] >> (index & 63)) & 1;
+}
+
+
+/**
+ * Name: findNext
+ * Desc: Finds the first set bit at or after from. It climbs until a level has a set bit to the
+ *       right of the search position, then descends along the lowest set bits, touching one word per level.
+ * Preconditions: None.
+ * Postconditions: Returns the index of the bit, or -1 if no bit at or after from is set.
+ */
+int SlotBitmap::findNext(int from) const {
+    if (from < 0) from = 0;
+    if (from >= m_size) return -1;
+
+    size_t level = 0;
+    long long index = from;
+    while (true) {
+        if (level == m_levels.size()) return -1;
+        long long word = index >> 6;
+        if (word < (long long)m_levels[level].size()) {
+            uint64_t bits = m_levels[level][word] & (~0ULL << (index & 63));
+            if (bits != 0) {
+                index = (word << 6) + __builtin_ctzll(bits);
+                break;
+            }
+        }
+        // nothing left in this word, continue with the next word one level up
+        index = word + 1;
+        level++;
+    }
+    while (level > 0) {
+        level--;
+        index = (index << 6) + __builtin_ctzll(m_levels[level][index]);
+    }
+    return (int)index;
+}
+
+
+/**
+ * Name: SlotBook Constructor
+ * Desc: Creates the slot grid with the same capacity for every slot. Slot ids are station major:
+ *       (station * days + day) * slotsPerDay + time. The booking counts and the free bitmaps,
+ *       the arrays that grow with the slot count, are allocated under pages.
+ * Preconditions: All dimensions are positive and capacity is in the range [0, 65535].
+ * Postconditions: Every slot with a positive capacity is marked free.
+ */
+SlotBook::SlotBook(int days, int stations, int slotsPerDay, int capacity, const PagePolicy& pages)
+    : m_days(days), m_stations(stations), m_slotsPerDay(slotsPerDay),
+      m_capacity(days * stations, capacity), m_booked(days * stations * slotsPerDay, 0, PageAllocator<uint16_t>(pages)) {
+    for (int station = 0; station < m_stations; station++) {
+        m_free.push_back(SlotBitmap(m_days * m_slotsPerDay, capacity > 0, pages));
+    }
+}
+
+
+/**
+ * Name: setCapacity
+ * Desc: Changes the capacity of every slot of a station on a day. Slots that already hold more
+ *       bookings than the new capacity keep them, but take no new ones.
+ * Preconditions: None.
+ * Postconditions: Returns false if the day, station or capacity is out of range.
+ */
+bool SlotBook::setCapacity(int day, int station, int capacity) {
+    if (day < 0 || day >= m_days || station < 0 || station >= m_stations || capacity < 0 || capacity > 65535)
+        return false;
+    m_capacity[station * m_days + day] = capacity;
+    for (int time = 0; time < m_slotsPerDay; time++) {
+        int slot = slotId(day, station, time);
+        if (m_booked[slot] < capacity)
+            m_free[station].set(slot % (m_days * m_slotsPerDay));
+        else
+            m_free[station].clear(slot % (m_days * m_slotsPerDay));
+    }
+    return true;
+}
+
+
+/**
+ * Name: slotId
+ * Desc: Converts (day, station, time) into a slot id.
+ * Preconditions: None.
+ * Postconditions: Returns the slot id, or NOSLOT if a coordinate is out of range.
+ */
+int SlotBook::slotId(int day, int station, int time) const {
+    if (day < 0 || day >= m_days || station < 0 || station >= m_stations || time < 0 || time >= m_slotsPerDay)
+        return NOSLOT;
+    return (station * m_days + day) * m_slotsPerDay + time;
+}
+
+
+/**
+ * Name: findNextFree
+ * Desc: Finds the first slot with room at a station at or after (day, time).
+ * Preconditions: None.
+ * Postconditions: Returns the slot id, or NOSLOT if the station is booked out until the last day.
+ */
+int SlotBook::findNextFree(int day, int station, int time) const {
+    int from = slotId(day, station, time);
+    if (from == NOSLOT)
+        return NOSLOT;
+    int next = m_free[station].findNext(day * m_slotsPerDay + time);
+    return (next == -1) ? NOSLOT : station * m_days * m_slotsPerDay + next;
+}
+
+
+/**
+ * Name: book
+ * Desc: Books the first slot with room at a station at or after (day, time).
+ * Preconditions: None.
+ * Postconditions: Returns the booked slot id, or NOSLOT if there is no room.
+ */
+int SlotBook::book(int day, int station, int time) {
+    int slot = findNextFree(day, station, time);
+    if (slot != NOSLOT)
+        bookSlot(slot);
+    return slot;
+}
+
+
+/**
+ * Name: bookAny
+ * Desc: Books the earliest slot with room at or after (day, time) over all stations,
+ *       the lowest station wins a tie.
+ * Preconditions: None.
+ * Postconditions: Returns the booked slot id, or NOSLOT if there is no room.
+ */
+int SlotBook::bookAny(int day, int time) {
+    int best = NOSLOT;
+    int bestPos = 0;
+    for (int station = 0; station < m_stations; station++) {
+        int slot = findNextFree(day, station, time);
+        if (slot == NOSLOT) continue;
+        int pos = slot % (m_days * m_slotsPerDay);
+        if (best == NOSLOT || pos < bestPos) {
+            best = slot;
+            bestPos = pos;
+        }
+    }
+    if (best != NOSLOT)
+        bookSlot(best);
+    return best;
+}
+
+
+/**
+ * Name: bookSlot
+ * Desc: Takes one place in a slot and marks the slot full when it reaches its capacity.
+ * Preconditions: None.
+ * Postconditions: Returns false if the slot is invalid or full.
+ */
+bool SlotBook::bookSlot(int slot) {
+    if (slot < 0 || slot >= (int)m_booked.size() || m_booked[slot] >= capacity(slot))
+        return false;
+    if (++m_booked[slot] == capacity(slot))
+        m_free[getStation(slot)].clear(slot % (m_days * m_slotsPerDay));
+    return true;
+}
+
+
+/**
+ * Name: cancel
+ * Desc: Releases one place in a slot and marks the slot free again.
+ * Preconditions: None.
+ * Postconditions: Returns false if the slot is invalid or holds no booking.
+ */
+bool SlotBook::cancel(int slot) {
+    if (slot < 0 || slot >= (int)m_booked.size() || m_booked[slot] == 0)
+        return false;
+    if (--m_booked[slot] < capacity(slot))
+        m_free[getStation(slot)].set(slot % (m_days * m_slotsPerDay));
+    return true;
+}
+
+
+int SlotBook::booked(int slot) const {
+    return m_booked[slot];
+}
+
+
+int SlotBook::capacity(int slot) const {
+    return m_capacity[slot / m_slotsPerDay];
+}
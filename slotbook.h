@@ -0,0 +1,65 @@
+// CMSC 341 - Spring 2024 - Project 4
+#ifndef SLOTBOOK_H
+#define SLOTBOOK_H
+#include <cstdint>
+#include <vector>
+#include "pagealloc.h"
+using namespace std;
+const int NOSLOT = -1;      // slot id of a patient without an appointment
+
+// Hierarchical bitmap: every bit of a level summarizes one 64-bit word
+// of the level below, so finding the next set bit takes one word per level
+class SlotBitmap{
+    public:
+    SlotBitmap(int size = 0, bool full = false, const PagePolicy& pages = DEFPAGES);
+    void set(int index);
+    void clear(int index);
+    bool test(int index) const;
+    // Returns the first set bit at or after from, -1 if there is none
+    int findNext(int from) const;
+
+    private:
+    int m_size;
+    vector<vector<uint64_t, PageAllocator<uint64_t>>> m_levels; // m_levels[0] holds one bit per index
+};
+
+// Slot capacity engine: days x stations x time slots, every slot of a
+// (day, station) pair can take the same number of patients. The booking
+// counts and free bitmaps are allocated under a PagePolicy like the bucket
+// arrays of VacDB
+class SlotBook{
+    public:
+    SlotBook(int days, int stations, int slotsPerDay, int capacity, const PagePolicy& pages = DEFPAGES);
+    // sets the capacity of every slot of a station on a day
+    bool setCapacity(int day, int station, int capacity);
+    // books the first slot with room at or after (day, time) at a station,
+    // the search continues into the following days
+    // Returns the slot id or NOSLOT
+    int book(int day, int station, int time);
+    // books the first slot with room at or after (day, time) at any station
+    int bookAny(int day, int time);
+    // books a specific slot, returns false if it is full
+    bool bookSlot(int slot);
+    // releases one booking of a slot
+    bool cancel(int slot);
+    // Returns the first slot with room at or after (day, time) at a station
+    int findNextFree(int day, int station, int time) const;
+    int booked(int slot) const;
+    int capacity(int slot) const;
+    // Returns the backing the booking counts got
+    page_t pages() const {return pageBacking(m_booked.data());}
+
+    int slotId(int day, int station, int time) const;
+    int getDay(int slot) const {return (slot / m_slotsPerDay) % m_days;}
+    int getStation(int slot) const {return slot / (m_slotsPerDay * m_days);}
+    int getTime(int slot) const {return slot % m_slotsPerDay;}
+
+    private:
+    int m_days;
+    int m_stations;
+    int m_slotsPerDay;
+    vector<int> m_capacity;         // capacity per (station, day)
+    vector<uint16_t, PageAllocator<uint16_t>> m_booked;    // bookings per slot
+    vector<SlotBitmap> m_free;      // per station, one bit per (day, time) with room
+};
+#endif
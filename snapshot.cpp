@@ -0,0 +1,81 @@
+// CMSC 341 - Spring 2024 - Project 4
+#include "snapshot.h"
+
+
+/**
+ * Name: SnapshotState Constructor
+ * Desc: Records the bucket array of the view and marks every page live. No patient is copied.
+ * Preconditions: table holds slots buckets and outlives the state until preserveAll is called.
+ * Postconditions: Every page reads from table until the writer changes it.
+ */
+SnapshotState::SnapshotState(Patient** table, int slots, int size)
+    : m_table(table), m_slots(slots), m_pages((slots + SNAPPAGE - 1) / SNAPPAGE), m_size(size),
+      m_state(new atomic<int>[m_pages]), m_copy(m_pages), m_released(false), m_copied(0) {
+    for (int page = 0; page < m_pages; page++)
+        m_state[page].store(SNAPLIVE, memory_order_relaxed);
+}
+
+
+// appends the live patients of a page of the bucket array to out
+void SnapshotState::copyLive(int page, vector<Patient>& out) const {
+    const int last = min(m_slots, (page + 1) * SNAPPAGE);
+    for (int slot = page * SNAPPAGE; slot < last; slot++) {
+        const Patient* entry = m_table[slot];
+        if (entry != nullptr && entry->getUsed())
+            out.push_back(*entry);
+    }
+}
+
+
+/**
+ * Name: capture
+ * Desc: Copies the live patients of a page for the view before the writer changes it. A reader
+ *       copying the same page in place holds it SNAPBUSY for a moment, the writer yields until
+ *       it is done.
+ * Preconditions: Called on the writing thread only.
+ * Postconditions: The page is SNAPCOPIED and m_copy holds its patients as of the snapshot.
+ */
+void SnapshotState::capture(int page) {
+    int expected = SNAPLIVE;
+    while (!m_state[page].compare_exchange_weak(expected, SNAPBUSY, memory_order_acquire)) {
+        if (expected == SNAPCOPIED)
+            return;
+        expected = SNAPLIVE;
+        this_thread::yield();
+    }
+    copyLive(page, m_copy[page]);
+    m_copied.fetch_add(1, memory_order_relaxed);
+    m_state[page].store(SNAPCOPIED, memory_order_release);
+}
+
+
+void SnapshotState::preserveAll() {
+    for (int page = 0; page < m_pages; page++) {
+        if (m_state[page].load(memory_order_relaxed) != SNAPCOPIED)
+            capture(page);
+    }
+}
+
+
+/**
+ * Name: readPage
+ * Desc: A copied page is returned as it is. A live page is locked SNAPBUSY while its patients are
+ *       copied into buffer, so the writer cannot change it halfway, and handed back SNAPLIVE at
+ *       once; the caller then works on buffer without holding the writer up.
+ * Preconditions: page is below pages().
+ * Postconditions: Returns the patients of the page as of the snapshot, in bucket order.
+ */
+const vector<Patient>& SnapshotState::readPage(int page, vector<Patient>& buffer) {
+    while (true) {
+        int expected = SNAPLIVE;
+        if (m_state[page].compare_exchange_weak(expected, SNAPBUSY, memory_order_acquire)) {
+            buffer.clear();
+            copyLive(page, buffer);
+            m_state[page].store(SNAPLIVE, memory_order_release);
+            return buffer;
+        }
+        if (expected == SNAPCOPIED)
+            return m_copy[page];    // the failed exchange read it with acquire
+        this_thread::yield();   // the writer is copying the page
+    }
+}
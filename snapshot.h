@@ -0,0 +1,127 @@
+// CMSC 341 - Spring 2024 - Project 4
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+#include "vacdb.h"
+#include <atomic>
+#include <memory>
+const int SNAPPAGE = 512;       // slots per copy-on-write page, 4 KB of bucket array
+
+// state of a page of a snapshot
+enum snap_t {SNAPLIVE, SNAPBUSY, SNAPCOPIED};
+
+// Pages of the bucket array as they were when a snapshot was taken, shared
+// by the VacDB and its VacSnapshot handle. A page is SNAPLIVE while the
+// table still holds it unchanged, SNAPBUSY while one side is reading it in
+// place, and SNAPCOPIED once the writer saved a copy of its live patients
+// before changing it. The writer only moves pages from SNAPLIVE to
+// SNAPCOPIED, so a reader never sees a page change under it.
+class SnapshotState{
+    public:
+    SnapshotState(Patient** table, int slots, int size);
+    SnapshotState(const SnapshotState&) = delete;
+    SnapshotState& operator=(const SnapshotState&) = delete;
+    // saves the page of slot before the writer changes the slot or its patient
+    // Returns false once the handle is gone, the writer then drops the state
+    bool preserve(int slot) {
+        if (m_released.load(memory_order_relaxed))
+            return false;
+        int page = slot / SNAPPAGE;
+        if (slot < m_slots && m_state[page].load(memory_order_relaxed) != SNAPCOPIED)
+            capture(page);
+        return true;
+    }
+    // saves every page, before the writer frees or replaces the bucket array
+    void preserveAll();
+    // Returns the live patients of a page, either its copy or a copy made
+    // into buffer while the writer is held off
+    const vector<Patient>& readPage(int page, vector<Patient>& buffer);
+    void release() {m_released.store(true, memory_order_relaxed);}
+    bool released() const {return m_released.load(memory_order_relaxed);}
+    int pages() const {return m_pages;}
+    int size() const {return m_size;}
+    // Returns the number of pages the writer had to copy so far
+    int copied() const {return m_copied.load(memory_order_relaxed);}
+
+    private:
+    Patient** m_table;                  // bucket array of the snapshot, not owned
+    int m_slots;                        // slots of m_table, stash included
+    int m_pages;
+    int m_size;                         // live patients when the snapshot was taken
+    unique_ptr<atomic<int>[]> m_state;  // snap_t of every page
+    vector<vector<Patient>> m_copy;     // live patients of the SNAPCOPIED pages
+    atomic<bool> m_released;
+    atomic<int> m_copied;
+
+    void capture(int page);
+    void copyLive(int page, vector<Patient>& out) const;
+};
+
+// Consistent read-only view of the live patients of a VacDB at the moment
+// VacDB::snapshot was called. Taking it is O(capacity / SNAPPAGE): nothing
+// is copied up front. Afterwards the first insert, remove or update that
+// touches a page of SNAPPAGE buckets copies the live patients of that page,
+// so the writer pays once per page and the scan reads everything else in
+// place. A rehash, a compaction, a new snapshot or destroying the VacDB
+// copies the pages that are left and detaches the view. The view can be
+// walked from other threads while the owning thread keeps writing; at most
+// one snapshot is tracked at a time.
+class VacSnapshot{
+    public:
+    explicit VacSnapshot(shared_ptr<SnapshotState> state) : m_state(state) {}
+    VacSnapshot(VacSnapshot&& rhs) = default;
+    VacSnapshot& operator=(VacSnapshot&& rhs) {
+        if (this != &rhs) {
+            if (m_state != nullptr) m_state->release();
+            m_state = move(rhs.m_state);
+        }
+        return *this;
+    }
+    ~VacSnapshot() {if (m_state != nullptr) m_state->release();}
+    // Returns the number of live patients in the view
+    int size() const {return m_state->size();}
+    // Returns the number of pages the writer copied since the snapshot was taken
+    int pagesCopied() const {return m_state->copied();}
+    // calls f(const Patient&) for every patient of the view, in bucket order
+    template <class Fn> void forEach(Fn f) const;
+    // calls f(const Patient&) for every patient of the view, with the pages
+    // split into contiguous ranges over threads (0 for every core), f must be
+    // safe to call concurrently
+    template <class Fn> void parallelForEach(Fn f, int threads = 0) const;
+
+    private:
+    shared_ptr<SnapshotState> m_state;
+
+    template <class Fn> void visit(int first, int last, Fn& f) const;
+};
+
+template <class Fn>
+void VacSnapshot::visit(int first, int last, Fn& f) const {
+    vector<Patient> buffer;
+    for (int page = first; page < last; page++) {
+        for (const Patient& patient : m_state->readPage(page, buffer))
+            f(patient);
+    }
+}
+
+template <class Fn>
+void VacSnapshot::forEach(Fn f) const {
+    visit(0, m_state->pages(), f);
+}
+
+template <class Fn>
+void VacSnapshot::parallelForEach(Fn f, int threads) const {
+    const int pages = m_state->pages();
+    if (threads <= 0)
+        threads = (int)thread::hardware_concurrency();
+    threads = max(1, min(threads, pages * SNAPPAGE / MINSLOTSPERTHREAD));
+    vector<thread> workers;
+    for (int t = 1; t < threads; t++) {
+        workers.emplace_back([this, &f, t, threads, pages]() {
+            visit((long long)pages * t / threads, (long long)pages * (t + 1) / threads, f);
+        });
+    }
+    visit(0, pages / threads, f);
+    for (thread& worker : workers)
+        worker.join();
+}
+#endif
@@ -0,0 +1,135 @@
+// CMSC 341 - Spring 2024 - Project 4
+#include "timingwheel.h"
+#include <algorithm>
+#include <climits>
+
+TimingWheel::TimingWheel(long long now) : m_dueHead(0), m_waiting(0), m_now(now) {
+    fill(m_occupied, m_occupied + WHEELLEVELS, 0);
+}
+
+
+/**
+ * Name: schedule
+ * Desc: Places a timer for the patient on the wheel.
+ * Preconditions: when is not negative.
+ * Postconditions: popDue returns the timer once the wheel has advanced to when.
+ */
+void TimingWheel::schedule(const string& name, int serial, long long when) {
+    place({name, serial, when});
+}
+
+
+/**
+ * Name: advance
+ * Desc: Moves the current tick forward to now, visiting only the ticks where something happens:
+ *       the next occupied level-0 slot of the current window, and on every higher level the start
+ *       of its next occupied slot. Both come from the occupied bitmaps, one word per level, so
+ *       timers far ahead on the upper levels cost one step per cascade instead of one per 64 ticks.
+ *       Timers past the top level wait in top slot 0 for the next 2^30 boundary. At a boundary
+ *       the slots of the higher levels that start there are cascaded, highest level first, then
+ *       the level-0 slot of the tick is moved to the due list. An empty wheel jumps straight to now.
+ * Preconditions: None.
+ * Postconditions: Every timer with a deadline at or before now is on the due list.
+ */
+void TimingWheel::advance(long long now) {
+    while (m_now < now) {
+        long long next = nextEvent();
+        if (m_waiting == 0 || next > now) {
+            m_now = now;
+            break;
+        }
+        m_now = next;
+        if ((m_now & (WHEELSLOTS - 1)) == 0) {
+            int top = 1;
+            while (top + 1 < WHEELLEVELS && (m_now & ((1LL << (WHEELBITS * (top + 1))) - 1)) == 0)
+                top++;
+            for (int level = top; level >= 1; level--)
+                cascade(level);
+        }
+        cascade(0);
+    }
+}
+
+
+/**
+ * Name: popDue
+ * Desc: Takes the oldest timer of the due list.
+ * Preconditions: None.
+ * Postconditions: Returns true and the timer, or false if nothing is due.
+ */
+bool TimingWheel::popDue(ExpiryTimer& timer) {
+    if (m_dueHead == m_due.size())
+        return false;
+    timer = std::move(m_due[m_dueHead++]);
+    if (m_dueHead == m_due.size()) {
+        m_due.clear();
+        m_dueHead = 0;
+    } else if (m_dueHead >= 4096 && m_dueHead * 2 >= m_due.size()) {
+        // a backlog drained in batches, drop the taken half
+        m_due.erase(m_due.begin(), m_due.begin() + m_dueHead);
+        m_dueHead = 0;
+    }
+    return true;
+}
+
+
+// puts a timer on the level of the highest 6-bit group in which its deadline
+// differs from the current tick, or on the due list if it is not ahead.
+// Deadlines past the top level wait in top slot 0, which is cascaded at the
+// start of every block of 2^30 ticks, and are placed again from there.
+void TimingWheel::place(ExpiryTimer&& timer) {
+    if (timer.when <= m_now) {
+        m_due.push_back(std::move(timer));
+        return;
+    }
+    uint64_t differ = (uint64_t)timer.when ^ (uint64_t)m_now;
+    int level = (63 - __builtin_clzll(differ)) / WHEELBITS;
+    int slot;
+    if (level >= WHEELLEVELS) {
+        level = WHEELLEVELS - 1;
+        slot = 0;
+    } else {
+        slot = (int)((timer.when >> (WHEELBITS * level)) & (WHEELSLOTS - 1));
+    }
+    m_slots[level][slot].push_back(std::move(timer));
+    m_occupied[level] |= 1ULL << slot;
+    m_waiting++;
+}
+
+
+// Returns the first tick after the current one at which a slot has to be
+// cascaded or moved to the due list, LLONG_MAX if there is none. A slot
+// ahead of the current one on a level starts inside the current slot of the
+// level above, and the slot at the current position never holds timers,
+// except top slot 0 with the deadlines past the top level.
+long long TimingWheel::nextEvent() const {
+    long long next = LLONG_MAX;
+    for (int level = 0; level < WHEELLEVELS; level++) {
+        int shift = WHEELBITS * level;
+        int current = (int)((m_now >> shift) & (WHEELSLOTS - 1));
+        uint64_t ahead = (current == WHEELSLOTS - 1) ? 0 : m_occupied[level] & (~0ULL << (current + 1));
+        if (ahead) {
+            long long block = (m_now >> (shift + WHEELBITS)) << (shift + WHEELBITS);
+            next = min(next, block + ((long long)__builtin_ctzll(ahead) << shift));
+        }
+    }
+    if (m_occupied[WHEELLEVELS - 1] & 1) {
+        const int topShift = WHEELBITS * WHEELLEVELS;
+        next = min(next, ((m_now >> topShift) + 1) << topShift);
+    }
+    return next;
+}
+
+
+// places again the timers of the slot of a level that starts at the current tick
+void TimingWheel::cascade(int level) {
+    int slot = (int)((m_now >> (WHEELBITS * level)) & (WHEELSLOTS - 1));
+    if (!(m_occupied[level] & (1ULL << slot)))
+        return;
+    vector<ExpiryTimer> moving;
+    moving.swap(m_slots[level][slot]);
+    m_occupied[level] &= ~(1ULL << slot);
+    m_waiting -= moving.size();
+    for (ExpiryTimer& timer : moving)
+        place(std::move(timer));
+}
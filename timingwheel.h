@@ -0,0 +1,54 @@
+// CMSC 341 - Spring 2024 - Project 4
+#ifndef TIMINGWHEEL_H
+#define TIMINGWHEEL_H
+#include <cstdint>
+#include <string>
+#include <vector>
+using namespace std;
+const int WHEELBITS = 6;                    // a level has 64 slots
+const int WHEELSLOTS = 1 << WHEELBITS;
+const int WHEELLEVELS = 5;                  // 2^30 ticks ahead before deadlines are clamped
+const long long NOEXPIRY = 0;               // deadline of a patient that never expires
+
+// A patient to expire at a tick
+struct ExpiryTimer{
+    string name;
+    int serial;
+    long long when;
+};
+
+// Hierarchical timing wheel (Varghese and Lauck). Level l has 64 slots of
+// 64^l ticks each; a timer sits on the level of the highest 6-bit group in
+// which its deadline differs from the current tick. When the current tick
+// crosses a slot boundary of a level, that slot is cascaded down, so every
+// timer is handled at most once per level. Advancing jumps over empty
+// slots of every level with a bitmap per level. Timers are never cancelled: the owner checks a due
+// timer against the patient's current deadline and drops stale ones.
+// Ticks are whatever unit the caller uses, from 0 upwards.
+class TimingWheel{
+    public:
+    TimingWheel(long long now = 0);
+    // a deadline at or before the current tick is due at once
+    void schedule(const string& name, int serial, long long when);
+    // moves the timers due by now to the due list
+    void advance(long long now);
+    // takes the next due timer, in the order they fell due; returns false if none is
+    bool popDue(ExpiryTimer& timer);
+    long long now() const {return m_now;}
+    // timers scheduled and not taken yet, stale ones included
+    size_t size() const {return m_waiting + m_due.size() - m_dueHead;}
+    size_t due() const {return m_due.size() - m_dueHead;}
+
+    private:
+    vector<ExpiryTimer> m_slots[WHEELLEVELS][WHEELSLOTS];
+    uint64_t m_occupied[WHEELLEVELS];   // bit s is set when slot s of the level holds timers
+    vector<ExpiryTimer> m_due;          // due timers, taken from m_dueHead on
+    size_t m_dueHead;
+    size_t m_waiting;                   // timers on the wheel
+    long long m_now;
+
+    void place(ExpiryTimer&& timer);
+    void cascade(int level);
+    long long nextEvent() const;
+};
+#endif
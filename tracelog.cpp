@@ -0,0 +1,99 @@
+// CMSC 341 - Spring 2024 - Project 4
+#include "tracelog.h"
+#include "vacdb.h"
+#include <cstring>
+#include <unistd.h>
+
+TraceLog::TraceLog(int fd) : m_writer(fd) {
+    ExportHeader header = {TRACEMAGIC, TRACEVERSION};
+    m_writer.write((const char*)&header, sizeof(header));
+}
+
+
+/**
+ * Name: record
+ * Desc: Appends one record to the buffer of the writer, a system call happens only when
+ *       the buffer fills.
+ * Preconditions: None.
+ * Postconditions: The record is written at the latest by the next flush.
+ */
+void TraceLog::record(trace_t op, const string& name, int serial, long long arg, bool outcome) {
+    uint16_t length = (uint16_t)min<size_t>(name.size(), UINT16_MAX);
+    TraceRecord record = {(uint8_t)op, (uint8_t)outcome, length, serial, arg};
+    m_writer.write((const char*)&record, sizeof(record));
+    m_writer.write(name.data(), length);
+}
+
+
+/**
+ * Name: readTrace
+ * Desc: Reads the file from its current position to the end and decodes every record.
+ * Preconditions: fd is open for reading.
+ * Postconditions: Returns false if the file is not a trace or ends inside a record. The records
+ *                 before the cut are still appended to entries.
+ */
+bool readTrace(int fd, vector<TraceEntry>& entries) {
+    string data;
+    char chunk[1 << 16];
+    ssize_t n;
+    while ((n = read(fd, chunk, sizeof(chunk))) > 0)
+        data.append(chunk, n);
+    ExportHeader header;
+    if (n < 0 || data.size() < sizeof(header))
+        return false;
+    memcpy(&header, data.data(), sizeof(header));
+    if (header.magic != TRACEMAGIC || header.version != TRACEVERSION)
+        return false;
+
+    size_t pos = sizeof(header);
+    while (pos + sizeof(TraceRecord) <= data.size()) {
+        TraceRecord record;
+        memcpy(&record, data.data() + pos, sizeof(record));
+        pos += sizeof(record);
+        if (pos + record.nameLength > data.size())
+            return false;
+        entries.push_back({(trace_t)record.op, record.outcome != 0,
+                           data.substr(pos, record.nameLength), record.serial, record.arg});
+        pos += record.nameLength;
+    }
+    return pos == data.size();
+}
+
+
+/**
+ * Name: applyTraceEntry
+ * Desc: Runs the operation of a record. SEED records are inserted like INSERT, OPEN and
+ *       REHASH records describe the recorded table and do nothing. WHEEL records turn expiry
+ *       on or off at the recorded tick. Removes and updates act on the exact (name, serial)
+ *       that was recorded, so repeated names change the same patient as in the recording.
+ * Preconditions: None.
+ * Postconditions: Returns the outcome, to be compared with entry.outcome.
+ */
+bool applyTraceEntry(VacDB& db, const TraceEntry& entry) {
+    switch (entry.op) {
+        case TRACESEED:
+        case TRACEINSERT:
+            return db.insert(Patient(entry.name, entry.serial));
+        case TRACEREMOVE:
+            return db.remove(entry.name, entry.serial);
+        case TRACEGET:
+            return !db.getPatient(entry.name, entry.serial).getKey().empty();
+        case TRACEUPDATE:
+            return db.updateSerialNumber(entry.name, entry.serial, (int)entry.arg);
+        case TRACEPOLICY:
+            db.changeProbPolicy((prob_t)entry.arg);
+            return true;
+        case TRACEWHEEL:
+            db.enableExpiry(entry.serial != 0, entry.arg);
+            return true;
+        case TRACEMAXLOAD:
+            db.setMaxLoad(bitsLoad(entry.arg));
+            return bitsLoad(entry.arg) >= 0 && bitsLoad(entry.arg) < 1;
+        case TRACEDEADLINE:
+            return db.setExpiry(entry.name, entry.serial, entry.arg);
+        case TRACEEXPIRE:
+            return db.expire(entry.arg, entry.serial) > 0;
+        default:
+            return entry.outcome;
+    }
+}
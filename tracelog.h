@@ -0,0 +1,78 @@
+// CMSC 341 - Spring 2024 - Project 4
+#ifndef TRACELOG_H
+#define TRACELOG_H
+#include "exportwriter.h"
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+using namespace std;
+class VacDB;
+// Kinds of trace records. OPEN starts a trace with the capacity and policy
+// of the table, SEED carries a patient that was stored before recording
+// began, REHASH notes a rehash and is not replayed. DEADLINE is a setExpiry
+// call and EXPIRE an expire call, both with the full 64-bit tick. WHEEL is
+// an enableExpiry call with the tick the wheel starts at, MAXLOAD a
+// setMaxLoad call. BOOK is the slot a bookSlot call gave a patient; it only
+// goes to the change stream, as do the REMOVE records of the patients an
+// expire call removed, since a replay recomputes those.
+enum trace_t {TRACEOPEN = 1, TRACESEED, TRACEINSERT, TRACEREMOVE, TRACEGET, TRACEUPDATE,
+              TRACEPOLICY, TRACEREHASH, TRACEDEADLINE, TRACEEXPIRE, TRACEWHEEL, TRACEMAXLOAD,
+              TRACEBOOK};
+const uint32_t TRACEMAGIC = 0x5254564d;     // "MVTR" in a little endian file
+const uint32_t TRACEVERSION = 5;       // 2 widened arg to 64 bits, 3 added WHEEL,
+                                        // 4 exact serials for REMOVE and UPDATE, 5 MAXLOAD
+
+// A trace is an ExportHeader with TRACEMAGIC, then records of this header
+// followed by nameLength bytes of name
+struct TraceRecord{
+    uint8_t op;
+    uint8_t outcome;        // what the operation returned, found for TRACEGET
+    uint16_t nameLength;
+    int32_t serial;         // capacity for TRACEOPEN and TRACEREHASH, budget for TRACEEXPIRE,
+                            // 1 for on and 0 for off for TRACEWHEEL. A TRACEREMOVE or
+                            // TRACEUPDATE that succeeded holds the serial the patient had
+    int64_t arg;            // new serial for TRACEUPDATE, policy for TRACEOPEN,
+                            // TRACEPOLICY and TRACEREHASH, tick for TRACEDEADLINE,
+                            // TRACEEXPIRE and TRACEWHEEL, slot for TRACESEED and
+                            // TRACEBOOK, the float bits of the load for TRACEMAXLOAD
+};
+
+struct TraceEntry{
+    trace_t op;
+    bool outcome;
+    string name;
+    int serial;
+    long long arg;
+};
+
+// the load factor of a MAXLOAD record travels as the bits of the float
+inline long long loadBits(float load) {
+    uint32_t bits;
+    memcpy(&bits, &load, sizeof(bits));
+    return bits;
+}
+inline float bitsLoad(long long arg) {
+    uint32_t bits = (uint32_t)arg;
+    float load;
+    memcpy(&load, &bits, sizeof(load));
+    return load;
+}
+
+// Appends trace records to a file descriptor through an ExportWriter
+class TraceLog{
+    public:
+    TraceLog(int fd);
+    // names longer than 65535 bytes are cut
+    void record(trace_t op, const string& name, int serial, long long arg, bool outcome);
+    // Returns false if a write failed
+    bool flush() {return m_writer.flush();}
+    private:
+    ExportWriter m_writer;
+};
+
+// reads a whole trace, Returns false if the header is wrong or the last record is cut
+bool readTrace(int fd, vector<TraceEntry>& entries);
+// runs one traced operation against db, Returns its outcome
+bool applyTraceEntry(VacDB& db, const TraceEntry& entry);
+#endif
@@ -0,0 +1,1177 @@
+// CMSC 341 - Spring 2024 - Project 4
+// Benchmark driver for VacDB
+// build: g++ -std=c++17 -O2 -pthread vacdb.cpp slotbook.cpp prefixindex.cpp fuzzyindex.cpp exportwriter.cpp serialallocator.cpp namefilter.cpp compactdb.cpp tracelog.cpp timingwheel.cpp frozendb.cpp pagealloc.cpp changestream.cpp snapshot.cpp vacbench.cpp -o vacbench
+// usage: ./vacbench [benchmark name], runs every benchmark when no name is given
+#include "vacdb.h"
+#include "compactdb.h"
+#include "basicvacdb.h"
+#include "frozendb.h"
+#include "snapshot.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <random>
+#include <fstream>
+#include <vector>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <sched.h>
+#include <ctime>
+using namespace std::chrono;
+
+unsigned int hashCode(const string str) {
+   unsigned int val = 0 ;
+   const unsigned int thirtyThree = 33 ;  // magic number from textbook
+   for (unsigned int i = 0 ; i < str.length(); i++)
+      val = val * thirtyThree + str[i] ;
+   return val ;
+}
+
+const int BENCHCAP = 99991;  // table capacity of the fixed-size benchmarks
+
+string namesDB[6] = {"john", "serina", "mike", "celina", "alexander", "jessica"};
+
+// builds n distinct names sharing the common first names of namesDB
+vector<string> makeNames(int n, const string& tag = "") {
+    vector<string> names;
+    names.reserve(n);
+    for (int i = 0; i < n; i++) {
+        names.push_back(namesDB[i % 6] + tag + to_string(i));
+    }
+    return names;
+}
+
+// draws the next full name: a given name and a surname of two or three
+// syllables, from a fixed seed so every run sees the same population
+string nextFullName(unsigned int& seed) {
+    static const char* given[] = {"john", "serina", "mike", "celina", "alexander", "jessica",
+        "maria", "james", "linda", "robert", "patricia", "david", "jennifer", "william",
+        "elizabeth", "richard", "susan", "joseph", "karen", "thomas", "nancy", "daniel",
+        "lisa", "matthew", "betty", "anthony", "sandra", "mark", "ashley", "steven"};
+    static const char* syllables[] = {"an", "ber", "cal", "do", "er", "fin", "gar", "hol",
+        "in", "jo", "kel", "lan", "mor", "nel", "os", "per", "qui", "ros", "son", "ter",
+        "ul", "van", "wel", "xi", "yor", "zan", "ste", "mac", "ley", "ford", "ton", "ham"};
+    seed = seed * 1103515245 + 12345;
+    string name = string(given[(seed >> 16) % 30]) + " ";
+    int parts = 2 + (seed >> 8) % 2;
+    for (int p = 0; p < parts; p++) {
+        seed = seed * 1103515245 + 12345;
+        name += syllables[(seed >> 16) % 32];
+    }
+    return name;
+}
+
+// builds n full names with nextFullName
+vector<string> makeFullNames(int n, unsigned int seed = 10) {
+    vector<string> names;
+    names.reserve(n);
+    for (int i = 0; i < n; i++) {
+        names.push_back(nextFullName(seed));
+    }
+    return names;
+}
+
+double nsPerOp(steady_clock::time_point start, steady_clock::time_point stop, int ops) {
+    return duration_cast<nanoseconds>(stop - start).count() / double(ops);
+}
+
+const char* policyName(prob_t policy) {
+    switch (policy) {
+        case QUADRATIC: return "QUADRATIC";
+        case DOUBLEHASH: return "DOUBLEHASH";
+        case LINEAR: return "LINEAR";
+        case ROBINHOOD: return "ROBINHOOD";
+        case CUCKOO: return "CUCKOO";
+    }
+    return "?";
+}
+
+/**
+ * Name: benchProbing
+ * Desc: Fills a BENCHCAP table to 0.5, 0.7 and 0.9 load under every policy with rehashing
+ *       disabled, then reports insert, hit and miss latency and bytes per live patient.
+ */
+void benchProbing() {
+    cout << "== probing: latency and memory per policy and load ==" << endl;
+    cout << "policy      load  inserted  insert(ns)  hit(ns)  miss(ns)  bytes/patient" << endl;
+    const prob_t policies[] = {LINEAR, QUADRATIC, DOUBLEHASH, ROBINHOOD};
+    const float loads[] = {0.5, 0.7, 0.9};
+    vector<string> misses = makeNames(20000, "x");
+
+    for (prob_t policy : policies) {
+        for (float load : loads) {
+            VacDB db(BENCHCAP, hashCode, policy);
+            db.setMaxLoad(0.95);
+            int count = int(BENCHCAP * load);
+            vector<string> names = makeNames(count);
+
+            int inserted = 0;
+            auto t0 = steady_clock::now();
+            for (int i = 0; i < count; i++) {
+                inserted += db.insert(Patient(names[i], MINID + i % (MAXID - MINID)));
+            }
+            auto t1 = steady_clock::now();
+            int found = 0;
+            for (int i = 0; i < count; i++) {
+                found += db.getPatient(names[i], MINID + i % (MAXID - MINID)).getUsed();
+            }
+            auto t2 = steady_clock::now();
+            for (const string& name : misses) {
+                found += db.getPatient(name, MINID).getUsed();
+            }
+            auto t3 = steady_clock::now();
+
+            printf("%-10s  %.1f  %8d  %10.1f  %7.1f  %8.1f  %13.1f\n", policyName(policy), load,
+                   inserted, nsPerOp(t0, t1, count), nsPerOp(t1, t2, count),
+                   nsPerOp(t2, t3, misses.size()), db.memoryUsage() / double(inserted));
+            if (found != inserted)
+                cout << "  warning: " << inserted - found << " inserted patients were not found" << endl;
+        }
+    }
+}
+
+// prints p50, p99, p99.9 and max of per-op latencies in nanoseconds
+void printPercentiles(vector<long long>& samples) {
+    sort(samples.begin(), samples.end());
+    size_t n = samples.size();
+    printf("%7lld  %7lld  %7lld  %8lld", samples[n / 2], samples[n * 99 / 100],
+           samples[n * 999 / 1000], samples[n - 1]);
+}
+
+/**
+ * Name: benchTail
+ * Desc: Times every lookup individually on a BENCHCAP table filled with names that share
+ *       the common first names of namesDB, and reports the tail of the hit and miss latency.
+ */
+void benchTail() {
+    cout << "== tail: per-lookup latency percentiles (ns) ==" << endl;
+    cout << "policy      load  hit p50  hit p99  p99.9      max  miss p50  p99  p99.9      max" << endl;
+    const prob_t policies[] = {LINEAR, QUADRATIC, DOUBLEHASH, ROBINHOOD, CUCKOO};
+    const float loads[] = {0.5, 0.85};
+    vector<string> misses = makeNames(50000, "x");
+
+    for (float load : loads) {
+        for (prob_t policy : policies) {
+            VacDB db(BENCHCAP, hashCode, policy);
+            db.setMaxLoad(0.95);
+            int count = int(BENCHCAP * load);
+            vector<string> names = makeNames(count);
+            for (int i = 0; i < count; i++) {
+                db.insert(Patient(names[i], MINID + i % (MAXID - MINID)));
+            }
+
+            vector<long long> hits, missed;
+            hits.reserve(count);
+            missed.reserve(misses.size());
+            int found = 0;
+            for (int i = 0; i < count; i++) {
+                auto t0 = steady_clock::now();
+                found += db.getPatient(names[i], MINID + i % (MAXID - MINID)).getUsed();
+                hits.push_back(duration_cast<nanoseconds>(steady_clock::now() - t0).count());
+            }
+            for (const string& name : misses) {
+                auto t0 = steady_clock::now();
+                found += db.getPatient(name, MINID).getUsed();
+                missed.push_back(duration_cast<nanoseconds>(steady_clock::now() - t0).count());
+            }
+            printf("%-10s  %.2f ", policyName(policy), load);
+            printPercentiles(hits);
+            printf("  ");
+            printPercentiles(missed);
+            printf("\n");
+        }
+    }
+}
+
+/**
+ * Name: benchBooking
+ * Desc: Simulates the morning booking rush: every registered patient books the first free
+ *       slot after a random (day, time) at a random station, then a tenth of them cancel.
+ *       Reports the raw SlotBook rate and the rate through VacDB::bookSlot and VacDB::remove.
+ */
+void benchBooking() {
+    cout << "== booking: slot booking rush ==" << endl;
+    const int days = 14, stations = 20, slotsPerDay = 96, capacity = 4;
+    const int patients = 90000;
+    vector<string> names = makeNames(patients);
+    vector<int> dayOf(patients), stationOf(patients), timeOf(patients);
+    unsigned int seed = 10;
+    for (int i = 0; i < patients; i++) {
+        seed = seed * 1103515245 + 12345;
+        dayOf[i] = (seed >> 8) % days;
+        stationOf[i] = (seed >> 12) % stations;
+        timeOf[i] = (seed >> 18) % slotsPerDay;
+    }
+
+    SlotBook raw(days, stations, slotsPerDay, capacity);
+    vector<int> slots(patients);
+    auto t0 = steady_clock::now();
+    for (int i = 0; i < patients; i++) {
+        slots[i] = raw.book(dayOf[i], stationOf[i], timeOf[i]);
+    }
+    auto t1 = steady_clock::now();
+    for (int i = 0; i < patients; i += 10) {
+        raw.cancel(slots[i]);
+    }
+    auto t2 = steady_clock::now();
+    printf("SlotBook book    %10.0f req/s\n", 1e9 / nsPerOp(t0, t1, patients));
+    printf("SlotBook cancel  %10.0f req/s\n", 1e9 / nsPerOp(t1, t2, patients / 10));
+
+    SlotBook book(days, stations, slotsPerDay, capacity);
+    VacDB db(BENCHCAP, hashCode, ROBINHOOD);
+    db.setSlotBook(&book);
+    for (int i = 0; i < patients; i++) {
+        db.insert(Patient(names[i], MINID + i % (MAXID - MINID)));
+    }
+    int booked = 0;
+    t0 = steady_clock::now();
+    for (int i = 0; i < patients; i++) {
+        booked += (db.bookSlot(names[i], MINID + i % (MAXID - MINID), dayOf[i], stationOf[i], timeOf[i]) != NOSLOT);
+    }
+    t1 = steady_clock::now();
+    for (int i = 0; i < patients; i += 10) {
+        db.remove(Patient(names[i], MINID + i % (MAXID - MINID)));
+    }
+    t2 = steady_clock::now();
+    printf("VacDB bookSlot   %10.0f req/s (%d of %d booked)\n", 1e9 / nsPerOp(t0, t1, patients), booked, patients);
+    printf("VacDB remove     %10.0f req/s\n", 1e9 / nsPerOp(t1, t2, patients / 10));
+}
+
+/**
+ * Name: benchPrefix
+ * Desc: Measures the insert and remove overhead of the prefix index, and the latency of
+ *       top-10 prefix searches as an operator types the first 1 to 6 letters of a name.
+ */
+void benchPrefix() {
+    cout << "== prefix: autocomplete index ==" << endl;
+    const int count = 85000;
+    vector<string> names = makeNames(count);
+
+    for (int on = 0; on <= 1; on++) {
+        VacDB db(BENCHCAP, hashCode, ROBINHOOD);
+        db.enablePrefixIndex(on);
+        auto t0 = steady_clock::now();
+        for (int i = 0; i < count; i++) {
+            db.insert(Patient(names[i], MINID + i % (MAXID - MINID)));
+        }
+        auto t1 = steady_clock::now();
+        for (int i = 0; i < count; i += 2) {
+            db.remove(Patient(names[i], MINID));
+        }
+        auto t2 = steady_clock::now();
+        printf("index %-3s  insert %6.1f ns  remove %6.1f ns\n", on ? "on" : "off",
+               nsPerOp(t0, t1, count), nsPerOp(t1, t2, count / 2));
+        if (!on) continue;
+
+        size_t matches = 0;
+        int queries = 0;
+        t0 = steady_clock::now();
+        for (int i = 1; i < count; i += 17) {
+            for (size_t len = 1; len <= 6 && len <= names[i].size(); len++) {
+                matches += db.prefixSearch(names[i].substr(0, len), 10).size();
+                queries++;
+            }
+        }
+        t1 = steady_clock::now();
+        printf("top-10 prefix search  %6.2f us/query (%d queries, %zu matches)\n",
+               nsPerOp(t0, t1, queries) / 1000, queries, matches);
+    }
+}
+
+/**
+ * Name: benchFuzzy
+ * Desc: Indexes 1M patients and times fuzzy searches for misspelled names: one letter
+ *       dropped, one letter replaced, or two letters swapped, with up to 1 and 2 edits.
+ */
+void benchFuzzy() {
+    cout << "== fuzzy: typo-tolerant search at 1M patients ==" << endl;
+    const int count = 1000000;
+    vector<string> names = makeFullNames(count);
+    for (int on = 0; on <= 1; on++) {
+        VacDB db(MINPRIME, hashCode, DOUBLEHASH);
+        db.enableFuzzyIndex(on);
+        int inserted = 0;
+        auto t0 = steady_clock::now();
+        for (int i = 0; i < count; i++) {
+            inserted += db.insert(Patient(names[i], MINID + i % (MAXID - MINID)));
+        }
+        auto t1 = steady_clock::now();
+        printf("insert, index %-3s  %6.1f ns/op (%d patients)\n", on ? "on" : "off", nsPerOp(t0, t1, count), inserted);
+        if (!on) continue;
+
+        vector<string> typos;
+        for (int i = 7; i < count; i += 997) {
+            string typo = names[i];
+            size_t pos = i % typo.size();
+            if (i % 3 == 0) typo.erase(pos, 1);
+            else if (i % 3 == 1) typo[pos] = 'q';
+            else if (pos + 1 < typo.size()) swap(typo[pos], typo[pos + 1]);
+            typos.push_back(typo);
+        }
+        for (int maxEdits = 1; maxEdits <= 2; maxEdits++) {
+            vector<long long> samples;
+            size_t matches = 0;
+            for (const string& typo : typos) {
+                auto start = steady_clock::now();
+                matches += db.fuzzySearch(typo, maxEdits, 5).size();
+                samples.push_back(duration_cast<nanoseconds>(steady_clock::now() - start).count());
+            }
+            long long total = 0;
+            for (long long sample : samples) total += sample;
+            sort(samples.begin(), samples.end());
+            printf("maxEdits %d  mean %7.1f us  p50 %7.1f us  p99 %7.1f us  (%zu queries, %zu matches)\n",
+                   maxEdits, total / 1000.0 / samples.size(), samples[samples.size() / 2] / 1000.0,
+                   samples[samples.size() * 99 / 100] / 1000.0, samples.size(), matches);
+        }
+    }
+}
+
+// runs an export into a fresh temporary file and prints its time and throughput
+void timeExport(const char* label, const function<long long(int)>& run) {
+    char path[] = "/tmp/vacbenchXXXXXX";
+    int fd = mkstemp(path);
+    auto start = steady_clock::now();
+    long long bytes = run(fd);
+    auto stop = steady_clock::now();
+    close(fd);
+    unlink(path);
+    double seconds = duration_cast<nanoseconds>(stop - start).count() / 1e9;
+    printf("%-22s %9.2f ms  %9.1f MB/s  (%lld bytes)\n", label, seconds * 1e3, bytes / seconds / 1e6, bytes);
+}
+
+/**
+ * Name: benchExport
+ * Desc: Fills a BENCHCAP table to 0.9 and a table of 1M patients, then writes them to a file with
+ *       dump(), with a per-line flushed stream like the original dump, and with both exports.
+ */
+void benchExport() {
+    cout << "== export: dump() against the buffered text and binary exports ==" << endl;
+    for (int n : {90000, 1000000}) {
+        vector<string> names = makeFullNames(n);
+        VacDB db(n == 90000 ? BENCHCAP : 2 * n + 1, hashCode, LINEAR);
+        db.setMaxLoad(0.95);
+        for (int i = 0; i < n; i++)
+            db.insert(Patient(names[i], MINID + i % (MAXID - MINID + 1)));
+        cout << n << " patients" << endl;
+        timeExport("endl per line", [&](int fd) {
+            ofstream out("/proc/self/fd/" + to_string(fd));
+            for (int i = 0; i < n; i++)
+                out << names[i] << " (" << MINID + i % (MAXID - MINID + 1) << ", 1)" << endl;
+            return (long long)out.tellp();
+        });
+        timeExport("dump()", [&](int fd) {
+            ofstream out("/proc/self/fd/" + to_string(fd));
+            streambuf* saved = cout.rdbuf(out.rdbuf());
+            db.dump();
+            cout.rdbuf(saved);
+            return (long long)out.tellp();
+        });
+        timeExport("exportText", [&](int fd) {return db.exportText(fd);});
+        timeExport("exportBinary", [&](int fd) {return db.exportBinary(fd);});
+    }
+}
+
+/**
+ * Name: benchSerials
+ * Desc: Fills serial ranges of MINID..MAXID and of 100M serials to several occupancies, then
+ *       times cycles that release a random serial in use and allocate the next free one. Also
+ *       compares an in-use check against the scan of a table it replaces.
+ */
+void benchSerials() {
+    cout << "== serials: allocate/free cycles and uniqueness checks ==" << endl;
+    const int cycles = 1000000;
+    for (int high : {MAXID, MINID + 100000000 - 1}) {
+        for (double fill : {0.5, 0.9, 0.99}) {
+            SerialAllocator serials(MINID, high);
+            mt19937 rng(7);
+            long long range = (long long)high - MINID + 1;
+            vector<int> inUse;
+            inUse.reserve(range * fill + 1);
+            // random serials in use, as left behind by earlier removals
+            uniform_int_distribution<int> pick(MINID, high);
+            while ((double)inUse.size() < range * fill) {
+                int serial = pick(rng);
+                if (serials.reserve(serial))
+                    inUse.push_back(serial);
+            }
+            auto start = steady_clock::now();
+            for (int i = 0; i < cycles; i++) {
+                size_t victim = rng() % inUse.size();
+                serials.release(inUse[victim]);
+                inUse[victim] = serials.allocate();
+            }
+            auto stop = steady_clock::now();
+            printf("range %9lld  fill %4.2f  %7.1f ns/cycle\n", range, fill, nsPerOp(start, stop, cycles));
+        }
+    }
+
+    // what a duplicate check costs without the allocator: a scan over a
+    // BENCHCAP table holding 90k patients
+    vector<Patient*> table(BENCHCAP, nullptr);
+    SerialAllocator serials(MINID, MINID + 100000);
+    for (int i = 0; i < 90000; i++) {
+        table[(long long)i * 7919 % BENCHCAP] = new Patient(namesDB[i % 6], MINID + i, true);
+        serials.reserve(MINID + i);
+    }
+    const int checks = 1000;
+    long long taken = 0;
+    auto start = steady_clock::now();
+    for (int i = 0; i < checks; i++) {
+        int serial = MINID + (i * 97) % 100000;
+        for (const Patient* entry : table) {
+            if (entry != nullptr && entry->getUsed() && entry->getSerial() == serial) {
+                taken++;
+                break;
+            }
+        }
+    }
+    auto stop = steady_clock::now();
+    printf("in-use check, table scan  %10.1f ns/op  (%lld taken)\n", nsPerOp(start, stop, checks), taken);
+    taken = 0;
+    start = steady_clock::now();
+    for (int i = 0; i < cycles; i++)
+        taken += serials.inUse(MINID + (i * 97) % 100000);
+    stop = steady_clock::now();
+    printf("in-use check, allocator   %10.1f ns/op  (%lld taken)\n", nsPerOp(start, stop, cycles), taken);
+    for (Patient* entry : table)
+        delete entry;
+}
+
+/**
+ * Name: benchFilter
+ * Desc: Times hits, misses and absent removes on 1M full names with the name filter off and on,
+ *       under DOUBLEHASH at the default load and LINEAR at 0.9 where miss chains are long.
+ */
+void benchFilter() {
+    cout << "== filter: negative lookups with a counting Bloom filter ==" << endl;
+    const int count = 1000000;
+    vector<string> names = makeFullNames(count);
+    vector<string> walkins = makeFullNames(count, 99);
+    for (string& name : walkins)
+        name += " jr";     // not registered yet
+    const int serials = MAXID - MINID + 1;
+    for (prob_t policy : {DOUBLEHASH, LINEAR}) {
+        for (int on = 0; on <= 1; on++) {
+            VacDB db(MINPRIME, hashCode, policy);
+            if (policy == LINEAR) db.setMaxLoad(0.9);
+            db.enableFilter(on);
+            auto t0 = steady_clock::now();
+            for (int i = 0; i < count; i++)
+                db.insert(Patient(names[i], MINID + i % serials));
+            auto t1 = steady_clock::now();
+            long long found = 0;
+            for (int i = 0; i < count; i++)
+                found += (db.getPatient(names[i], MINID + i % serials).getSerial() != 0);
+            auto t2 = steady_clock::now();
+            long long missed = 0;
+            for (int i = 0; i < count; i++)
+                missed += (db.getPatient(walkins[i], MINID).getSerial() == 0);
+            auto t3 = steady_clock::now();
+            for (int i = 0; i < count; i++)
+                db.remove(Patient(walkins[i], MINID));
+            auto t4 = steady_clock::now();
+            printf("%-10s filter %-3s  insert %6.1f ns  hit %6.1f ns  miss %6.1f ns  absent remove %6.1f ns  %6.1f MB\n",
+                   policyName(policy), on ? "on" : "off", nsPerOp(t0, t1, count), nsPerOp(t1, t2, count),
+                   nsPerOp(t2, t3, count), nsPerOp(t3, t4, count), db.memoryUsage() / 1e6);
+            (void)found; (void)missed;
+        }
+    }
+
+    NameFilter filter(count);
+    for (int i = 0; i < count; i++)
+        filter.add(names[i]);
+    long long passed = 0;
+    for (int i = 0; i < count; i++)
+        passed += filter.mayContain(walkins[i]);
+    printf("false positive rate at %d names: %.2f%% (%.1f bits per name)\n", count,
+           100.0 * passed / count, filter.memoryUsage() * 8.0 / count);
+}
+
+// Returns the resident set size of the process in bytes
+long long residentBytes() {
+    FILE* status = fopen("/proc/self/status", "r");
+    char line[256];
+    long long kb = 0;
+    while (status != nullptr && fgets(line, sizeof(line), status)) {
+        if (sscanf(line, "VmRSS: %lld kB", &kb) == 1) break;
+    }
+    if (status != nullptr) fclose(status);
+    return kb * 1024;
+}
+
+// fills a table with n generated patients and prints its accounting and RSS growth
+template <class Table>
+void measureMemory(const char* label, Table& db, int n) {
+    long long before = residentBytes();
+    unsigned int seed = 10;
+    int stored = 0;
+    auto start = steady_clock::now();
+    for (int i = 0; i < n; i++)
+        stored += db.insert(Patient(nextFullName(seed), MINID + i % (MAXID - MINID + 1)));
+    auto stop = steady_clock::now();
+    long long rss = residentBytes() - before;
+    printf("%-14s %9d patients  %7.1f ns/insert  memoryUsage %6.1f B/patient  RSS %7.1f MB, %6.1f B/patient\n",
+           label, stored, nsPerOp(start, stop, n), (double)db.memoryUsage() / stored, rss / 1e6, (double)rss / stored);
+    fflush(stdout);
+}
+
+/**
+ * Name: benchMemory
+ * Desc: Builds VacDB and CompactVacDB at 1M and 10M patients, each in a child process so that
+ *       its RSS growth is not hidden by memory freed earlier.
+ */
+void benchMemory() {
+    cout << "== memory: bytes per patient of VacDB and CompactVacDB ==" << endl;
+    for (int n : {1000000, 10000000}) {
+        for (int compact = 0; compact <= 1; compact++) {
+            fflush(stdout);
+            pid_t child = fork();
+            if (child == 0) {
+                if (compact) {
+                    CompactVacDB db(MINPRIME, hashCode);
+                    measureMemory("CompactVacDB", db, n);
+                } else {
+                    VacDB db(MINPRIME, hashCode, DOUBLEHASH);
+                    measureMemory("VacDB", db, n);
+                }
+                _exit(0);
+            }
+            waitpid(child, nullptr, 0);
+        }
+    }
+}
+
+// what the daily report folds: patients and the sum of their serials
+struct DailyTotals{
+    long long patients;
+    long long serials;
+};
+
+/**
+ * Name: benchIterate
+ * Desc: Folds a report over 1M patients with the iterator, forEach and parallelReduce.
+ */
+void benchIterate() {
+    cout << "== iterate: daily report over 1M patients ==" << endl;
+    VacDB db(MINPRIME, hashCode, DOUBLEHASH);
+    unsigned int seed = 10;
+    for (int i = 0; i < 1000000; i++)
+        db.insert(Patient(nextFullName(seed), MINID + i % (MAXID - MINID + 1)));
+    const int rounds = 10;
+    auto report = [](const char* label, steady_clock::time_point start, DailyTotals totals) {
+        double ms = duration_cast<nanoseconds>(steady_clock::now() - start).count() / 1e6 / rounds;
+        printf("%-22s %7.2f ms  (%lld patients, serial sum %lld)\n", label, ms, totals.patients, totals.serials);
+    };
+
+    DailyTotals totals = {0, 0};
+    auto start = steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+        totals = {0, 0};
+        for (const Patient& patient : db) {
+            totals.patients++;
+            totals.serials += patient.getSerial();
+        }
+    }
+    report("range for", start, totals);
+
+    start = steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+        totals = {0, 0};
+        db.forEach([&totals](const Patient& patient) {
+            totals.patients++;
+            totals.serials += patient.getSerial();
+        });
+    }
+    report("forEach", start, totals);
+
+    for (int threads : {1, 2, 4}) {
+        start = steady_clock::now();
+        for (int r = 0; r < rounds; r++) {
+            totals = db.parallelReduce(DailyTotals{0, 0},
+                [](const Patient& patient) {return DailyTotals{1, patient.getSerial()};},
+                [](DailyTotals a, DailyTotals b) {return DailyTotals{a.patients + b.patients, a.serials + b.serials};},
+                threads);
+        }
+        string label = "parallelReduce x" + to_string(threads);
+        report(label.c_str(), start, totals);
+    }
+    printf("(%u hardware threads)\n", thread::hardware_concurrency());
+}
+
+/**
+ * Name: benchTrace
+ * Desc: Runs 1M mixed operations on 200k patients with tracing off and on to measure the
+ *       recording overhead. The trace is kept in /tmp/vacdb.trace for ./vacreplay.
+ */
+void benchTrace() {
+    cout << "== trace: recording overhead ==" << endl;
+    const int patients = 200000;
+    const int ops = 1000000;
+    vector<string> names = makeFullNames(patients);
+    const int serials = MAXID - MINID + 1;
+    for (int on = 0; on <= 1; on++) {
+        VacDB db(MINPRIME, hashCode, DOUBLEHASH);
+        int fd = on ? open("/tmp/vacdb.trace", O_WRONLY | O_CREAT | O_TRUNC, 0644) : -1;
+        if (on) db.startTrace(fd);
+        unsigned int seed = 3;
+        auto start = steady_clock::now();
+        for (int i = 0; i < ops; i++) {
+            seed = seed * 1103515245 + 12345;
+            int pick = (seed >> 8) % patients;
+            int roll = (seed >> 4) % 100;
+            if (roll < 60)
+                db.getPatient(names[pick], MINID + pick % serials);
+            else if (roll < 85)
+                db.insert(Patient(names[pick], MINID + pick % serials));
+            else if (roll < 95)
+                db.remove(Patient(names[pick], MINID + pick % serials));
+            else
+                db.updateSerialNumber(Patient(names[pick], MINID + pick % serials), MINID + pick % serials);
+        }
+        if (on) db.stopTrace();
+        auto stop = steady_clock::now();
+        long long bytes = on ? lseek(fd, 0, SEEK_END) : 0;
+        if (on) close(fd);
+        printf("tracing %-3s  %6.1f ns/op", on ? "on" : "off", nsPerOp(start, stop, ops));
+        if (on) printf("  %.1f MB trace, %.1f bytes/op", bytes / 1e6, (double)bytes / ops);
+        printf("\n");
+    }
+}
+
+// the hash function of VacDB comes from another translation unit; reading
+// it through a volatile keeps the compiler from inlining it here as well
+static hash_fn volatile opaqueHash = hashCode;
+
+// times inserts, hits and misses of one BasicVacDB configuration
+template <class Table>
+void runGeneric(const char* label, Table& table, const vector<string>& names, const vector<string>& misses) {
+    const int serials = MAXID - MINID + 1;
+    int inserted = 0;
+    auto t0 = steady_clock::now();
+    for (size_t i = 0; i < names.size(); i++)
+        inserted += table.insert(names[i], MINID + i % serials);
+    auto t1 = steady_clock::now();
+    long long fold = 0;
+    for (const string& name : names)
+        fold += *table.find(name);
+    auto t2 = steady_clock::now();
+    int found = 0;
+    for (const string& name : misses)
+        found += table.contains(name);
+    auto t3 = steady_clock::now();
+    printf("%-34s  %10.1f  %7.1f  %8.1f\n", label, nsPerOp(t0, t1, names.size()),
+           nsPerOp(t1, t2, names.size()), nsPerOp(t2, t3, misses.size()));
+    if (inserted != (int)names.size() || found != 0 || fold == 0)
+        cout << "  warning: unexpected results" << endl;
+}
+
+/**
+ * Name: benchGeneric
+ * Desc: Inserts 1M distinct names into BasicVacDB with the hash called through a function
+ *       pointer and as an inlined functor under each probing policy, and into a DOUBLEHASH
+ *       VacDB for reference, then times hits and misses.
+ */
+void benchGeneric() {
+    cout << "== generic: function pointer against functor hashing ==" << endl;
+    cout << "table                               insert(ns)  hit(ns)  miss(ns)" << endl;
+    const int count = 1000000;
+    vector<string> names = makeNames(count);
+    vector<string> misses = makeNames(count / 5, "x");
+
+    {
+        VacDB db(MINPRIME, opaqueHash, DOUBLEHASH);
+        const int serials = MAXID - MINID + 1;
+        auto t0 = steady_clock::now();
+        for (int i = 0; i < count; i++)
+            db.insert(Patient(names[i], MINID + i % serials));
+        auto t1 = steady_clock::now();
+        long long fold = 0;
+        for (int i = 0; i < count; i++)
+            fold += db.getPatient(names[i], MINID + i % serials).getSerial();
+        auto t2 = steady_clock::now();
+        for (const string& name : misses)
+            fold += db.getPatient(name, MINID).getSerial();
+        auto t3 = steady_clock::now();
+        printf("%-34s  %10.1f  %7.1f  %8.1f\n", "VacDB DOUBLEHASH", nsPerOp(t0, t1, count),
+               nsPerOp(t1, t2, count), nsPerOp(t2, t3, misses.size()));
+    }
+    {
+        BasicVacDB<string, int, FunctionHash<string>, LinearProbe> table(BASICMINCAP, {opaqueHash});
+        runGeneric("function pointer, LinearProbe", table, names, misses);
+    }
+    {
+        BasicVacDB<string, int, NameHash, LinearProbe> table;
+        runGeneric("functor, LinearProbe", table, names, misses);
+    }
+    {
+        BasicVacDB<string, int, NameHash, QuadraticProbe> table;
+        runGeneric("functor, QuadraticProbe", table, names, misses);
+    }
+    {
+        BasicVacDB<string, int, NameHash, DoubleHashProbe> table;
+        runGeneric("functor, DoubleHashProbe", table, names, misses);
+    }
+}
+
+/**
+ * Name: benchCampaign
+ * Desc: Simulates a 30-day campaign in minute ticks. 40k patients a day book an appointment one
+ *       to 14 days ahead, and 50 lookups a minute go to patients of the last week. Without expiry
+ *       every record stays. With expiry a record expires a day after its appointment, and
+ *       expire() runs once a minute. Reports the table size and lookup latency per day.
+ */
+void benchCampaign() {
+    cout << "== campaign: 30 days with and without expiry ==" << endl;
+    const int days = 30;
+    const int perDay = 40000;
+    const int dayTicks = 24 * 60;
+    const int lookups = 50;
+    vector<string> names = makeNames(days * perDay);
+    const int serials = MAXID - MINID + 1;
+    for (int expiry = 0; expiry <= 1; expiry++) {
+        cout << (expiry ? "with expiry" : "without expiry") << endl;
+        cout << "day      live  capacity     MB  lookup(ns)  expire(ms/day)" << endl;
+        VacDB db(MINPRIME, hashCode, DOUBLEHASH);
+        if (expiry) db.enableExpiry(true);
+        mt19937 generator(5);
+        int admitted = 0;
+        int live = 0;
+        double lookupNs = 0, expireNs = 0;
+        long long found = 0;
+        for (long long now = 0; now < (long long)days * dayTicks; now++) {
+            int due = (int)((now + 1) * perDay / dayTicks);
+            for (; admitted < due; admitted++) {
+                live += db.insert(Patient(names[admitted], MINID + admitted % serials));
+                long long appointment = now + dayTicks * (1 + generator() % 14);
+                if (expiry) db.setExpiry(names[admitted], MINID + admitted % serials, appointment + dayTicks);
+            }
+            int week = min(admitted, 7 * perDay);
+            int picks[lookups];
+            for (int i = 0; i < lookups; i++)
+                picks[i] = admitted - 1 - generator() % week;
+            auto t0 = steady_clock::now();
+            for (int i = 0; i < lookups; i++)
+                found += db.getPatient(names[picks[i]], MINID + picks[i] % serials).getUsed();
+            auto t1 = steady_clock::now();
+            if (expiry) live -= db.expire(now);
+            auto t2 = steady_clock::now();
+            lookupNs += duration_cast<nanoseconds>(t1 - t0).count();
+            expireNs += duration_cast<nanoseconds>(t2 - t1).count();
+            if ((now + 1) % dayTicks == 0) {
+                int day = (int)((now + 1) / dayTicks);
+                if (day == 1 || day % 5 == 0)
+                    printf("%3d  %8d  %8d  %5.1f  %10.1f  %14.1f\n", day, live, db.capacity(),
+                           db.memoryUsage() / 1e6, lookupNs / (dayTicks * lookups), expireNs / 1e6);
+                lookupNs = expireNs = 0;
+            }
+        }
+        printf("lookups found %.1f%%\n", 100.0 * found / ((long long)days * dayTicks * lookups));
+    }
+}
+
+/**
+ * Name: benchFreeze
+ * Desc: Freezes a table of 1M patients and compares hit and miss latency and memory of the
+ *       live table and the snapshot, then saves the snapshot and times loading it back.
+ */
+void benchFreeze() {
+    cout << "== freeze: live table against the minimal perfect hash snapshot ==" << endl;
+    const int count = 1000000;
+    const int serials = MAXID - MINID + 1;
+    vector<string> names = makeFullNames(count);
+    vector<string> misses = makeNames(count / 5, "x");
+    VacDB db(MINPRIME, hashCode, DOUBLEHASH);
+    int stored = 0;
+    for (int i = 0; i < count; i++)
+        stored += db.insert(Patient(names[i], MINID + i % serials));
+
+    auto t0 = steady_clock::now();
+    FrozenVacDB frozen = db.freeze();
+    auto t1 = steady_clock::now();
+    printf("%d patients frozen in %.0f ms, %d levels\n", stored,
+           duration_cast<microseconds>(t1 - t0).count() / 1e3, frozen.levels());
+
+    vector<int> order(count);
+    for (int i = 0; i < count; i++) order[i] = i;
+    shuffle(order.begin(), order.end(), mt19937(3));
+    cout << "table         hit(ns)  miss(ns)  bytes/patient" << endl;
+    long long found = 0;
+    auto run = [&](const char* label, auto lookup, size_t bytes) {
+        auto start = steady_clock::now();
+        for (int i : order)
+            found += lookup(names[i], MINID + i % serials);
+        auto middle = steady_clock::now();
+        for (const string& name : misses)
+            found += lookup(name, MINID);
+        auto stop = steady_clock::now();
+        printf("%-12s  %7.1f  %8.1f  %13.1f\n", label, nsPerOp(start, middle, count),
+               nsPerOp(middle, stop, misses.size()), (double)bytes / stored);
+    };
+    run("VacDB", [&](const string& name, int serial) {return db.getPatient(name, serial).getUsed();},
+        db.memoryUsage());
+    run("frozen", [&](const string& name, int serial) {return frozen.getPatient(name, serial).getUsed();},
+        frozen.memoryUsage());
+    run("frozen find", [&](const string& name, int serial) {return frozen.contains(name, serial);},
+        frozen.memoryUsage());
+    // names that repeat with the same serial were stored once and are found every time
+    if (found != 3LL * count)
+        cout << "  warning: " << found << " lookups found, expected " << 3LL * count << endl;
+
+    int fd = open("/tmp/vacdb.frozen", O_RDWR | O_CREAT | O_TRUNC, 0644);
+    frozen.save(fd);
+    long long bytes = lseek(fd, 0, SEEK_END);
+    lseek(fd, 0, SEEK_SET);
+    FrozenVacDB loaded;
+    auto t2 = steady_clock::now();
+    bool ok = loaded.load(fd);
+    auto t3 = steady_clock::now();
+    close(fd);
+    unlink("/tmp/vacdb.frozen");
+    printf("snapshot file %.1f MB, loaded in %.0f ms%s\n", bytes / 1e6,
+           duration_cast<microseconds>(t3 - t2).count() / 1e3, ok ? "" : " (load failed)");
+}
+
+// Returns the kB of transparent huge pages the process maps, -1 if the kernel does not say
+long long anonHugeKB() {
+    ifstream smaps("/proc/self/smaps_rollup");
+    string line;
+    while (getline(smaps, line)) {
+        if (line.compare(0, 14, "AnonHugePages:") == 0)
+            return stoll(line.substr(14));
+    }
+    return -1;
+}
+
+/**
+ * Name: benchHugePages
+ * Desc: Random hits and misses on a table far larger than the TLB reach of 4 kB pages, with the
+ *       bucket arrays on ordinary pages, transparent huge pages, the hugetlbfs pool, and THP
+ *       interleaved over the NUMA nodes. Every request falls back to what the kernel grants,
+ *       so the backing obtained is printed next to the timings.
+ */
+void benchHugePages() {
+    cout << "== hugepages: bucket array page size and NUMA placement ==" << endl;
+    const int count = 2000000;
+    const int serials = MAXID - MINID + 1;
+    vector<string> names = makeNames(count);
+    vector<string> misses = makeNames(count / 2, "x");
+    VacDB db(4 * count, hashCode, DOUBLEHASH);      // about 64 MB of buckets at load 0.25
+    for (int i = 0; i < count; i++)
+        db.insert(Patient(names[i], MINID + i % serials));
+    vector<int> order(count);
+    for (int i = 0; i < count; i++) order[i] = i;
+    shuffle(order.begin(), order.end(), mt19937(5));
+
+    const char* backings[] = {"4k", "thp", "hugetlb"};
+    struct { const char* label; PagePolicy policy; } runs[] = {
+        {"default", DEFPAGES},
+        {"thp", {PAGETHP, NUMADEFAULT, 0}},
+        {"hugetlb", {PAGEHUGETLB, NUMADEFAULT, 0}},
+        {"thp+interleave", {PAGETHP, NUMAINTERLEAVE, 0}},
+        {"default", DEFPAGES},
+    };
+    printf("%d patients in %d buckets (%.0f MB)\n", count, db.capacity(), db.capacity() * 8 / 1e6);
+    cout << "request          backing  hit(ns)  miss(ns)  AnonHuge(MB)" << endl;
+    long long found = 0;
+    for (const auto& run : runs) {
+        db.setPagePolicy(run.policy);
+        auto start = steady_clock::now();
+        for (int i : order)
+            found += db.getPatient(names[i], MINID + i % serials).getUsed();
+        auto middle = steady_clock::now();
+        for (const string& name : misses)
+            found += db.getPatient(name, MINID).getUsed();
+        auto stop = steady_clock::now();
+        printf("%-15s  %7s  %7.1f  %8.1f  %12.1f\n", run.label, backings[db.tablePages()],
+               nsPerOp(start, middle, count), nsPerOp(middle, stop, misses.size()), anonHugeKB() / 1024.0);
+    }
+    if (found != 5LL * count)
+        cout << "  warning: " << found << " lookups found, expected " << 5LL * count << endl;
+
+    // the slot book: 24M slots, 48 MB of booking counts, booked at random coordinates
+    const int days = 365, stations = 64, slotsPerDay = 1024;
+    vector<int> dayOf(count), stationOf(count), timeOf(count);
+    mt19937 rng(6);
+    for (int i = 0; i < count; i++) {
+        dayOf[i] = rng() % days;
+        stationOf[i] = rng() % stations;
+        timeOf[i] = rng() % slotsPerDay;
+    }
+    cout << "slot book        backing  book(ns)" << endl;
+    for (const auto& run : runs) {
+        SlotBook book(days, stations, slotsPerDay, 2, run.policy);
+        int booked = 0;
+        auto start = steady_clock::now();
+        for (int i = 0; i < count; i++)
+            booked += (book.book(dayOf[i], stationOf[i], timeOf[i]) != NOSLOT);
+        auto stop = steady_clock::now();
+        printf("%-15s  %7s  %8.1f\n", run.label, backings[book.pages()], nsPerOp(start, stop, count));
+        if (booked != count)
+            cout << "  warning: " << booked << " bookings, expected " << count << endl;
+    }
+}
+
+// Returns the CPU time of the calling process in ns, children excluded
+long long processNanos() {
+    timespec now;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/**
+ * Name: benchStream
+ * Desc: Inserts 2M patients into a growing table without a change stream, with a stream no
+ *       one reads, and with a standby process applying the stream. The primary's cost is
+ *       measured in its own CPU time, since the standby shares the cores. The standby notes
+ *       when it has applied every LAGSTEP-th insert and sends the times back through a pipe,
+ *       which gives the replica lag against the time the primary made the insert.
+ */
+void benchStream() {
+    cout << "== stream: change stream overhead and standby lag ==" << endl;
+    const int count = 2000000;
+    const int LAGSTEP = 4096;
+    const int serials = MAXID - MINID + 1;
+    const string segment = "vacbench-stream-" + to_string(getpid());
+    vector<string> names = makeNames(count);
+    cout << "primary              insert(ns cpu)  insert(ns wall)" << endl;
+    for (int mode = 0; mode < 3; mode++) {
+        VacDB db(MINPRIME, hashCode, DOUBLEHASH);
+        int results[2];
+        pid_t child = -1;
+        if (mode > 0)
+            db.startStream(segment, 256 << 20);
+        if (mode == 2 && pipe(results) == 0) {
+            fflush(stdout);
+            child = fork();
+            if (child == 0) {
+                close(results[0]);
+                ChangeReader reader;
+                reader.open(segment);
+                VacDB* standby = nullptr;
+                vector<long long> applied;
+                long long records = 0;
+                TraceEntry entry;
+                while (!reader.closed()) {
+                    if (!reader.next(entry)) {
+                        sched_yield();
+                        continue;
+                    }
+                    if (entry.op == TRACEOPEN)
+                        standby = new VacDB(entry.serial, hashCode, (prob_t)entry.arg);
+                    else
+                        standby->applyChange(entry);
+                    // record 0 is the OPEN, record i + 1 the insert of names[i]
+                    if (records > 0 && (records - 1) % LAGSTEP == 0)
+                        applied.push_back(duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count());
+                    records++;
+                }
+                ssize_t written = write(results[1], applied.data(), applied.size() * sizeof(long long));
+                _exit(written < 0);
+            }
+            close(results[1]);
+        }
+
+        vector<long long> made;
+        long long cpu = processNanos();
+        auto start = steady_clock::now();
+        for (int i = 0; i < count; i++) {
+            db.insert(Patient(names[i], MINID + i % serials));
+            if (mode == 2 && i % LAGSTEP == 0)
+                made.push_back(duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count());
+        }
+        auto stop = steady_clock::now();
+        cpu = processNanos() - cpu;
+        const char* labels[] = {"no stream", "stream, no standby", "stream + standby"};
+        printf("%-19s  %14.1f  %15.1f\n", labels[mode], (double)cpu / count, nsPerOp(start, stop, count));
+        if (db.streamLost())
+            cout << "  warning: the stream overflowed" << endl;
+        db.stopStream();
+        if (child <= 0) continue;
+
+        vector<long long> applied(made.size());
+        size_t got = 0;
+        ssize_t n;
+        while (got < applied.size() * sizeof(long long) &&
+               (n = read(results[0], (char*)applied.data() + got, applied.size() * sizeof(long long) - got)) > 0)
+            got += n;
+        close(results[0]);
+        waitpid(child, nullptr, 0);
+        applied.resize(got / sizeof(long long));
+        vector<long long> lag;
+        for (size_t j = 0; j < applied.size(); j++)
+            lag.push_back(applied[j] - made[j]);
+        if (lag.empty()) continue;
+        long long last = applied.back() - duration_cast<nanoseconds>(stop.time_since_epoch()).count();
+        sort(lag.begin(), lag.end());
+        printf("standby lag over %zu samples: p50 %.3f ms  p99 %.3f ms  max %.3f ms, caught up %.3f ms after the last insert\n",
+               lag.size(), lag[lag.size() / 2] / 1e6, lag[lag.size() * 99 / 100] / 1e6, lag.back() / 1e6, max(last, 0LL) / 1e6);
+    }
+}
+
+// Returns the CPU time of the calling thread in ns
+long long threadNanos() {
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/**
+ * Name: benchSnapshot
+ * Desc: A writer replaces 700k of 1M patients, a remove and an insert each, while a report
+ *       scans the table over and over: with no report, with a snapshot held and no scan, with
+ *       scans of a snapshot, and with scans of the live table under a lock the writer takes
+ *       for every change, which is what a consistent report needed before. The writer's cost
+ *       is its own CPU time since the scan shares the cores; its longest change shows the stall.
+ */
+void benchSnapshot() {
+    cout << "== snapshot: writer throughput during a consistent scan ==" << endl;
+    const int count = 1000000;
+    const int changes = 700000;     // the deleted buckets stay below MAXDELRATIO
+    const int serials = MAXID - MINID + 1;
+    vector<string> names = makeNames(count);
+    vector<string> fresh = makeNames(changes, "n");
+    cout << "report               change(ns cpu)  change(ns wall)  longest(us)  scans  pages copied" << endl;
+    for (int mode = 0; mode < 4; mode++) {
+        VacDB db(4 * count, hashCode, DOUBLEHASH);      // no rehash during the run
+        for (int i = 0; i < count; i++)
+            db.insert(Patient(names[i], MINID + i % serials));
+        const int cap = db.capacity();
+        unique_ptr<VacSnapshot> view;
+        if (mode == 1 || mode == 2)
+            view.reset(new VacSnapshot(db.snapshot()));
+        mutex lock;
+        atomic<bool> writing(true), scanning(false);
+        atomic<int> scans(0);
+        atomic<long long> seen(0);
+        thread reader([&]() {
+            while (mode >= 2 && writing.load()) {
+                long long patients = 0, serials = 0;
+                auto add = [&](const Patient& patient) {patients++; serials += patient.getSerial();};
+                scanning = true;
+                if (mode == 2) {
+                    view->forEach(add);
+                } else {
+                    lock_guard<mutex> guard(lock);
+                    db.forEach(add);
+                }
+                seen += patients + (serials == 0);
+                scans++;
+            }
+        });
+        while (mode >= 2 && !scanning.load())
+            this_thread::yield();   // the writer starts with a scan under way
+
+        long long longest = 0;
+        long long cpu = threadNanos();
+        auto start = steady_clock::now();
+        auto last = start;
+        for (int i = 0; i < changes; i++) {
+            if (mode == 3) lock.lock();
+            db.remove(Patient(names[i], MINID + i % serials));
+            db.insert(Patient(fresh[i], MINID + i % serials));
+            if (mode == 3) lock.unlock();
+            auto now = steady_clock::now();
+            longest = max<long long>(longest, duration_cast<nanoseconds>(now - last).count());
+            last = now;
+        }
+        auto stop = steady_clock::now();
+        cpu = threadNanos() - cpu;
+        writing = false;
+        reader.join();
+        const char* labels[] = {"none", "snapshot, no scan", "snapshot scans", "locked live scans"};
+        printf("%-19s  %14.1f  %15.1f  %11.1f  %5d  %12d\n", labels[mode], (double)cpu / changes,
+               nsPerOp(start, stop, changes), longest / 1e3, scans.load(), view ? view->pagesCopied() : 0);
+        if (mode == 2 && seen != (long long)count * scans)
+            cout << "  warning: a snapshot scan saw " << seen << " patients over " << scans << " scans" << endl;
+        if (db.capacity() != cap)
+            cout << "  warning: the table was rehashed during the run" << endl;
+    }
+}
+
+/**
+ * Name: benchBatch
+ * Desc: Random lookups and a mixed update/remove/insert stream on a table far larger than the
+ *       cache, one call per operation against runBatch in batches of the sizes a pipelining
+ *       server collects, under each policy.
+ */
+void benchBatch() {
+    cout << "== batch: single calls against runBatch ==" << endl;
+    const int count = 2000000;
+    const int serials = MAXID - MINID + 1;
+    vector<string> names = makeNames(count);
+    mt19937 rng(9);
+    vector<TraceEntry> gets(count), mixed(count);
+    for (int i = 0; i < count; i++) {
+        int pick = rng() % count;
+        gets[i] = {TRACEGET, false, names[pick], MINID + pick % serials, 0};
+        pick = rng() % count;
+        trace_t op = (i % 3 == 0) ? TRACEUPDATE : (i % 3 == 1) ? TRACEREMOVE : TRACEINSERT;
+        mixed[i] = {op, false, names[pick], MINID + pick % serials, MINID + pick % serials};
+    }
+    cout << "policy      batch   get(ns)  mixed(ns)" << endl;
+    const char* policies[] = {"QUADRATIC", "DOUBLEHASH", "LINEAR", "ROBINHOOD", "CUCKOO"};
+    for (prob_t policy : {DOUBLEHASH, ROBINHOOD, CUCKOO}) {
+        for (int batch : {1, 16, 64, 256}) {
+            VacDB db(4 * count, hashCode, policy);
+            for (int i = 0; i < count; i++)
+                db.insert(Patient(names[i], MINID + i % serials));
+            long long found = 0;
+            vector<TraceEntry> ops;
+            auto run = [&](vector<TraceEntry>& source) {
+                for (int i = 0; i < count; i += batch) {
+                    if (batch == 1) {
+                        found += applyTraceEntry(db, source[i]);
+                        continue;
+                    }
+                    ops.assign(source.begin() + i, source.begin() + min(count, i + batch));
+                    db.runBatch(ops);
+                    for (const TraceEntry& op : ops)
+                        found += op.outcome;
+                }
+            };
+            auto start = steady_clock::now();
+            run(gets);
+            auto middle = steady_clock::now();
+            run(mixed);
+            auto stop = steady_clock::now();
+            printf("%-10s  %5d  %8.1f  %9.1f\n", policies[policy], batch,
+                   nsPerOp(start, middle, count), nsPerOp(middle, stop, count));
+            if (found == 0)
+                cout << "  warning: nothing found" << endl;
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    struct { const char* name; void (*run)(); } benchmarks[] = {
+        {"probing", benchProbing},
+        {"tail", benchTail},
+        {"booking", benchBooking},
+        {"prefix", benchPrefix},
+        {"fuzzy", benchFuzzy},
+        {"export", benchExport},
+        {"serials", benchSerials},
+        {"filter", benchFilter},
+        {"memory", benchMemory},
+        {"iterate", benchIterate},
+        {"trace", benchTrace},
+        {"generic", benchGeneric},
+        {"campaign", benchCampaign},
+        {"freeze", benchFreeze},
+        {"hugepages", benchHugePages},
+        {"stream", benchStream},
+        {"snapshot", benchSnapshot},
+        {"batch", benchBatch},
+    };
+    for (const auto& bench : benchmarks) {
+        if (argc < 2 || strcmp(argv[1], bench.name) == 0)
+            bench.run();
+    }
+    return 0;
+}
@@ -1,5 +1,7 @@
 // CMSC 341 - Spring 2024 - Project 4
 #include "vacdb.h"
+#include "frozendb.h"
+#include "snapshot.h"
 
 /**
  * Name: Constructor
@@ -10,8 +12,10 @@
  *                 If the specified size is not within the valid range, it is adjusted to the nearest prime number within the range.
  */
 VacDB::VacDB(int size, hash_fn hash, prob_t probing)
-    : m_hash(hash), m_currProbing(probing), m_currentTable(nullptr),
-      m_currentCap(0), m_currentSize(0), m_currNumDeleted(0),
+    : m_hash(hash), m_newPolicy(probing), m_currentTable(nullptr),
+      m_currentCap(0), m_stashCap(CUCKOOSTASH), m_currentSize(0), m_currNumDeleted(0),
+      m_currProbing(probing), m_currentDist(nullptr), m_maxLoad(0), m_slots(nullptr), m_serials(nullptr),
+      m_prefix(nullptr), m_fuzzy(nullptr), m_filter(nullptr), m_trace(nullptr), m_stream(nullptr), m_wheel(nullptr), m_pages(DEFPAGES),
       m_oldTable(nullptr), m_oldCap(0), m_oldSize(0), m_oldNumDeleted(0),
       m_transferIndex(0) {
 
@@ -26,10 +30,10 @@ VacDB::VacDB(int size, hash_fn hash, prob_t probing)
         m_currentCap = size;
     }
 
-    // Allocate memory for the hash table
-    m_currentTable = new Patient*[m_currentCap];
-    for (int i = 0; i < m_currentCap; i++) {
-        m_currentTable[i] = nullptr;
+    // Allocate memory for the hash table and the stash that follows it
+    m_currentTable = allocateTable(m_currentCap);
+    if (m_currProbing == ROBINHOOD || m_currProbing == CUCKOO) {
+        m_currentDist = allocateDist(m_currentCap);
     }
 }
 
@@ -43,12 +47,25 @@ VacDB::VacDB(int size, hash_fn hash, prob_t probing)
  * Postconditions: All memory allocated to the hash table and its elements is freed, and the table is left in an unusable state.
  */
 VacDB::~VacDB() {
-    for (int i = 0; i < m_currentCap; ++i) {
+    detachSnapshot();   // a snapshot still held keeps its patients
+    for (int i = 0; i < m_currentCap + m_stashCap; ++i) {
         delete m_currentTable[i];
         m_currentTable[i] = nullptr;
     }
-    delete[] m_currentTable;
+    freePages(m_currentTable);
     m_currentTable = nullptr;
+    freePages(m_currentDist);
+    m_currentDist = nullptr;
+    delete m_prefix;
+    m_prefix = nullptr;
+    delete m_fuzzy;
+    m_fuzzy = nullptr;
+    delete m_filter;
+    m_filter = nullptr;
+    delete m_wheel;
+    m_wheel = nullptr;
+    stopTrace();
+    stopStream();
 
     if (m_oldTable) {
         for (int i = 0; i < m_oldCap; ++i) {
@@ -63,103 +80,706 @@ VacDB::~VacDB() {
 
 /**
  * Name: changeProbPolicy
- * Desc: Changes the probing policy of the hash table and triggers a rehash to apply the new policy.
+ * Desc: Requests a change of the probing policy. The new policy is applied by the next rehash,
+ *       since all entries of a table must be placed with the same policy.
  * Preconditions: The hash table is initialized and the provided policy is a valid prob_t enumeration value.
- * Postconditions: The probing policy is updated and a rehash is performed if necessary.
+ * Postconditions: The requested policy is stored and takes effect on the next rehash.
  */
 void VacDB::changeProbPolicy(prob_t policy) {
     // Store the new policy in m_newPolicy
     m_newPolicy = policy;
+    logChange(TRACEPOLICY, "", 0, policy, true);
 
     //rehash(); // Ensure that the rehash function uses m_newPolicy for the new table
 }
 
 
+/**
+ * Name: setPagePolicy
+ * Desc: Stores the allocation policy of the bucket arrays and moves the current table and its
+ *       probe distances into arrays allocated with it, so a large table can switch without a
+ *       rehash. Later rehashes allocate with it as well.
+ * Preconditions: None.
+ * Postconditions: The entries keep their buckets. tablePages tells which backing was obtained.
+ */
+void VacDB::setPagePolicy(const PagePolicy& policy) {
+    m_pages = policy;
+    detachSnapshot();
+    Patient** table = allocateTable(m_currentCap, m_stashCap);
+    copy(m_currentTable, m_currentTable + m_currentCap + m_stashCap, table);
+    freePages(m_currentTable);
+    m_currentTable = table;
+    if (m_currentDist != nullptr) {
+        int* dist = allocateDist(m_currentCap);
+        copy(m_currentDist, m_currentDist + m_currentCap, dist);
+        freePages(m_currentDist);
+        m_currentDist = dist;
+    }
+}
+
+
+// empty buckets of a table of cap buckets and stash slots, under the page policy
+Patient** VacDB::allocateTable(int cap, int stash) const {
+    Patient** table = (Patient**)allocatePages((cap + stash) * sizeof(Patient*), m_pages);
+    if (table == nullptr)
+        throw bad_alloc();
+    return table;
+}
+
+
+// zero probe distances of a ROBINHOOD table, or stash counts of a CUCKOO table,
+// of cap buckets under the page policy
+int* VacDB::allocateDist(int cap) const {
+    int* dist = (int*)allocatePages(cap * sizeof(int), m_pages);
+    if (dist == nullptr)
+        throw bad_alloc();
+    return dist;
+}
+
+
+/**
+ * Name: setSlotBook
+ * Desc: Attaches the slot book that holds the appointments of the stored patients.
+ * Preconditions: book outlives the VacDB, or is detached by passing nullptr.
+ * Postconditions: bookSlot books in the slot book and remove releases slots in it.
+ */
+void VacDB::setSlotBook(SlotBook* book) {
+    m_slots = book;
+}
+
+
+/**
+ * Name: setSerialAllocator
+ * Desc: Attaches a serial allocator and reserves the serials of the live entries. When two stored
+ *       patients share a serial, the second reservation fails and the serial stays reserved once.
+ * Preconditions: serials outlives the table or is detached with nullptr first.
+ * Postconditions: Serial checks go through the allocator. nullptr restores the MINID..MAXID check.
+ */
+void VacDB::setSerialAllocator(SerialAllocator* serials) {
+    m_serials = serials;
+    if (m_serials == nullptr) return;
+    for (int i = 0; i < m_currentCap + m_stashCap; i++) {
+        if (m_currentTable[i] != nullptr && m_currentTable[i]->getUsed())
+            m_serials->reserve(m_currentTable[i]->getSerial());
+    }
+}
+
+
+/**
+ * Name: admit
+ * Desc: Takes the next free serial from the allocator and inserts the patient with it. The
+ *       serial is released again if the insert fails.
+ * Preconditions: None.
+ * Postconditions: Returns the serial of the new patient, or NOSERIAL if nothing was inserted.
+ */
+int VacDB::admit(string name) {
+    if (m_serials == nullptr) return NOSERIAL;
+    int serial = m_serials->allocate();
+    if (serial == NOSERIAL) return NOSERIAL;
+    m_serials->release(serial);     // insert reserves it again
+    return insert(Patient(name, serial)) ? serial : NOSERIAL;
+}
+
+
+/**
+ * Name: bookSlot
+ * Desc: Books an appointment for a stored patient: the first slot with room at a station at or
+ *       after (day, time). The patient is found by name and serial like getPatient, so the
+ *       appointment never goes to another patient of the same name. The slot the patient held
+ *       before is released once the new one is booked.
+ * Preconditions: A slot book is attached.
+ * Postconditions: Returns the new slot id, or NOSLOT if the patient is not stored or there is no room.
+ */
+int VacDB::bookSlot(string name, int serial, int day, int station, int time) {
+    int index = findIndex(name, serial);
+    if (m_slots == nullptr || index == -1) {
+        return NOSLOT;
+    }
+    int slot = m_slots->book(day, station, time);
+    if (slot != NOSLOT) {
+        touch(index);
+        if (m_currentTable[index]->getSlot() != NOSLOT)
+            m_slots->cancel(m_currentTable[index]->getSlot());
+        m_currentTable[index]->setSlot(slot);
+        publishEffect(TRACEBOOK, name, serial, slot);
+    }
+    return slot;
+}
+
+
+/**
+ * Name: enablePrefixIndex
+ * Desc: Turns the prefix index on or off. Turning it on indexes every live entry in O(n log n),
+ *       after that insert, remove and updateSerialNumber keep it current in O(log n).
+ * Preconditions: None.
+ * Postconditions: prefixSearch answers from the index while it is on.
+ */
+void VacDB::enablePrefixIndex(bool on) {
+    if (!on) {
+        delete m_prefix;
+        m_prefix = nullptr;
+    } else if (m_prefix == nullptr) {
+        m_prefix = new PrefixIndex();
+        for (int i = 0; i < m_currentCap + m_stashCap; i++) {
+            if (m_currentTable[i] != nullptr && m_currentTable[i]->getUsed())
+                m_prefix->add(m_currentTable[i]);
+        }
+    }
+}
+
+
+/**
+ * Name: prefixSearch
+ * Desc: Returns up to k patients whose name starts with prefix, in name order, for the
+ *       operator lookup screens.
+ * Preconditions: The prefix index is enabled.
+ * Postconditions: Returns the matching patients, or an empty vector if the index is off.
+ */
+vector<Patient> VacDB::prefixSearch(const string& prefix, int k) const {
+    vector<Patient> result;
+    if (m_prefix != nullptr) {
+        for (const Patient* patient : m_prefix->search(prefix, k))
+            result.push_back(*patient);
+    }
+    return result;
+}
+
+
+/**
+ * Name: enableExpiry
+ * Desc: Creates a TimingWheel at tick now and schedules the deadlines the stored patients already
+ *       carry, or drops the wheel. Dropping it keeps the deadlines, they only stop being acted on.
+ *       The call is traced with its tick, so a replay runs the wheel from the same tick.
+ * Preconditions: now is not negative.
+ * Postconditions: While enabled, expire removes patients whose deadline has passed.
+ */
+void VacDB::enableExpiry(bool on, long long now) {
+    enableExpiryEntry(on, now);
+    logChange(TRACEWHEEL, "", on, now, true);
+}
+
+
+// the body of enableExpiry
+void VacDB::enableExpiryEntry(bool on, long long now) {
+    delete m_wheel;
+    m_wheel = nullptr;
+    if (on) {
+        m_wheel = new TimingWheel(now);
+        forEach([this](const Patient& patient) {
+            if (patient.m_expires != NOEXPIRY)
+                m_wheel->schedule(patient.m_name, patient.m_serial, patient.m_expires);
+        });
+    }
+}
+
+
+/**
+ * Name: setExpiry
+ * Desc: Stores the deadline on the patient and schedules a timer for it. A timer scheduled for an
+ *       earlier deadline is not cancelled, expire skips it because the deadlines differ.
+ * Preconditions: when is NOEXPIRY or a tick, ticks are in the unit passed to expire.
+ * Postconditions: Returns true if the deadline was set.
+ */
+bool VacDB::setExpiry(string name, int serial, long long when) {
+    bool done = setExpiryEntry(name, serial, when);
+    logChange(TRACEDEADLINE, name, serial, when, done);
+    return done;
+}
+
+
+// the body of setExpiry
+bool VacDB::setExpiryEntry(const string& name, int serial, long long when) {
+    int index = (m_wheel != nullptr) ? findIndex(name, serial) : -1;
+    if (index == -1) {
+        return false;
+    }
+    touch(index);
+    m_currentTable[index]->m_expires = when;
+    if (when != NOEXPIRY)
+        m_wheel->schedule(name, serial, when);
+    return true;
+}
+
+
+/**
+ * Name: expire
+ * Desc: Advances the wheel to now and takes at most budget due timers. A timer removes its patient
+ *       when the patient is still stored under that serial with that deadline; timers of removed,
+ *       reserialed or rescheduled patients are dropped. Removals leave deleted buckets, which are
+ *       compacted away once they pass EXPIRYCOMPACT per live entry, well before the deleted
+ *       ratio would double the table. Meant to be called off the request path, for example once
+ *       per tick; patients past their deadline stay visible until it runs.
+ * Preconditions: now is not lower than the now of the previous call.
+ * Postconditions: Returns the number of patients removed. Due timers beyond budget wait for
+ *                 the next call.
+ */
+int VacDB::expire(long long now, int budget) {
+    int removed = 0;
+    if (m_wheel != nullptr) {
+        m_wheel->advance(now);
+        ExpiryTimer timer;
+        for (int taken = 0; taken < budget && m_wheel->popDue(timer); taken++) {
+            int index = findIndex(timer.name, timer.serial);
+            if (index != -1 && m_currentTable[index]->m_expires == timer.when) {
+                eraseAt(index);
+                publishEffect(TRACEREMOVE, timer.name, timer.serial, 0);
+                removed++;
+            }
+        }
+        if (m_currNumDeleted > 0 && m_currNumDeleted > EXPIRYCOMPACT * m_currentSize) {
+            compact();
+        }
+    }
+    logChange(TRACEEXPIRE, "", budget, now, removed > 0);
+    return removed;
+}
+
+
+/**
+ * Name: startTrace
+ * Desc: Starts recording every insert, remove, getPatient, updateSerialNumber and
+ *       changeProbPolicy call with its outcome, after an OPEN record with the capacity and
+ *       policy and a SEED record for each stored patient, so a replay starts from the same
+ *       contents. A running trace is stopped first.
+ * Preconditions: fd is open for writing and stays open until stopTrace.
+ * Postconditions: Records are buffered and written in large chunks.
+ */
+void VacDB::startTrace(int fd) {
+    stopTrace();
+    m_trace = new TraceLog(fd);
+    recordContents([this](trace_t op, const string& name, int serial, long long arg) {
+        m_trace->record(op, name, serial, arg, true);
+    });
+}
+
+
+// passes an OPEN record, the load override and a WHEEL record at the current tick if they
+// are set, then a SEED record with the slot and the deadline of every stored patient, to sink
+template <class Sink>
+void VacDB::recordContents(Sink sink) const {
+    sink(TRACEOPEN, "", m_currentCap, m_currProbing);
+    if (m_maxLoad > 0)
+        sink(TRACEMAXLOAD, "", 0, loadBits(m_maxLoad));
+    if (m_wheel != nullptr)
+        sink(TRACEWHEEL, "", 1, m_wheel->now());
+    forEach([this, &sink](const Patient& patient) {
+        sink(TRACESEED, patient.m_name, patient.m_serial, patient.m_slot);
+        if (m_wheel != nullptr && patient.m_expires != NOEXPIRY)
+            sink(TRACEDEADLINE, patient.m_name, patient.m_serial, patient.m_expires);
+    });
+}
+
+
+/**
+ * Name: stopTrace
+ * Desc: Flushes and drops the trace.
+ * Preconditions: None.
+ * Postconditions: Returns false if a trace write failed.
+ */
+bool VacDB::stopTrace() {
+    if (m_trace == nullptr) return true;
+    bool written = m_trace->flush();
+    delete m_trace;
+    m_trace = nullptr;
+    return written;
+}
+
+
+/**
+ * Name: startStream
+ * Desc: Opens a change stream in the shared memory segment /name for a standby process,
+ *       which then sees the current contents as OPEN and SEED records followed by every
+ *       insert, remove, updateSerialNumber, changeProbPolicy, enableExpiry, setMaxLoad,
+ *       setExpiry and expire call with its outcome, and the effects applyChange needs:
+ *       slot bookings and the patients expire removed. Lookups and rehashes are not streamed. A running stream is stopped first.
+ *       The standby can attach only once this returns, so the ring is made bytes larger than
+ *       the seed and a table of any size reaches it whole.
+ * Preconditions: None.
+ * Postconditions: Returns false if the segment cannot be created.
+ */
+bool VacDB::startStream(const string& name, size_t bytes) {
+    stopStream();
+    size_t seed = 0;
+    recordContents([&seed](trace_t, const string& name, int, long long) {
+        seed += sizeof(TraceRecord) + min<size_t>(name.size(), UINT16_MAX);
+    });
+    m_stream = new ChangeStream();
+    if (!m_stream->open(name, seed + bytes)) {
+        stopStream();
+        return false;
+    }
+    recordContents([this](trace_t op, const string& name, int serial, long long arg) {
+        m_stream->publish(op, name, serial, arg, true);
+    });
+    return true;
+}
+
+
+// closes the stream, the standby drains what was published and sees it closed
+void VacDB::stopStream() {
+    delete m_stream;
+    m_stream = nullptr;
+}
+
+
+/**
+ * Name: applyChange
+ * Desc: Applies a record of a primary's change stream by its effect rather than by running the call
+ *       again, so the copy follows the primary even where the call would decide differently here:
+ *       - records whose call failed on the primary changed nothing and are skipped,
+ *       - SEED and INSERT place the patient without the serial checks, the primary's allocator
+ *         range already accepted the serial, and SEED brings the patient's slot along,
+ *       - REMOVE and UPDATE act on the exact (name, serial) the primary changed,
+ *       - BOOK gives the patient the slot the primary booked, taking it in an attached SlotBook,
+ *       - EXPIRE only advances the wheel and drops the timers the primary took, the patients it
+ *         removed come as REMOVE records before it,
+ *       - POLICY, WHEEL, MAXLOAD and DEADLINE set what the call set.
+ *       OPEN, GET and REHASH records change nothing.
+ * Preconditions: The copy was created from the OPEN record and has applied every record since.
+ * Postconditions: Returns false if the record names a patient the copy does not hold, or could not
+ *                 place one; the copy has then diverged and has to be seeded again.
+ */
+bool VacDB::applyChange(const TraceEntry& change) {
+    if (!change.outcome) {
+        return true;
+    }
+    int index;
+    int serial = change.serial;
+    switch (change.op) {
+        case TRACESEED:
+        case TRACEINSERT:
+            if (findIndex(change.name, change.serial) != -1 || !placeEntry(Patient(change.name, change.serial))) {
+                return false;
+            }
+            if (change.op == TRACESEED && change.arg != NOSLOT) {
+                index = findIndex(change.name, change.serial);
+                if (m_slots != nullptr) m_slots->bookSlot((int)change.arg);
+                m_currentTable[index]->setSlot((int)change.arg);
+            }
+            return true;
+        case TRACEREMOVE:
+            return removeEntry(change.name, serial);
+        case TRACEUPDATE:
+            return updateEntry(change.name, serial, (int)change.arg);
+        case TRACEBOOK:
+            index = findIndex(change.name, change.serial);
+            if (index == -1) {
+                return false;
+            }
+            touch(index);
+            if (m_slots != nullptr) {
+                if (m_currentTable[index]->getSlot() != NOSLOT)
+                    m_slots->cancel(m_currentTable[index]->getSlot());
+                m_slots->bookSlot((int)change.arg);
+            }
+            m_currentTable[index]->setSlot((int)change.arg);
+            return true;
+        case TRACEEXPIRE:
+            if (m_wheel != nullptr) {
+                m_wheel->advance(change.arg);
+                ExpiryTimer timer;
+                for (int taken = 0; taken < change.serial && m_wheel->popDue(timer); taken++) {}
+            }
+            if (m_currNumDeleted > 0 && m_currNumDeleted > EXPIRYCOMPACT * m_currentSize) {
+                compact();
+            }
+            return true;
+        case TRACEPOLICY:
+            m_newPolicy = (prob_t)change.arg;
+            return true;
+        case TRACEWHEEL:
+            enableExpiryEntry(change.serial != 0, change.arg);
+            return true;
+        case TRACEMAXLOAD:
+            m_maxLoad = bitsLoad(change.arg);
+            return true;
+        case TRACEDEADLINE:
+            return setExpiryEntry(change.name, change.serial, change.arg);
+        default:
+            return true;
+    }
+}
+
+
+/**
+ * Name: enableFilter
+ * Desc: Creates a NameFilter and fills it with the stored names, or drops it.
+ * Preconditions: None.
+ * Postconditions: While enabled, lookups of names the filter rejects return without probing.
+ */
+void VacDB::enableFilter(bool on) {
+    if (!on) {
+        delete m_filter;
+        m_filter = nullptr;
+    } else if (m_filter == nullptr) {
+        rebuildFilter();
+    }
+}
+
+
+/**
+ * Name: rebuildFilter
+ * Desc: Replaces the filter with one sized for the most names the table holds before its next
+ *       rehash, so the false positive rate holds as the table grows. rehash() calls it after
+ *       moving the entries.
+ * Preconditions: None.
+ * Postconditions: The filter holds the name of every live entry once per entry.
+ */
+void VacDB::rebuildFilter() {
+    delete m_filter;
+    m_filter = new NameFilter((int)(m_currentCap * maxLoad()) + 1);
+    for (int i = 0; i < m_currentCap + m_stashCap; i++) {
+        if (m_currentTable[i] != nullptr && m_currentTable[i]->getUsed())
+            m_filter->add(m_currentTable[i]->getKey());
+    }
+}
+
+
+/**
+ * Name: enableFuzzyIndex
+ * Desc: Turns the fuzzy name index on or off. Turning it on indexes every live entry,
+ *       after that insert and remove keep it current.
+ * Preconditions: None.
+ * Postconditions: fuzzySearch answers from the index while it is on.
+ */
+void VacDB::enableFuzzyIndex(bool on) {
+    if (!on) {
+        delete m_fuzzy;
+        m_fuzzy = nullptr;
+    } else if (m_fuzzy == nullptr) {
+        m_fuzzy = new FuzzyIndex();
+        for (int i = 0; i < m_currentCap + m_stashCap; i++) {
+            if (m_currentTable[i] != nullptr && m_currentTable[i]->getUsed())
+                m_fuzzy->add(m_currentTable[i]);
+        }
+    }
+}
+
+
+/**
+ * Name: fuzzySearch
+ * Desc: Finds misspelled names at check-in: returns up to k patients whose name is within
+ *       maxEdits insertions, deletions or substitutions of name, ignoring case, closest first.
+ * Preconditions: The fuzzy index is enabled.
+ * Postconditions: Returns the matching patients, or an empty vector if the index is off.
+ */
+vector<Patient> VacDB::fuzzySearch(const string& name, int maxEdits, int k) const {
+    vector<Patient> result;
+    if (m_fuzzy != nullptr) {
+        for (const FuzzyMatch& match : m_fuzzy->search(name, maxEdits, k))
+            result.push_back(*match.patient);
+    }
+    return result;
+}
+
+
+/**
+ * Name: setMaxLoad
+ * Desc: Overrides the load factor that triggers a rehash. Passing 0 restores the default of the
+ *       current policy (MAXLOAD, or RHMAXLOAD for ROBINHOOD).
+ * Preconditions: load is 0 or in the range (0, 1). QUADRATIC may refuse inserts above 0.5.
+ * Postconditions: Subsequent inserts rehash once lambda() exceeds the new threshold.
+ */
+void VacDB::setMaxLoad(float load) {
+    bool done = (load >= 0 && load < 1);
+    if (done)
+        m_maxLoad = load;
+    logChange(TRACEMAXLOAD, "", 0, loadBits(load), done);
+}
+
+
 
 /**
  * Name: insert
  * Desc: Attempts to insert a new patient into the hash table. If the patient already exists, or the serial number is out of the valid range, the insertion will fail.
+ *       Under ROBINHOOD the new entry displaces residents that are closer to their home bucket.
  * Preconditions: The hash table is initialized. The patient's serial number must be within the defined valid range.
  * Postconditions: If successful, the patient is added to the hash table. If the table reaches a high load factor or has too many deleted entries, a rehash may be triggered.
  */
 bool VacDB::insert(Patient patient) {
-    if (patient.getSerial() < MINID || patient.getSerial() > MAXID) {
+    bool done = insertEntry(patient);
+    logChange(TRACEINSERT, patient.getKey(), patient.getSerial(), 0, done);
+    return done;
+}
+
+
+// the body of insert
+bool VacDB::insertEntry(Patient patient) {
+    if (m_serials != nullptr) {
+        if (!m_serials->contains(patient.getSerial()) || m_serials->inUse(patient.getSerial())) {
+            return false;  // Serial number out of range or taken
+        }
+    } else if (patient.getSerial() < MINID || patient.getSerial() > MAXID) {
         return false;  // Serial number out of range
     }
 
     // Check for existing patient to avoid duplicates
-    if (getPatient(patient.getKey(), patient.getSerial()).getUsed()) {
+    bool known = (m_filter == nullptr || m_filter->mayContain(patient.getKey()));
+    if (known && findIndex(patient.getKey(), patient.getSerial()) != -1) {
         return false;  // Patient already exists
     }
+    return placeEntry(patient);
+}
+
 
-    unsigned int bucket = m_hash(patient.getKey()) % m_currentCap;
-    unsigned int step = 0;
-    unsigned int index;
+// stores a patient that passed the checks of insert
+bool VacDB::placeEntry(Patient patient) {
+    unsigned int hash = m_hash(patient.getKey());
+    Patient* stored = nullptr;  // the entry that now holds the patient
 
-    while (step < m_currentCap) {
-        index = bucket;  // Start with the initial hash index
-        if (m_currProbing == DOUBLEHASH) {
-            index = (bucket + step * (11 - (m_hash(patient.getKey()) % 11))) % m_currentCap;
-        } else if (m_currProbing == QUADRATIC) {
-            index = (bucket + step * step) % m_currentCap;
-        } else if (m_currProbing == LINEAR) {
-            index = (bucket + step) % m_currentCap;
+    if (m_currProbing == ROBINHOOD) {
+        // there are no tombstones, so a full table has no free bucket
+        if (m_currentSize < m_currentCap) {
+            patient.setUsed(true);
+            stored = new Patient(patient);
+            robinHoodPlace(stored, hash, m_currentTable, m_currentDist, m_currentCap);
         }
+    } else if (m_currProbing == CUCKOO) {
+        stored = new Patient(patient);
+        stored->setUsed(true);
+        cuckooPlace(stored, m_currentTable, m_currentDist, m_currentCap, m_stashCap);
+    } else {
+        for (int step = 0; step < m_currentCap && stored == nullptr; step++) {
+            unsigned int index = probeIndex(hash, step, m_currProbing, m_currentCap);
 
-        // Check if the bucket is empty or marked as deleted
-        if (m_currentTable[index] == nullptr || !m_currentTable[index]->getUsed()) {
-            if (m_currentTable[index] == nullptr) {
-                m_currentTable[index] = new Patient();  // Allocate new if it was nullptr
-            }
-            *m_currentTable[index] = patient;  // Copy assignment
-            m_currentTable[index]->setUsed(true);
-            m_currentSize++;
-            // Check if rehashing is needed
-            if (lambda() > 0.5 || deletedRatio() > 0.8) {
-                rehash();  // Implement the rehash function separately
+            // Check if the bucket is empty or marked as deleted
+            if (m_currentTable[index] == nullptr || !m_currentTable[index]->getUsed()) {
+                touch(index);
+                if (m_currentTable[index] == nullptr) {
+                    m_currentTable[index] = new Patient();  // Allocate new if it was nullptr
+                } else {
+                    m_currNumDeleted--;  // reusing a deleted bucket
+                }
+                stored = m_currentTable[index];
+                *stored = patient;  // Copy assignment
+                stored->setUsed(true);
             }
-            return true;
         }
-        step++;
     }
-    return false;  // Table full
+
+    if (stored == nullptr) {
+        return false;  // Table full
+    }
+    stored->m_expires = NOEXPIRY;  // deadlines are only set through setExpiry
+    stored->m_slot = NOSLOT;       // and appointments through bookSlot
+    m_currentSize++;
+    if (m_serials != nullptr) {
+        m_serials->reserve(stored->getSerial());
+    }
+    if (m_prefix != nullptr) {
+        m_prefix->add(stored);
+    }
+    if (m_fuzzy != nullptr) {
+        m_fuzzy->add(stored);
+    }
+    if (m_filter != nullptr) {
+        m_filter->add(stored->getKey());
+    }
+    // Check if rehashing is needed
+    if (lambda() > maxLoad() || deletedRatio() > MAXDELRATIO) {
+        rehash();
+    }
+    return true;
 }
 
 
 /**
  * Name: rehash
  * Desc: Performs rehashing of the hash table to a new table with double the current prime capacity.
+ *       The new table uses the policy requested through changeProbPolicy, and deleted entries are released.
  *       This method is typically called automatically when load factor or deleted item thresholds are exceeded.
  * Preconditions: The hash table is initialized and needs resizing due to load factors or deletion thresholds.
  * Postconditions: The hash table's capacity is increased, and all existing, non-deleted entries are transferred to the new table.
  */
 void VacDB::rehash() {
-    int newSize = findNextPrime(m_currentCap * 2);
-    Patient** newTable = new Patient*[newSize] {};
-    int newTableSize = 0;
-
-    for (int i = 0; i < m_currentCap; i++) {
-        if (m_currentTable[i] != nullptr && m_currentTable[i]->getUsed()) {
-            unsigned int bucket = m_hash(m_currentTable[i]->getKey()) % newSize;
-            unsigned int step = 0;
-            unsigned int index;
-
-            while (step < newSize) {
-                index = (bucket + step * (11 - (m_hash(m_currentTable[i]->getKey()) % 11))) % newSize;
-                if (newTable[index] == nullptr) {
-                    newTable[index] = m_currentTable[i];
-                    newTableSize++;
+    resize(findNextPrime(m_currentCap * 2));
+}
+
+
+/**
+ * Name: compact
+ * Desc: Rebuilds the table without its deleted entries at the smallest prime capacity that puts
+ *       the live entries at half the rehash load, so a table emptied by expiry shrinks back
+ *       instead of doubling on the deleted ratio. The table never grows here.
+ * Preconditions: None.
+ * Postconditions: m_currNumDeleted is 0 and the capacity is at most the previous one.
+ */
+void VacDB::compact() {
+    int newSize = findNextPrime((int)min<double>(MAXPRIME, 2.0 * m_currentSize / maxLoad()));
+    resize(min(newSize, m_currentCap));
+}
+
+
+/**
+ * Name: resize
+ * Desc: Moves the live entries into a new table of the given capacity under the policy requested
+ *       through changeProbPolicy. Every policy places every entry, CUCKOO grows the stash of the
+ *       new table instead of the table, so a crowded name never doubles the capacity.
+ * Preconditions: cap is a prime in the range [MINPRIME, MAXPRIME].
+ * Postconditions: Deleted entries are released and the attached filter is rebuilt.
+ */
+void VacDB::resize(int cap) {
+    prob_t newPolicy = m_newPolicy;
+    Patient** newTable = nullptr;
+    int* newDist = nullptr;
+    int newStash = CUCKOOSTASH;
+    detachSnapshot();   // the old table and its deleted entries are freed below
+    rebuild(cap, newPolicy, newTable, newDist, newStash);
+
+    freePages(m_currentTable);  // Free old table
+    freePages(m_currentDist);
+    m_currentTable = newTable;
+    m_currentDist = newDist;
+    m_currentCap = cap;
+    m_stashCap = newStash;
+    m_currNumDeleted = 0;
+    m_currProbing = newPolicy;
+    if (m_filter != nullptr) {
+        rebuildFilter();
+    }
+    if (m_trace != nullptr) {
+        m_trace->record(TRACEREHASH, "", m_currentCap, m_currProbing, true);
+    }
+}
+
+
+/**
+ * Name: rebuild
+ * Desc: Allocates a table of the given capacity and policy and moves every live entry of the
+ *       current table into it. Deleted entries are released once the new table is complete.
+ * Preconditions: cap is a prime in the range [MINPRIME, MAXPRIME] and stash is CUCKOOSTASH.
+ * Postconditions: The new arrays are returned through table and dist, and the stash slots of the
+ *                 new table through stash. The current table is untouched apart from the
+ *                 released deleted entries.
+ */
+void VacDB::rebuild(int cap, prob_t policy, Patient**& table, int*& dist, int& stash) {
+    table = allocateTable(cap, stash);
+    dist = (policy == ROBINHOOD || policy == CUCKOO) ? allocateDist(cap) : nullptr;
+
+    for (int i = 0; i < m_currentCap + m_stashCap; i++) {
+        Patient* entry = m_currentTable[i];
+        if (entry == nullptr || !entry->getUsed()) continue;
+        unsigned int hash = m_hash(entry->getKey());
+        if (policy == ROBINHOOD) {
+            robinHoodPlace(entry, hash, table, dist, cap);
+        } else if (policy == CUCKOO) {
+            cuckooPlace(entry, table, dist, cap, stash);
+        } else {
+            for (int step = 0; step < cap; step++) {
+                unsigned int index = probeIndex(hash, step, policy, cap);
+                if (table[index] == nullptr) {
+                    table[index] = entry;
                     break;
                 }
-                step++;
             }
         }
     }
 
-    delete[] m_currentTable;  // Free old table
-    m_currentTable = newTable;
-    m_currentCap = newSize;
-    m_currentSize = newTableSize;
+    // deleted entries do not survive a rehash
+    for (int i = 0; i < m_currentCap + m_stashCap; i++) {
+        if (m_currentTable[i] != nullptr && !m_currentTable[i]->getUsed())
+            delete m_currentTable[i];
+    }
 }
 
 
@@ -169,24 +789,88 @@ void VacDB::rehash() {
 /**
  * Name: remove
  * Desc: Attempts to remove a specified patient from the hash table based on their key.
+ *       Under ROBINHOOD the entry is erased and its followers are shifted back instead of leaving a deleted bucket,
+ *       under CUCKOO the slot is simply freed.
  * Preconditions: The hash table is initialized and contains at least one entry.
- * Postconditions: If the patient is found, they are marked as not used. The method returns true if successful, false otherwise.
+ * Postconditions: If the patient is found, they are marked as not used and their slot in the attached SlotBook is released.
+ *                 The method returns true if successful, false otherwise.
  */
 bool VacDB::remove(Patient patient) {
-    unsigned int index = m_hash(patient.getKey()) % m_currentCap;
-    unsigned int step = 0;
-    while (step < m_currentCap) {
-        int probeIndex = (index + step * (11 - (m_hash(patient.getKey()) % 11))) % m_currentCap;
-        Patient* entry = m_currentTable[probeIndex];
-        if (entry != nullptr && entry->getUsed() && entry->getKey() == patient.getKey()) {
-            entry->setUsed(false); // Mark the entry as not used
-            m_currNumDeleted++;    // Increment the count of deleted entries
-            m_currentSize--;       // Decrement the current size
-            return true;
+    int serial = 0;
+    bool done = removeEntry(patient.getKey(), serial);
+    logChange(TRACEREMOVE, patient.getKey(), done ? serial : patient.getSerial(), 0, done);
+    return done;
+}
+
+
+/**
+ * Name: remove
+ * Desc: Removes the patient with that name and serial, the way remove(Patient) removes one of the name.
+ * Preconditions: None.
+ * Postconditions: Returns true if the patient was stored and is removed.
+ */
+bool VacDB::remove(string name, int serial) {
+    int removed = serial;
+    bool done = removeEntry(name, removed);
+    logChange(TRACEREMOVE, name, removed, 0, done);
+    return done;
+}
+
+
+bool VacDB::removeEntry(const string& name, int& serial) {
+    if (m_filter != nullptr && !m_filter->mayContain(name)) {
+        return false;
+    }
+    int index = findIndex(name, serial);
+    if (index == -1) {
+        return false;
+    }
+    serial = m_currentTable[index]->getSerial();
+    eraseAt(index);
+    return true;
+}
+
+
+/**
+ * Name: eraseAt
+ * Desc: Removes the live entry of a bucket: its appointment, serial and index entries are released
+ *       and the bucket is marked deleted, or freed under ROBINHOOD and CUCKOO.
+ * Preconditions: index holds a live entry of the current table, stash included.
+ * Postconditions: m_currentSize is one lower.
+ */
+void VacDB::eraseAt(int index) {
+    touch(index);
+    if (m_slots != nullptr && m_currentTable[index]->getSlot() != NOSLOT) {
+        m_slots->cancel(m_currentTable[index]->getSlot());  // the appointment is cancelled
+        m_currentTable[index]->setSlot(NOSLOT);
+    }
+    if (m_serials != nullptr) {
+        m_serials->release(m_currentTable[index]->getSerial());
+    }
+    if (m_prefix != nullptr) {
+        m_prefix->remove(m_currentTable[index]);
+    }
+    if (m_fuzzy != nullptr) {
+        m_fuzzy->remove(m_currentTable[index]);
+    }
+    if (m_filter != nullptr) {
+        m_filter->remove(m_currentTable[index]->m_name);
+    }
+    if (m_currProbing == ROBINHOOD) {
+        robinHoodErase(index);
+    } else if (m_currProbing == CUCKOO) {
+        if (index >= m_currentCap) {
+            int first, second;
+            cuckooBuckets(m_currentTable[index]->m_name, m_currentCap, first, second);
+            m_currentDist[first]--;  // one stashed entry fewer to look for
         }
-        step++;
+        delete m_currentTable[index];  // no probe sequence passes through the slot
+        m_currentTable[index] = nullptr;
+    } else {
+        m_currentTable[index]->setUsed(false); // Mark the entry as not used
+        m_currNumDeleted++;    // Increment the count of deleted entries
     }
-    return false;
+    m_currentSize--;       // Decrement the current size
 }
 
 
@@ -198,11 +882,15 @@ bool VacDB::remove(Patient patient) {
  * Postconditions: Returns the patient if found. If no matching patient is found, returns an empty Patient object.
  */
 const Patient VacDB::getPatient(string name, int serial) const {
-    for (int i = 0; i < m_currentCap; i++) {
-        Patient* entry = m_currentTable[i];
-        if (entry != nullptr && entry->getUsed() && entry->getKey() == name && entry->getSerial() == serial) {
-            return *entry;
-        }
+    int index = -1;
+    if (m_filter == nullptr || m_filter->mayContain(name)) {
+        index = findIndex(name, serial);
+    }
+    if (m_trace != nullptr) {
+        m_trace->record(TRACEGET, name, serial, 0, index != -1);
+    }
+    if (index != -1) {
+        return *m_currentTable[index];
     }
     return Patient(); // Return an empty patient if not found
 }
@@ -215,18 +903,109 @@ const Patient VacDB::getPatient(string name, int serial) const {
  * Postconditions: If the patient is found, their serial number is updated. Returns true if successful, false otherwise.
  */
 bool VacDB::updateSerialNumber(Patient patient, int serial) {
-    unsigned int index = m_hash(patient.getKey()) % m_currentCap;
-    unsigned int step = 0;
-    while (step < m_currentCap) {
-        int probeIndex = (index + step * (11 - (m_hash(patient.getKey()) % 11))) % m_currentCap;
-        Patient* entry = m_currentTable[probeIndex];
-        if (entry != nullptr && entry->getUsed() && entry->getKey() == patient.getKey()) {
-            entry->setSerial(serial);
+    int updated = 0;
+    bool done = updateEntry(patient.getKey(), updated, serial);
+    logChange(TRACEUPDATE, patient.getKey(), done ? updated : patient.getSerial(), serial, done);
+    return done;
+}
+
+
+/**
+ * Name: updateSerialNumber
+ * Desc: Gives the patient with that name and serial a new serial number.
+ * Preconditions: None.
+ * Postconditions: Returns true if the patient was found and the new serial was accepted.
+ */
+bool VacDB::updateSerialNumber(string name, int serial, int newSerial) {
+    int updated = serial;
+    bool done = updateEntry(name, updated, newSerial);
+    logChange(TRACEUPDATE, name, updated, newSerial, done);
+    return done;
+}
+
+
+bool VacDB::updateEntry(const string& name, int& serial, int newSerial) {
+    if (m_filter != nullptr && !m_filter->mayContain(name)) {
+        return false;
+    }
+    int index = findIndex(name, serial);
+    if (index == -1) {
+        return false;
+    }
+    serial = m_currentTable[index]->getSerial();
+    if (m_serials != nullptr) {
+        if (newSerial == serial) {
             return true;
         }
-        step++;
+        if (!m_serials->reserve(newSerial)) {
+            return false;  // out of range or held by another patient
+        }
+        m_serials->release(serial);
+    }
+    // the prefix index is ordered by serial within a name
+    if (m_prefix != nullptr) {
+        m_prefix->remove(m_currentTable[index]);
+    }
+    touch(index);
+    m_currentTable[index]->setSerial(newSerial);
+    if (m_prefix != nullptr) {
+        m_prefix->add(m_currentTable[index]);
+    }
+    // the timer under the old serial goes stale
+    if (m_wheel != nullptr && m_currentTable[index]->m_expires != NOEXPIRY) {
+        m_wheel->schedule(m_currentTable[index]->m_name, newSerial, m_currentTable[index]->m_expires);
+    }
+    return true;
+}
+
+
+/**
+ * Name: runBatch
+ * Desc: Runs a batch of operations in order through insert, remove, getPatient and
+ *       updateSerialNumber, so they are traced and streamed like single calls. The home buckets
+ *       of the whole batch are computed first. While operation i runs, the bucket pointer of
+ *       operation i + 2 * BATCHPREFETCH and the patient in the bucket of operation
+ *       i + BATCHPREFETCH are prefetched, so the two dependent cache misses of a lookup overlap
+ *       with the work of the operations before it. A rehash inside the batch only makes the
+ *       later hints miss.
+ * Preconditions: None.
+ * Postconditions: Every entry holds the outcome of its operation, in the order given.
+ */
+void VacDB::runBatch(vector<TraceEntry>& ops) {
+    const size_t count = ops.size();
+    vector<int> homes(count);
+    for (size_t i = 0; i < count; i++)
+        homes[i] = homeIndex(ops[i].name);
+    for (size_t i = 0; i < count; i++) {
+        if (i + 2 * BATCHPREFETCH < count && homes[i + 2 * BATCHPREFETCH] < m_currentCap)
+            __builtin_prefetch(&m_currentTable[homes[i + 2 * BATCHPREFETCH]]);
+        if (i + BATCHPREFETCH < count && homes[i + BATCHPREFETCH] < m_currentCap) {
+            const Patient* resident = m_currentTable[homes[i + BATCHPREFETCH]];
+            if (resident != nullptr)
+                __builtin_prefetch(resident);
+        }
+        TraceEntry& op = ops[i];
+        switch (op.op) {
+            case TRACEINSERT:
+                op.outcome = insert(Patient(op.name, op.serial));
+                break;
+            case TRACEREMOVE:
+                op.outcome = remove(op.name, op.serial);
+                break;
+            case TRACEUPDATE:
+                op.outcome = updateSerialNumber(op.name, op.serial, (int)op.arg);
+                break;
+            case TRACEGET: {
+                Patient patient = getPatient(op.name, op.serial);
+                op.outcome = !patient.getKey().empty();
+                if (op.outcome)
+                    op.serial = patient.getSerial();
+                break;
+            }
+            default:
+                op.outcome = false;
+        }
     }
-    return false;
 }
 
 
@@ -251,17 +1030,133 @@ float VacDB::deletedRatio() const {
     return float(m_currNumDeleted) / float(m_currentSize);
 }
 
+/**
+ * Name: freeze
+ * Desc: Builds a FrozenVacDB of the live patients.
+ * Preconditions: None.
+ * Postconditions: Returns the snapshot; later changes to the table do not reach it.
+ */
+FrozenVacDB VacDB::freeze() const {
+    return FrozenVacDB(*this);
+}
+
+
+/**
+ * Name: snapshot
+ * Desc: Starts a copy-on-write view of the current table. Only the page states are allocated,
+ *       every write after this saves the page of the bucket it changes the first time. A
+ *       snapshot taken earlier and still held is copied in full and detached first.
+ * Preconditions: The table is changed only by the calling thread while the view is held.
+ * Postconditions: Returns the view of the live patients as they are now.
+ */
+VacSnapshot VacDB::snapshot() {
+    detachSnapshot();
+    m_snapshot = make_shared<SnapshotState>(m_currentTable, m_currentCap + m_stashCap, m_currentSize);
+    return VacSnapshot(m_snapshot);
+}
+
+
+// saves the page of a slot, or drops the state once its handle is gone
+void VacDB::preserveSlot(int index) {
+    if (!m_snapshot->preserve(index))
+        m_snapshot.reset();
+}
+
+
+/**
+ * Name: detachSnapshot
+ * Desc: Copies the pages of a held snapshot the writer has not copied yet, then stops tracking it.
+ *       Called before the bucket array is replaced or freed.
+ * Preconditions: None.
+ * Postconditions: m_snapshot is nullptr and the view no longer reads the table.
+ */
+void VacDB::detachSnapshot() {
+    if (m_snapshot != nullptr && !m_snapshot->released())
+        m_snapshot->preserveAll();
+    m_snapshot.reset();
+}
+
+
+/**
+ * Name: exportText
+ * Desc: Streams the live entries of the current table, stash included, and of the old table
+ *       as text lines through one ExportWriter, so a large table costs a few writes instead of
+ *       a flush per slot. Empty and deleted slots are skipped.
+ * Preconditions: fd is open for writing.
+ * Postconditions: Returns the number of bytes written, or -1 if a write failed.
+ */
+long long VacDB::exportText(int fd) const {
+    ExportWriter writer(fd);
+    forEach([&writer](const Patient& patient) {
+        writer.writeText(patient.m_name, patient.m_serial, patient.m_slot);
+    });
+    writer.flush();
+    return writer.bytes();
+}
+
+
+/**
+ * Name: exportBinary
+ * Desc: Streams an ExportHeader and one ExportRecord per live entry of both tables. Long names
+ *       are gathered from the entries by writev instead of being copied.
+ * Preconditions: fd is open for writing.
+ * Postconditions: Returns the number of bytes written, or -1 if a write failed.
+ */
+long long VacDB::exportBinary(int fd) const {
+    ExportWriter writer(fd);
+    writer.writeHeader();
+    forEach([&writer](const Patient& patient) {
+        writer.writeBinary(patient.m_name, patient.m_serial, patient.m_slot);
+    });
+    writer.flush();
+    return writer.bytes();
+}
+
+
+/**
+ * Name: const_iterator::skip
+ * Desc: Moves the iterator forward to the next live patient, or to the end.
+ * Preconditions: None.
+ * Postconditions: The iterator is at a live patient or equals end().
+ */
+void VacDB::const_iterator::skip() {
+    const int slots = m_db->slotCount();
+    while (m_slot < slots) {
+        const Patient* entry = m_db->slotAt(m_slot);
+        if (entry != nullptr && entry->m_used) return;
+        m_slot++;
+    }
+}
+
+
+/**
+ * Name: threadCount
+ * Desc: Picks the number of threads of a parallel walk: the request, or every core for 0,
+ *       capped so that each thread gets at least MINSLOTSPERTHREAD slots.
+ * Preconditions: None.
+ * Postconditions: Returns at least 1.
+ */
+int VacDB::threadCount(int threads) const {
+    if (threads <= 0)
+        threads = (int)thread::hardware_concurrency();
+    threads = min(threads, slotCount() / MINSLOTSPERTHREAD);
+    return max(threads, 1);
+}
+
+
 void VacDB::dump() const {
-    cout << "Dump for the current table: " << endl;
+    // '\n' instead of endl, a flush per slot made large dumps crawl
+    cout << "Dump for the current table: " << '\n';
     if (m_currentTable != nullptr)
-        for (int i = 0; i < m_currentCap; i++) {
-            cout << "[" << i << "] : " << m_currentTable[i] << endl;
+        for (int i = 0; i < m_currentCap + m_stashCap; i++) {
+            cout << "[" << i << "] : " << m_currentTable[i] << '\n';
         }
-    cout << "Dump for the old table: " << endl;
+    cout << "Dump for the old table: " << '\n';
     if (m_oldTable != nullptr)
         for (int i = 0; i < m_oldCap; i++) {
-            cout << "[" << i << "] : " << m_oldTable[i] << endl;
+            cout << "[" << i << "] : " << m_oldTable[i] << '\n';
         }
+    cout << flush;
 }
 
 /**
@@ -272,7 +1167,7 @@ void VacDB::dump() const {
  */
 bool VacDB::isPrime(int number){
     bool result = true;
-    for (int i = 2; i <= number / 2; ++i) {
+    for (int i = 2; i <= number / i; ++i) {
         if (number % i == 0) {
             result = false;
             break;
@@ -347,27 +1242,315 @@ int VacDB::getCurrentSize() const {
 /**
  * Name: findIndex
  * Desc: Returns the index of the bucket where the specified key is stored, if it exists.
+ *       A serial of 0 matches any serial number. The probe stops at the first empty bucket, and
+ *       under ROBINHOOD also as soon as the probe has travelled further than the resident of the bucket.
+ *       Under CUCKOO only the two candidate buckets are searched, and the stash when entries whose
+ *       first bucket is the key's were stashed; a stash hit returns an index of m_currentCap or above.
  * Preconditions: The key is a valid string.
  * Postconditions: Returns the index of the bucket containing the key, or -1 if the key is not found.
  */
-int VacDB::findIndex(const string& key) const {
-    unsigned int hashValue = m_hash(key);
-    unsigned int index;
-
-    for (unsigned int step = 0; step < m_currentCap; ++step) {
-        if (m_currProbing == DOUBLEHASH) {
-            index = (hashValue + step * (11 - (m_hash(key) % 11))) % m_currentCap;
-        } else if (m_currProbing == QUADRATIC) {
-            index = (hashValue + step * step) % m_currentCap;
-        } else if (m_currProbing == LINEAR) {
-            index = (hashValue + step) % m_currentCap;
+int VacDB::findIndex(const string& key, int serial) const {
+    if (m_currProbing == CUCKOO) {
+        // two buckets, a fixed number of slots whatever the load
+        int first, second;
+        cuckooBuckets(key, m_currentCap, first, second);
+        int slots[2 * CUCKOOSLOTS];
+        for (int s = 0; s < CUCKOOSLOTS; s++) {
+            slots[s] = first * CUCKOOSLOTS + s;
+            slots[CUCKOOSLOTS + s] = second * CUCKOOSLOTS + s;
+        }
+        for (int index : slots) {
+            const Patient* entry = m_currentTable[index];
+            if (entry != nullptr && entry->m_name == key && (serial == 0 || entry->m_serial == serial))
+                return index;
+        }
+        // the stash only when something that starts at this bucket overflowed into it
+        if (m_currentDist[first] > 0) {
+            for (int index = m_currentCap; index < m_currentCap + m_stashCap; index++) {
+                const Patient* entry = m_currentTable[index];
+                if (entry != nullptr && entry->m_name == key && (serial == 0 || entry->m_serial == serial))
+                    return index;
+            }
         }
+        return -1;
+    }
+
+    unsigned int hashValue = m_hash(key);
 
-        if (m_currentTable[index] == nullptr) {
+    for (int step = 0; step < m_currentCap; ++step) {
+        unsigned int index = probeIndex(hashValue, step, m_currProbing, m_currentCap);
+        const Patient* entry = m_currentTable[index];
+
+        if (entry == nullptr) {
             return -1;  // Key is not present.
-        } else if (m_currentTable[index]->getUsed() && m_currentTable[index]->getKey() == key) {
+        } else if (m_currProbing == ROBINHOOD && m_currentDist[index] < step) {
+            return -1;  // The key would have displaced this resident.
+        } else if (entry->m_used && entry->m_name == key && (serial == 0 || entry->m_serial == serial)) {
             return index;  // Key found.
         }
     }
     return -1;  // Key not found after full probe.
 }
+
+
+int VacDB::homeIndex(const string& key) const {
+    if (m_currProbing == CUCKOO) {
+        int first, second;
+        cuckooBuckets(key, m_currentCap, first, second);
+        return first * CUCKOOSLOTS;
+    }
+    return (int)probeIndex(m_hash(key), 0, m_currProbing, m_currentCap);
+}
+
+
+/**
+ * Name: probeIndex
+ * Desc: Returns the bucket visited at a given step of the probe sequence of a hash value.
+ *       LINEAR and ROBINHOOD walk consecutive buckets, QUADRATIC adds step^2 and DOUBLEHASH
+ *       adds step times a second hash in the range [1, 11]. ROBINHOOD starts from the mixed
+ *       hash, see mixHash.
+ * Preconditions: cap is the capacity of the table being probed.
+ * Postconditions: Returns an index in the range [0, cap).
+ */
+unsigned int VacDB::probeIndex(unsigned int hash, int step, prob_t policy, int cap) const {
+    unsigned long long offset = step;
+    if (policy == ROBINHOOD) {
+        hash = mixHash(hash);
+    }
+    if (policy == DOUBLEHASH) {
+        offset = offset * (11 - (hash % 11));
+    } else if (policy == QUADRATIC) {
+        offset = offset * offset;
+    }
+    return (unsigned int)((hash % cap + offset) % cap);
+}
+
+
+/**
+ * Name: mixHash
+ * Desc: Scrambles the bits of a hash value (MurmurHash3 finalizer). Hashes such as the
+ *       textbook 33-multiplier give consecutive values to names that differ in their last
+ *       letter, and consecutive home buckets merge into long clusters under linear probing.
+ * Preconditions: None.
+ * Postconditions: Returns the mixed value; equal hashes still mix to equal values.
+ */
+unsigned int VacDB::mixHash(unsigned int hash) {
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35u;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+
+/**
+ * Name: maxLoad
+ * Desc: Returns the load factor that triggers a rehash for the current table.
+ * Preconditions: None.
+ * Postconditions: Returns the override set through setMaxLoad, or the default of the current policy.
+ */
+float VacDB::maxLoad() const {
+    if (m_maxLoad > 0)
+        return m_maxLoad;
+    if (m_currProbing == ROBINHOOD)
+        return RHMAXLOAD;
+    if (m_currProbing == CUCKOO)
+        return CKMAXLOAD;
+    return MAXLOAD;
+}
+
+
+/**
+ * Name: robinHoodPlace
+ * Desc: Places an entry with Robin Hood linear probing. Walking from the home bucket, the carried
+ *       entry swaps with any resident that is closer to its own home, and the displaced resident
+ *       continues the walk. This keeps the variance of probe distances small.
+ * Preconditions: table has at least one empty bucket and dist holds the probe distances of table.
+ * Postconditions: The entry, and every resident it displaced, occupies a bucket with its distance recorded.
+ */
+void VacDB::robinHoodPlace(Patient* patient, unsigned int hash, Patient** table, int* dist, int cap) {
+    int index = mixHash(hash) % cap;
+    int distance = 0;
+    while (table[index] != nullptr) {
+        if (dist[index] < distance) {
+            touch(index);
+            std::swap(patient, table[index]);
+            std::swap(distance, dist[index]);
+        }
+        index = (index + 1 == cap) ? 0 : index + 1;
+        distance++;
+    }
+    touch(index);
+    table[index] = patient;
+    dist[index] = distance;
+}
+
+
+/**
+ * Name: robinHoodErase
+ * Desc: Erases the entry of a bucket under ROBINHOOD with backward shift deletion. The following
+ *       entries of the cluster move one bucket closer to their home, so no deleted buckets are left.
+ * Preconditions: The current policy is ROBINHOOD and index holds a live entry.
+ * Postconditions: The entry is freed and the cluster is compacted.
+ */
+void VacDB::robinHoodErase(int index) {
+    delete m_currentTable[index];
+    int next = (index + 1 == m_currentCap) ? 0 : index + 1;
+    while (m_currentTable[next] != nullptr && m_currentDist[next] > 0) {
+        touch(next);
+        m_currentTable[index] = m_currentTable[next];
+        m_currentDist[index] = m_currentDist[next] - 1;
+        index = next;
+        next = (next + 1 == m_currentCap) ? 0 : next + 1;
+    }
+    m_currentTable[index] = nullptr;
+    m_currentDist[index] = 0;
+}
+
+
+/**
+ * Name: memoryUsage
+ * Desc: Computes the memory held by the hash table: the bucket array, the probe distances, the
+ *       Patient objects and any name that does not fit in the string's inline buffer.
+ * Preconditions: The hash table is initialized.
+ * Postconditions: Returns the total in bytes.
+ */
+size_t VacDB::memoryUsage() const {
+    const size_t inlineCap = string().capacity();
+    size_t bytes = sizeof(VacDB) + (m_currentCap + m_stashCap) * sizeof(Patient*);
+    if (m_currentDist != nullptr)
+        bytes += m_currentCap * sizeof(int);
+    if (m_filter != nullptr)
+        bytes += sizeof(NameFilter) + m_filter->memoryUsage();
+    for (int i = 0; i < m_currentCap + m_stashCap; i++) {
+        if (m_currentTable[i] != nullptr) {
+            bytes += sizeof(Patient);
+            if (m_currentTable[i]->m_name.capacity() > inlineCap)
+                bytes += m_currentTable[i]->m_name.capacity() + 1;
+        }
+    }
+    return bytes;
+}
+
+
+/**
+ * Name: altHash
+ * Desc: Second hash of a key for CUCKOO (32-bit FNV-1a). It does not depend on the user hash
+ *       function, so keys that collide under m_hash still get independent second buckets.
+ * Preconditions: None.
+ * Postconditions: Returns the hash value.
+ */
+unsigned int VacDB::altHash(const string& key) {
+    unsigned int val = 2166136261u;
+    for (unsigned char c : key) {
+        val = (val ^ c) * 16777619u;
+    }
+    return val;
+}
+
+
+/**
+ * Name: cuckooBuckets
+ * Desc: Computes the two candidate buckets of a key in a CUCKOO table of the given capacity.
+ *       The table holds cap / CUCKOOSLOTS buckets of CUCKOOSLOTS consecutive slots.
+ * Preconditions: cap is at least 2 * CUCKOOSLOTS.
+ * Postconditions: first and second hold two distinct bucket numbers.
+ */
+void VacDB::cuckooBuckets(const string& key, int cap, int& first, int& second) const {
+    int buckets = cap / CUCKOOSLOTS;
+    first = m_hash(key) % buckets;
+    second = altHash(key) % buckets;
+    if (second == first) {
+        second = (first + 1) % buckets;
+    }
+}
+
+
+/**
+ * Name: cuckooPlace
+ * Desc: Places an entry in one of its two CUCKOO buckets. When both are full a resident is evicted
+ *       to its alternate bucket, for at most CUCKOOKICKS evictions. If that path fails, the evictions
+ *       are undone in reverse order and the entry goes to the stash, which is doubled when it is
+ *       full. Patients sharing a name share both buckets, so when the two buckets hold nothing
+ *       but that name the evictions are skipped: they could only swap the name between them.
+ * Preconditions: table has cap buckets followed by stash slots, stashed holds its stash counts.
+ * Postconditions: The entry is placed. If it went to the stash, the count of its first bucket is
+ *                 one higher; table and stash change if the stash had to grow.
+ */
+void VacDB::cuckooPlace(Patient* patient, Patient**& table, int* stashed, int cap, int& stash) {
+    int path[CUCKOOKICKS];
+    int length = 0;
+    int from = -1;  // bucket the carried entry was evicted from
+    Patient* carry = patient;
+    int home[2];
+    cuckooBuckets(patient->m_name, cap, home[0], home[1]);
+
+    int crowded = 0;    // slots of the two buckets held by the same name
+    for (int bucket : home) {
+        for (int s = 0; s < CUCKOOSLOTS; s++) {
+            const Patient* entry = table[bucket * CUCKOOSLOTS + s];
+            crowded += (entry != nullptr && entry->m_name == patient->m_name);
+        }
+    }
+    const int kicks = (crowded == 2 * CUCKOOSLOTS) ? 0 : CUCKOOKICKS;
+
+    for (int kick = 0; kick <= kicks; kick++) {
+        int candidates[2];
+        cuckooBuckets(carry->m_name, cap, candidates[0], candidates[1]);
+        for (int bucket : candidates) {
+            for (int s = 0; s < CUCKOOSLOTS; s++) {
+                int index = bucket * CUCKOOSLOTS + s;
+                if (table[index] == nullptr) {
+                    touch(index);
+                    table[index] = carry;
+                    return;
+                }
+            }
+        }
+        if (kick == kicks) break;
+        // evict from the bucket the carried entry did not come from,
+        // rotating the victim slot so the walk does not cycle
+        int bucket = (candidates[0] == from) ? candidates[1]
+                   : (candidates[1] == from) ? candidates[0] : candidates[kick % 2];
+        int index = bucket * CUCKOOSLOTS + kick % CUCKOOSLOTS;
+        touch(index);
+        std::swap(carry, table[index]);
+        path[length++] = index;
+        from = bucket;
+    }
+
+    // undone, the entry carried is the one being placed again
+    while (length > 0) {
+        std::swap(carry, table[path[--length]]);
+    }
+    int slot = 0;
+    while (slot < stash && table[cap + slot] != nullptr) {
+        slot++;
+    }
+    if (slot == stash) {
+        growStash(table, cap, stash);
+    }
+    touch(cap + slot);
+    table[cap + slot] = carry;
+    stashed[home[0]]++;
+}
+
+
+/**
+ * Name: growStash
+ * Desc: Moves a table into an array with twice the stash slots. The buckets keep their positions.
+ *       A snapshot of the current table is detached first, since its array is freed.
+ * Preconditions: table has cap buckets followed by stash slots.
+ * Postconditions: table points to the new array and stash is doubled.
+ */
+void VacDB::growStash(Patient**& table, int cap, int& stash) {
+    if (&table == &m_currentTable) {
+        detachSnapshot();
+    }
+    Patient** grown = allocateTable(cap, 2 * stash);
+    copy(table, table + cap + stash, grown);
+    freePages(table);
+    table = grown;
+    stash *= 2;
+}
@@ -4,36 +4,73 @@
 #include <iostream>
 #include <string>
 #include "math.h"
+#include <vector>
+#include <iterator>
+#include <thread>
+#include <memory>
+#include <optional>
+#include "slotbook.h"
+#include "prefixindex.h"
+#include "fuzzyindex.h"
+#include "exportwriter.h"
+#include "serialallocator.h"
+#include "namefilter.h"
+#include "tracelog.h"
+#include "changestream.h"
+#include "timingwheel.h"
+#include "pagealloc.h"
 using namespace std;
 const int MINID = 1000;     // serial number
 const int MAXID = 9999;     // serial number
 const int MINPRIME = 101;   // Min size for hash table
-const int MAXPRIME = 99991; // Max size for hash table
+const int MAXPRIME = 100000007; // Max size for hash table
 typedef unsigned int (*hash_fn)(string); // declaration of hash function
-enum prob_t {QUADRATIC, DOUBLEHASH, LINEAR}; // types of collision handling policy
+enum prob_t {QUADRATIC, DOUBLEHASH, LINEAR, ROBINHOOD, CUCKOO}; // types of collision handling policy
 #define DEFPOLCY QUADRATIC
+const float MAXLOAD = 0.5;     // load factor that triggers a rehash
+const float RHMAXLOAD = 0.9;   // load factor that triggers a rehash under ROBINHOOD
+const float CKMAXLOAD = 0.9;   // load factor that triggers a rehash under CUCKOO
+const float MAXDELRATIO = 0.8; // deleted ratio that triggers a rehash
+const int CUCKOOSLOTS = 4;     // slots per CUCKOO bucket
+const int CUCKOOKICKS = 128;   // evictions tried before a CUCKOO insert gives up
+const int CUCKOOSTASH = 4;     // stash slots that follow the buckets of a new table
+const int MINSLOTSPERTHREAD = 1 << 14; // smallest share of slots worth a thread
+const float EXPIRYCOMPACT = 0.25;  // deleted entries per live one that make expire() compact
+const int EXPIRYBATCH = 4096;      // due patients one expire() call handles by default
+const int BATCHPREFETCH = 8;       // operations of a batch whose buckets are fetched ahead
 class Grader;
 class Tester;
 class VacDB;
+class FrozenVacDB;
+class VacSnapshot;
+class SnapshotState;
 class Patient{
     public:
     friend class Tester;
     friend class Grader;
     friend class VacDB;
-    Patient(string name="", int serial=0, bool used=false){
-        m_name = name; m_serial = serial; m_used = used;
+    friend class PrefixIndex;
+    friend class FuzzyIndex;
+    friend class FrozenVacDB;
+    Patient(string name="", int serial=0, bool used=false, int slot=NOSLOT){
+        m_name = name; m_serial = serial; m_used = used; m_slot = slot; m_expires = NOEXPIRY;
     }
     string getKey() const {return m_name;}
     int getSerial() const {return m_serial;}
     bool getUsed() const {return m_used;}
+    int getSlot() const {return m_slot;}
+    long long getExpiry() const {return m_expires;}
     void setKey(string key) {m_name=key;}
     void setSerial(int serial) {m_serial = serial;}
     void setUsed(bool used) {m_used=used;}
+    void setSlot(int slot) {m_slot = slot;}
     const Patient& operator=(const Patient& rhs){
         if (this != &rhs){
             m_name = rhs.m_name;
             m_serial = rhs.m_serial;
             m_used = rhs.m_used;
+            m_slot = rhs.m_slot;
+            m_expires = rhs.m_expires;
         }
         return *this;
     }
@@ -49,6 +86,8 @@ class Patient{
     // if it is set to false, it means the bucket in the hash table is free for insert
     // if it is set to true, it means the bucket contains live data, and we cannot overwrite it
     bool m_used;
+    int m_slot;     // appointment slot in the attached SlotBook, NOSLOT if none
+    long long m_expires;    // tick at which VacDB::expire removes the patient, NOEXPIRY if never
 };
 class VacDB{
     public:
@@ -62,25 +101,163 @@ class VacDB{
     float deletedRatio() const;
     // insert only happens in the new table
     bool insert(Patient patient);
-    // remove can happen from either table
+    // remove can happen from either table, removes a patient with that name
     bool remove(Patient patient);
+    // removes the patient with that name and serial, serial 0 matches any
+    bool remove(string name, int serial);
     // find can happen in either table
     const Patient getPatient(string name, int serial) const;
-    // update the information
+    // update the information of a patient with that name
     bool updateSerialNumber(Patient patient, int serial);
+    // gives the patient with that name and serial the serial newSerial
+    bool updateSerialNumber(string name, int serial, int newSerial);
+    // runs TRACEINSERT, TRACEREMOVE, TRACEGET and TRACEUPDATE entries in order,
+    // the way applyTraceEntry does, while the buckets of the entries ahead are
+    // fetched into the cache. Each outcome is stored in its entry and a
+    // TRACEGET hit gets the serial found; other entries get outcome false
+    void runBatch(vector<TraceEntry>& ops);
     void changeProbPolicy(prob_t policy);
+    // attaches a slot book, remove releases the slot held by the patient
+    void setSlotBook(SlotBook* book);
+    // books the first free slot at or after (day, time) at a station for the stored
+    // patient with that name and serial, releasing the slot the patient held before
+    // Returns the slot id or NOSLOT
+    int bookSlot(string name, int serial, int day, int station, int time);
+    // attaches a serial allocator, which then owns the valid serial range: insert
+    // and updateSerialNumber reject serials in use, remove releases them. The live
+    // serials already stored are reserved
+    void setSerialAllocator(SerialAllocator* serials);
+    // inserts a patient under the next free serial of the attached allocator
+    // Returns the serial, or NOSERIAL if there is no allocator, no free serial or no room
+    int admit(string name);
+    // keeps a NameFilter of the stored names, which lets getPatient, remove,
+    // updateSerialNumber and the duplicate check of insert skip the probe for
+    // most absent names
+    void enableFilter(bool on);
+    // keeps a TimingWheel of the patients' expiry ticks, starting at tick now.
+    // Deadlines set before are scheduled again when the wheel is created
+    void enableExpiry(bool on, long long now = 0);
+    bool expiryEnabled() const {return m_wheel != nullptr;}
+    // sets the tick at which the stored patient expires, NOEXPIRY clears it
+    // Returns false if expiry is off or the patient is not stored
+    bool setExpiry(string name, int serial, long long when);
+    // advances the wheel to now and removes up to budget expired patients,
+    // then compacts the table once deleted entries pass EXPIRYCOMPACT per live one
+    // Returns the number of patients removed
+    int expire(long long now, int budget = EXPIRYBATCH);
+    // records every operation and its outcome to fd, see tracelog.h
+    void startTrace(int fd);
+    // Returns false if writing the trace failed
+    bool stopTrace();
+    // publishes every change to a standby in the shared memory segment /name,
+    // see changestream.h; the ring gets bytes on top of the seed of the contents
+    // Returns false if the segment cannot be created
+    bool startStream(const string& name, size_t bytes = STREAMBYTES);
+    void stopStream();
+    // Returns true if the standby fell a whole ring behind and must be seeded again
+    bool streamLost() const {return m_stream != nullptr && m_stream->lost();}
+    // applies a record of a primary's change stream to this copy by its effect:
+    // changes that failed on the primary are skipped, inserts skip the serial
+    // checks, removes and updates act on the exact serial. Nothing is traced
+    // or streamed again
+    // Returns false if the change does not fit this copy, which has diverged
+    bool applyChange(const TraceEntry& change);
+    // maintains a name index next to the hash table for prefix searches
+    void enablePrefixIndex(bool on);
+    // Returns up to k patients whose name starts with prefix, in name order
+    vector<Patient> prefixSearch(const string& prefix, int k) const;
+    // maintains a trigram index of the names for typo-tolerant searches
+    void enableFuzzyIndex(bool on);
+    // Returns up to k patients within maxEdits edits of name, closest first
+    vector<Patient> fuzzySearch(const string& name, int maxEdits, int k) const;
+    // allocates the bucket arrays with huge pages or a NUMA placement, see
+    // pagealloc.h; the current table moves to the new arrays at once
+    void setPagePolicy(const PagePolicy& policy);
+    // Returns the backing the current bucket array got
+    page_t tablePages() const {return pageBacking(m_currentTable);}
+    // overrides the load factor that triggers a rehash, 0 restores the policy default
+    void setMaxLoad(float load);
+    // Returns the number of buckets of the current table
+    int capacity() const {return m_currentCap;}
+    // Returns the number of bytes used by the tables and the live entries
+    size_t memoryUsage() const;
+    // Returns a read-only snapshot of the live patients with a minimal perfect
+    // hash, see frozendb.h
+    FrozenVacDB freeze() const;
+    // Returns a consistent view of the live patients that other threads can
+    // scan while this one keeps writing, see snapshot.h
+    VacSnapshot snapshot();
+    // streams the live entries of both tables to fd, one "name<TAB>serial<TAB>slot"
+    // line each, Returns the number of bytes written or -1 on a write error
+    long long exportText(int fd) const;
+    // same as exportText with the binary records of exportwriter.h after an ExportHeader
+    long long exportBinary(int fd) const;
     void dump() const;
 
+    // Forward iterator over the live patients of the current table, stash
+    // included, then of the old table. Empty and deleted slots are skipped.
+    // Any insert, remove or rehash invalidates it.
+    class const_iterator{
+        public:
+        using iterator_category = forward_iterator_tag;
+        using value_type = Patient;
+        using difference_type = ptrdiff_t;
+        using pointer = const Patient*;
+        using reference = const Patient&;
+        const_iterator(const VacDB* db, int slot) : m_db(db), m_slot(slot) {skip();}
+        reference operator*() const {return *m_db->slotAt(m_slot);}
+        pointer operator->() const {return m_db->slotAt(m_slot);}
+        const_iterator& operator++() {m_slot++; skip(); return *this;}
+        const_iterator operator++(int) {const_iterator old = *this; ++*this; return old;}
+        bool operator==(const const_iterator& rhs) const {return m_slot == rhs.m_slot;}
+        bool operator!=(const const_iterator& rhs) const {return m_slot != rhs.m_slot;}
+        private:
+        const VacDB* m_db;
+        int m_slot;         // position over both tables, see slotAt
+        void skip();
+    };
+    const_iterator begin() const {return const_iterator(this, 0);}
+    const_iterator end() const {return const_iterator(this, slotCount());}
+    // calls f(const Patient&) for every live patient
+    template <class Fn> void forEach(Fn f) const;
+    // calls f(const Patient&) for every live patient, with the slots split
+    // into contiguous ranges over threads (0 for every core), f must be
+    // safe to call concurrently
+    template <class Fn> void parallelForEach(Fn f, int threads = 0) const;
+    // folds map(const Patient&) of every live patient into init with combine,
+    // which must be associative, one partial result per thread. init is
+    // folded in once, so it need not be the identity of combine
+    template <class T, class Map, class Combine>
+    T parallelReduce(T init, Map map, Combine combine, int threads = 0) const;
+
     private:
     hash_fn    m_hash;          // hash function
     prob_t     m_newPolicy;     // stores the change of policy request
 
-    Patient**  m_currentTable;  // hash table
+    Patient**  m_currentTable;  // hash table, m_currentCap buckets followed by
+                                // m_stashCap stash slots used by CUCKOO
     int        m_currentCap;    // hash table size (capacity)
+    int        m_stashCap;      // stash slots, CUCKOOSTASH until patients sharing
+                                // a name overflow their two CUCKOO buckets
     int        m_currentSize;   // current number of entries
                                 // m_currentSize includes deleted entries 
     int        m_currNumDeleted;// number of deleted entries
     prob_t     m_currProbing;   // collision handling policy
+    int*       m_currentDist;   // probe distance of every bucket under ROBINHOOD;
+                                // under CUCKOO the number of stashed entries whose
+                                // first bucket it is; nullptr under other policies
+    float      m_maxLoad;       // load factor override, 0 means policy default
+    SlotBook*  m_slots;         // appointment slots, not owned, may be nullptr
+    SerialAllocator* m_serials; // serials in use, not owned, may be nullptr
+    PrefixIndex* m_prefix;      // name index, nullptr unless enabled
+    FuzzyIndex* m_fuzzy;        // trigram index, nullptr unless enabled
+    NameFilter* m_filter;       // names of the live entries, nullptr unless enabled
+    TraceLog*  m_trace;         // operation trace, nullptr unless recording
+    ChangeStream* m_stream;     // change stream to a standby, nullptr unless streaming
+    TimingWheel* m_wheel;       // expiry timers, nullptr unless enabled
+    PagePolicy m_pages;         // allocation of m_currentTable and m_currentDist
+    shared_ptr<SnapshotState> m_snapshot; // pages of the snapshot taken last,
+                                // nullptr once it is released or detached
 
     Patient**  m_oldTable;      // hash table
     int        m_oldCap;        // hash table size (capacity)
@@ -100,8 +277,124 @@ class VacDB{
     * Private function declarations go here! *
     ******************************************/
    void rehash();
+   // records a change to the trace and publishes it to the standby
+   void logChange(trace_t op, const string& name, int serial, long long arg, bool outcome) {
+       if (m_trace != nullptr) m_trace->record(op, name, serial, arg, outcome);
+       if (m_stream != nullptr) m_stream->publish(op, name, serial, arg, outcome);
+   }
+   // publishes an effect only the standby needs, a replay recomputes it
+   void publishEffect(trace_t op, const string& name, int serial, long long arg) {
+       if (m_stream != nullptr) m_stream->publish(op, name, serial, arg, true);
+   }
+   template <class Sink> void recordContents(Sink sink) const;
+   // saves the page of a slot for the snapshot before the slot or its patient changes
+   void touch(int index) {if (m_snapshot != nullptr) preserveSlot(index);}
+   void preserveSlot(int index);
+   void detachSnapshot();
+   void resize(int cap);
+   void compact();
    int getCurrentSize() const;
-   int findIndex(const string& key) const;
+   // serial 0 matches any serial number
+   int findIndex(const string& key, int serial = 0) const;
+   // the first bucket a probe for key visits
+   int homeIndex(const string& key) const;
+   unsigned int probeIndex(unsigned int hash, int step, prob_t policy, int cap) const;
+   static unsigned int mixHash(unsigned int hash);
+   float maxLoad() const;
+   void robinHoodPlace(Patient* patient, unsigned int hash, Patient** table, int* dist, int cap);
+   void robinHoodErase(int index);
+   static unsigned int altHash(const string& key);
+   void cuckooBuckets(const string& key, int cap, int& first, int& second) const;
+   void cuckooPlace(Patient* patient, Patient**& table, int* stashed, int cap, int& stash);
+   void growStash(Patient**& table, int cap, int& stash);
+   void rebuild(int cap, prob_t policy, Patient**& table, int*& dist, int& stash);
+   Patient** allocateTable(int cap, int stash = CUCKOOSTASH) const;
+   int* allocateDist(int cap) const;
+   // slots of the current table, stash included, followed by those of the old table
+   int slotCount() const {return m_currentCap + m_stashCap + m_oldCap;}
+   const Patient* slotAt(int slot) const {
+       return (slot < m_currentCap + m_stashCap) ? m_currentTable[slot]
+                                                : m_oldTable[slot - m_currentCap - m_stashCap];
+   }
+   // calls f for the live patients of the slots [first, last)
+   template <class Fn> void visit(int first, int last, Fn& f) const;
+   int threadCount(int threads) const;
+   void rebuildFilter();
+   bool insertEntry(Patient patient);
+   bool placeEntry(Patient patient);
+   void enableExpiryEntry(bool on, long long now);
+   bool setExpiryEntry(const string& name, int serial, long long when);
+   // remove and update of the patient with that name and serial, serial 0 matches
+   // any and comes back as the serial of the patient changed, which is traced
+   bool removeEntry(const string& name, int& serial);
+   void eraseAt(int index);
+   bool updateEntry(const string& name, int& serial, int newSerial);
 
 };
+
+// Visits the live patients of a range of slots, one plain loop per table so
+// the walk is a sequential read of the slot arrays. Prefetching the entries
+// ahead was tried and measured slower, the loads are independent already.
+template <class Fn>
+void VacDB::visit(int first, int last, Fn& f) const {
+    const int current = m_currentCap + m_stashCap;
+    for (int slot = first; slot < last && slot < current; slot++) {
+        const Patient* entry = m_currentTable[slot];
+        if (entry != nullptr && entry->m_used)
+            f(*entry);
+    }
+    for (int slot = max(first, current); slot < last; slot++) {
+        const Patient* entry = m_oldTable[slot - current];
+        if (entry != nullptr && entry->m_used)
+            f(*entry);
+    }
+}
+
+template <class Fn>
+void VacDB::forEach(Fn f) const {
+    visit(0, slotCount(), f);
+}
+
+template <class Fn>
+void VacDB::parallelForEach(Fn f, int threads) const {
+    threads = threadCount(threads);
+    const int slots = slotCount();
+    vector<thread> workers;
+    for (int t = 1; t < threads; t++) {
+        workers.emplace_back([this, &f, t, threads, slots]() {
+            visit((long long)slots * t / threads, (long long)slots * (t + 1) / threads, f);
+        });
+    }
+    visit(0, slots / threads, f);
+    for (thread& worker : workers)
+        worker.join();
+}
+
+template <class T, class Map, class Combine>
+T VacDB::parallelReduce(T init, Map map, Combine combine, int threads) const {
+    threads = threadCount(threads);
+    const int slots = slotCount();
+    // a range without patients has no partial result
+    vector<optional<T>> partial(threads);
+    vector<thread> workers;
+    auto run = [&](int t) {
+        optional<T> local;
+        auto fold = [&](const Patient& patient) {
+            local = local ? combine(*local, map(patient)) : T(map(patient));
+        };
+        visit((long long)slots * t / threads, (long long)slots * (t + 1) / threads, fold);
+        partial[t] = move(local);
+    };
+    for (int t = 1; t < threads; t++)
+        workers.emplace_back(run, t);
+    run(0);
+    for (thread& worker : workers)
+        worker.join();
+    T result = init;
+    for (int t = 0; t < threads; t++) {
+        if (partial[t])
+            result = combine(result, *partial[t]);
+    }
+    return result;
+}
 #endif
\ No newline at end of file
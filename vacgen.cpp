@@ -0,0 +1,84 @@
+// CMSC 341 - Spring 2024 - Project 4
+// Synthetic workload generator: writes a trace for vacreplay, or runs the workload straight into a VacDB
+// build: g++ -std=c++17 -O2 -pthread vacdb.cpp slotbook.cpp prefixindex.cpp fuzzyindex.cpp exportwriter.cpp serialallocator.cpp namefilter.cpp tracelog.cpp timingwheel.cpp frozendb.cpp pagealloc.cpp changestream.cpp workload.cpp snapshot.cpp vacgen.cpp -o vacgen
+// usage: ./vacgen operations [seed] [threads] [insert:search:cancel] [zipf] [trace file]
+#include "vacdb.h"
+#include "workload.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+using namespace std::chrono;
+
+unsigned int hashCode(const string str) {
+   unsigned int val = 0 ;
+   const unsigned int thirtyThree = 33 ;  // magic number from textbook
+   for (unsigned int i = 0 ; i < str.length(); i++)
+      val = val * thirtyThree + str[i] ;
+   return val ;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "usage: " << argv[0] << " operations [seed] [threads] [insert:search:cancel] [zipf] [trace file]" << endl;
+        return 1;
+    }
+    WorkloadConfig config = DEFWORKLOAD;
+    config.operations = atoll(argv[1]);
+    if (argc > 2) config.seed = strtoull(argv[2], nullptr, 10);
+    int threads = (argc > 3) ? atoi(argv[3]) : 0;
+    if (argc > 4 && sscanf(argv[4], "%d:%d:%d", &config.insertShare, &config.searchShare, &config.cancelShare) != 3) {
+        cerr << "the mix is three weights such as 50:40:10" << endl;
+        return 1;
+    }
+    if (argc > 5) config.zipf = atof(argv[5]);
+    Workload workload(config);
+
+    long long counts[3] = {0, 0, 0};
+    long long failed = 0;
+    auto start = steady_clock::now();
+    if (argc > 6) {
+        // a trace with the generator's expectation as outcome, vacreplay counts where the table differs
+        int fd = open(argv[6], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd == -1) {
+            cerr << "cannot create " << argv[6] << endl;
+            return 1;
+        }
+        TraceLog trace(fd);
+        trace.record(TRACEOPEN, "", MINPRIME, DOUBLEHASH, true);
+        workload.run(threads, [&](const vector<TraceEntry>& ops) {
+            for (const TraceEntry& entry : ops) {
+                trace.record(entry.op, entry.name, entry.serial, entry.arg, entry.outcome);
+                counts[entry.op - TRACEINSERT]++;
+            }
+        });
+        bool written = trace.flush();
+        close(fd);
+        if (!written) {
+            cerr << "writing " << argv[6] << " failed" << endl;
+            return 1;
+        }
+    } else {
+        // each chunk runs as one batch, the outcomes it leaves are compared with the expectation
+        VacDB db(MINPRIME, hashCode, DOUBLEHASH);
+        vector<bool> expected;
+        workload.run(threads, [&](vector<TraceEntry>& ops) {
+            expected.resize(ops.size());
+            for (size_t i = 0; i < ops.size(); i++) {
+                expected[i] = ops[i].outcome;
+                counts[ops[i].op - TRACEINSERT]++;
+            }
+            db.runBatch(ops);
+            for (size_t i = 0; i < ops.size(); i++)
+                failed += (ops[i].outcome != expected[i]);
+        });
+        printf("table of %d buckets, %.1f MB\n", db.capacity(), db.memoryUsage() / 1e6);
+    }
+    double seconds = duration_cast<microseconds>(steady_clock::now() - start).count() / 1e6;
+    printf("%lld inserts, %lld searches, %lld cancels in %.2f s, %.2f M operations/s\n",
+           counts[0], counts[2], counts[1], seconds, config.operations / seconds / 1e6);
+    if (argc <= 6)
+        printf("%lld outcomes differ from the generator's expectation\n", failed);
+    return 0;
+}
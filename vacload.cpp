@@ -0,0 +1,180 @@
+// CMSC 341 - Spring 2024 - Project 4
+// Load generator for vacserver: pipelined clients, throughput and latency percentiles
+// build: g++ -std=c++17 -O2 protocol.cpp vacload.cpp -o vacload
+// usage: ./vacload [socket path | tcp port] [connections] [pipeline depth] [requests] [get percent]
+#include "protocol.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+using namespace std::chrono;
+
+const int MINSERIAL = 1000;     // serial range of the server's VacDB
+const int SERIALS = 9000;
+
+// one pipelined client connection
+struct Client{
+    int fd;
+    string out;                     // encoded requests not written yet
+    string in;                      // received bytes not decoded yet
+    deque<steady_clock::time_point> sent;
+};
+
+int connectTo(const string& where) {
+    int fd;
+    if (where.find_first_not_of("0123456789") == string::npos) {
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(atoi(where.c_str()));
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd != -1 && connect(fd, (sockaddr*)&address, sizeof(address)) == -1) {
+            close(fd);
+            return -1;
+        }
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    } else {
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, where.c_str(), sizeof(address.sun_path) - 1);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd != -1 && connect(fd, (sockaddr*)&address, sizeof(address)) == -1) {
+            close(fd);
+            return -1;
+        }
+    }
+    return fd;
+}
+
+string patientName(int i) {
+    static const char* given[] = {"john", "serina", "mike", "celina", "alexander", "jessica"};
+    return string(given[i % 6]) + " " + to_string(i);
+}
+
+/**
+ * Name: runPhase
+ * Desc: Keeps depth requests in flight on every connection until total requests are answered.
+ *       next(i) encodes the i-th request into a send buffer.
+ * Preconditions: The clients are connected.
+ * Postconditions: Returns the latency of every request in nanoseconds.
+ */
+template <class Next>
+vector<long long> runPhase(vector<Client>& clients, int depth, int total, Next next, int& failed) {
+    vector<long long> latencies;
+    latencies.reserve(total);
+    int issued = 0;
+    vector<pollfd> fds(clients.size());
+    while ((int)latencies.size() < total) {
+        for (size_t c = 0; c < clients.size(); c++) {
+            Client& client = clients[c];
+            while ((int)client.sent.size() < depth && issued < total) {
+                next(client.out, issued++);
+                client.sent.push_back(steady_clock::now());
+            }
+            fds[c] = {client.fd, (short)(POLLIN | (client.out.empty() ? 0 : POLLOUT)), 0};
+        }
+        if (::poll(fds.data(), fds.size(), 1000) <= 0) {
+            cerr << "server stopped answering" << endl;
+            exit(1);
+        }
+        char chunk[65536];
+        for (size_t c = 0; c < clients.size(); c++) {
+            Client& client = clients[c];
+            if (fds[c].revents & POLLOUT) {
+                ssize_t n = write(client.fd, client.out.data(), client.out.size());
+                if (n > 0) client.out.erase(0, n);
+            }
+            if (fds[c].revents & (POLLIN | POLLHUP | POLLERR)) {
+                ssize_t n = read(client.fd, chunk, sizeof(chunk));
+                if (n <= 0) {
+                    cerr << "connection lost" << endl;
+                    exit(1);
+                }
+                client.in.append(chunk, n);
+                size_t pos = 0;
+                Response response;
+                while (size_t used = decodeResponse(client.in.data() + pos, client.in.size() - pos, response)) {
+                    pos += used;
+                    auto now = steady_clock::now();
+                    latencies.push_back(duration_cast<nanoseconds>(now - client.sent.front()).count());
+                    client.sent.pop_front();
+                    failed += (response.status != STATUSOK);
+                }
+                client.in.erase(0, pos);
+            }
+        }
+    }
+    return latencies;
+}
+
+void report(const char* phase, vector<long long>& latencies, double seconds, int failed) {
+    sort(latencies.begin(), latencies.end());
+    auto at = [&](double q) {return latencies[min(latencies.size() - 1, (size_t)(q * latencies.size()))] / 1000.0;};
+    printf("%-6s %8zu requests  %9.0f req/s  p50 %7.1f us  p90 %7.1f us  p99 %7.1f us  p99.9 %7.1f us  (%d not ok)\n",
+           phase, latencies.size(), latencies.size() / seconds, at(0.5), at(0.9), at(0.99), at(0.999), failed);
+}
+
+int main(int argc, char* argv[]) {
+    string where = (argc > 1) ? argv[1] : SERVERSOCKET;
+    int connections = (argc > 2) ? atoi(argv[2]) : 4;
+    int depth = (argc > 3) ? atoi(argv[3]) : 32;
+    int total = (argc > 4) ? atoi(argv[4]) : 200000;
+    int getPercent = (argc > 5) ? atoi(argv[5]) : 80;
+    const int patients = min(total / 2, SERIALS * 50);
+
+    vector<Client> clients(connections);
+    for (Client& client : clients) {
+        client.fd = connectTo(where);
+        if (client.fd == -1) {
+            cerr << "cannot connect to " << where << endl;
+            return 1;
+        }
+    }
+    printf("%d connections, pipeline depth %d\n", connections, depth);
+
+    // registers the patients the mixed phase works on
+    int failed = 0;
+    auto start = steady_clock::now();
+    vector<long long> latencies = runPhase(clients, depth, patients, [](string& out, int i) {
+        encodeRequest(out, OPINSERT, patientName(i), MINSERIAL + i % SERIALS);
+    }, failed);
+    report("insert", latencies, duration_cast<nanoseconds>(steady_clock::now() - start).count() / 1e9, failed);
+
+    // lookups of registered and unknown names, the rest split over update, remove and insert
+    unsigned int seed = 7;
+    failed = 0;
+    start = steady_clock::now();
+    latencies = runPhase(clients, depth, total, [&](string& out, int) {
+        seed = seed * 1103515245 + 12345;
+        int pick = (seed >> 8) % patients;
+        int roll = (seed >> 4) % 100;
+        string name = patientName(pick);
+        int serial = MINSERIAL + pick % SERIALS;
+        if (roll < getPercent)
+            encodeRequest(out, OPGET, (roll % 10 == 0) ? name + " jr" : name, serial);
+        else if (roll % 3 == 0)
+            encodeRequest(out, OPUPDATE, name, serial, serial);
+        else if (roll % 3 == 1)
+            encodeRequest(out, OPREMOVE, name, serial);
+        else
+            encodeRequest(out, OPINSERT, name, serial);
+    }, failed);
+    report("mixed", latencies, duration_cast<nanoseconds>(steady_clock::now() - start).count() / 1e9, failed);
+
+    for (Client& client : clients)
+        close(client.fd);
+    return 0;
+}
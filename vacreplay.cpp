@@ -0,0 +1,130 @@
+// CMSC 341 - Spring 2024 - Project 4
+// Replays an operation trace against a fresh VacDB at full speed
+// build: g++ -std=c++17 -O2 -pthread vacdb.cpp slotbook.cpp prefixindex.cpp fuzzyindex.cpp exportwriter.cpp serialallocator.cpp namefilter.cpp tracelog.cpp timingwheel.cpp frozendb.cpp pagealloc.cpp changestream.cpp snapshot.cpp vacreplay.cpp -o vacreplay
+// usage: ./vacreplay trace [policy] [capacity], policy and capacity default to the recorded ones
+#include "vacdb.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+using namespace std::chrono;
+
+unsigned int hashCode(const string str) {
+   unsigned int val = 0 ;
+   const unsigned int thirtyThree = 33 ;  // magic number from textbook
+   for (unsigned int i = 0 ; i < str.length(); i++)
+      val = val * thirtyThree + str[i] ;
+   return val ;
+}
+
+const char* policyNames[] = {"QUADRATIC", "DOUBLEHASH", "LINEAR", "ROBINHOOD", "CUCKOO"};
+const char* opNames[] = {"", "open", "seed", "insert", "remove", "get", "update", "policy", "rehash",
+                         "deadline", "expire", "wheel", "maxload", "book"};
+const int BUCKETS = 40;     // log2 latency buckets, bucket b holds [2^b, 2^(b+1)) ns
+
+struct RehashEvent{
+    size_t op;
+    int fromCap;
+    int toCap;
+    long long nanos;        // latency of the operation that rehashed
+};
+
+// prints count, percentiles and the log2 histogram of one kind of operation
+void printOp(const char* name, vector<long long>& latencies) {
+    if (latencies.empty()) return;
+    sort(latencies.begin(), latencies.end());
+    long long total = 0;
+    for (long long ns : latencies) total += ns;
+    auto at = [&](double q) {return latencies[min(latencies.size() - 1, (size_t)(q * latencies.size()))];};
+    printf("%-7s %9zu ops  mean %7.0f ns  p50 %6lld  p99 %7lld  p99.9 %8lld  max %9lld ns\n", name,
+           latencies.size(), (double)total / latencies.size(), at(0.5), at(0.99), at(0.999), latencies.back());
+    long long counts[BUCKETS] = {0};
+    for (long long ns : latencies)
+        counts[min(BUCKETS - 1, 63 - __builtin_clzll(max(ns, 1LL)))]++;
+    for (int b = 0; b < BUCKETS; b++) {
+        if (counts[b] == 0) continue;
+        int width = (int)(50.0 * counts[b] / latencies.size() + 0.5);
+        printf("    %9lld ns  %9lld  %s\n", 1LL << b, counts[b], string(width, '#').c_str());
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "usage: " << argv[0] << " trace [policy] [capacity]" << endl;
+        return 1;
+    }
+    int fd = open(argv[1], O_RDONLY);
+    vector<TraceEntry> entries;
+    if (fd == -1 || !readTrace(fd, entries)) {
+        cerr << "cannot read a complete trace from " << argv[1] << endl;
+        if (entries.empty()) return 1;
+    }
+    if (fd != -1) close(fd);
+
+    int capacity = MINPRIME;
+    prob_t policy = DEFPOLCY;
+    // compactions may rebuild at the same capacity, only changes are comparable
+    int recordedRehashes = 0;
+    int recordedCap = 0;
+    for (const TraceEntry& entry : entries) {
+        if (entry.op == TRACEOPEN) {
+            capacity = recordedCap = entry.serial;
+            policy = (prob_t)entry.arg;
+        } else if (entry.op == TRACEREHASH && entry.serial != recordedCap) {
+            recordedCap = entry.serial;
+            recordedRehashes++;
+        }
+    }
+    for (int p = 0; argc > 2 && p < 5; p++) {
+        if (strcasecmp(argv[2], policyNames[p]) == 0)
+            policy = (prob_t)p;
+    }
+    if (argc > 3)
+        capacity = atoi(argv[3]);
+
+    // the leading patients and their deadlines make up the starting table
+    VacDB db(capacity, hashCode, policy);
+    size_t seeded = 0;
+    size_t first = 0;
+    for (; first < entries.size(); first++) {
+        trace_t op = entries[first].op;
+        if (op != TRACEOPEN && op != TRACEMAXLOAD && op != TRACEWHEEL && op != TRACESEED && op != TRACEDEADLINE) break;
+        applyTraceEntry(db, entries[first]);
+        seeded += (op == TRACESEED);
+    }
+    printf("%zu records, %zu seeded patients, replaying on %s with capacity %d\n",
+           entries.size(), seeded, policyNames[policy], db.capacity());
+
+    vector<vector<long long>> latencies(TRACEBOOK + 1);
+    vector<RehashEvent> rehashes;
+    long long diverged = 0;
+    auto start = steady_clock::now();
+    for (size_t i = first; i < entries.size(); i++) {
+        const TraceEntry& entry = entries[i];
+        if (entry.op < TRACEINSERT || entry.op == TRACEREHASH) continue;
+        int before = db.capacity();
+        auto t0 = steady_clock::now();
+        bool outcome = applyTraceEntry(db, entry);
+        auto t1 = steady_clock::now();
+        long long ns = duration_cast<nanoseconds>(t1 - t0).count();
+        latencies[entry.op].push_back(ns);
+        diverged += (outcome != entry.outcome);
+        if (db.capacity() != before)
+            rehashes.push_back({i, before, db.capacity(), ns});
+    }
+    double seconds = duration_cast<nanoseconds>(steady_clock::now() - start).count() / 1e9;
+
+    size_t replayed = 0;
+    for (int op = TRACEINSERT; op <= TRACEBOOK; op++) {
+        replayed += latencies[op].size();
+        printOp(opNames[op], latencies[op]);
+    }
+    printf("%zu operations in %.3f s (%.0f ops/s), %lld outcomes differ from the recording\n",
+           replayed, seconds, replayed / seconds, diverged);
+    printf("%zu capacity changes in the replay, %d in the recording\n", rehashes.size(), recordedRehashes);
+    for (const RehashEvent& event : rehashes)
+        printf("    op %9zu  %9d -> %9d buckets  %9.2f ms\n", event.op, event.fromCap, event.toCap, event.nanos / 1e6);
+    return 0;
+}
@@ -0,0 +1,44 @@
+// CMSC 341 - Spring 2024 - Project 4
+// Request server that owns one VacDB for all check-in stations
+// build: g++ -std=c++17 -O2 -pthread vacdb.cpp slotbook.cpp prefixindex.cpp fuzzyindex.cpp exportwriter.cpp serialallocator.cpp namefilter.cpp tracelog.cpp timingwheel.cpp frozendb.cpp pagealloc.cpp changestream.cpp snapshot.cpp protocol.cpp requestserver.cpp vacserver.cpp -o vacserver
+// usage: ./vacserver [socket path | tcp port], listens on /tmp/vacdb.sock by default
+#include "requestserver.h"
+#include <csignal>
+#include <cstdlib>
+
+unsigned int hashCode(const string str) {
+   unsigned int val = 0 ;
+   const unsigned int thirtyThree = 33 ;  // magic number from textbook
+   for (unsigned int i = 0 ; i < str.length(); i++)
+      val = val * thirtyThree + str[i] ;
+   return val ;
+}
+
+RequestServer* server = nullptr;
+
+void onSignal(int) {
+    if (server != nullptr)
+        server->stop();
+}
+
+int main(int argc, char* argv[]) {
+    string where = (argc > 1) ? argv[1] : SERVERSOCKET;
+    VacDB db(MINPRIME, hashCode, DOUBLEHASH);
+    db.enableFilter(true);
+    RequestServer requestServer(db);
+    bool tcp = where.find_first_not_of("0123456789") == string::npos;
+    if (tcp ? !requestServer.listenTcp(atoi(where.c_str())) : !requestServer.listenUnix(where)) {
+        cerr << "cannot listen on " << where << endl;
+        return 1;
+    }
+    server = &requestServer;
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    signal(SIGPIPE, SIG_IGN);
+    cout << "listening on " << (tcp ? "127.0.0.1:" : "") << where << endl;
+    requestServer.run();
+    cout << requestServer.requests() << " requests in " << requestServer.batches() << " batches ("
+         << (requestServer.batches() ? requestServer.requests() / (double)requestServer.batches() : 0)
+         << " per batch)" << endl;
+    return 0;
+}
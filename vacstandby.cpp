@@ -0,0 +1,69 @@
+// CMSC 341 - Spring 2024 - Project 4
+// Hot standby: applies the change stream of a primary VacDB to its own copy
+// build: g++ -std=c++17 -O2 -pthread vacdb.cpp slotbook.cpp prefixindex.cpp fuzzyindex.cpp exportwriter.cpp serialallocator.cpp namefilter.cpp tracelog.cpp timingwheel.cpp frozendb.cpp pagealloc.cpp changestream.cpp snapshot.cpp vacstandby.cpp -o vacstandby
+// usage: ./vacstandby segment, the name the primary passed to startStream
+#include "vacdb.h"
+#include <chrono>
+#include <sched.h>
+#include <unistd.h>
+using namespace std::chrono;
+
+unsigned int hashCode(const string str) {
+   unsigned int val = 0 ;
+   const unsigned int thirtyThree = 33 ;  // magic number from textbook
+   for (unsigned int i = 0 ; i < str.length(); i++)
+      val = val * thirtyThree + str[i] ;
+   return val ;
+}
+
+const int IDLESPINS = 1000;         // empty polls before the standby starts sleeping
+const int IDLESLEEP = 100;          // microseconds slept per empty poll after that
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "usage: " << argv[0] << " segment" << endl;
+        return 1;
+    }
+    ChangeReader reader;
+    while (!reader.open(argv[1]))
+        usleep(10000);          // the primary has not started streaming yet
+
+    VacDB* db = nullptr;
+    long long applied = 0, diverged = 0;
+    int idle = 0;
+    auto report = steady_clock::now() + seconds(1);
+    TraceEntry entry;
+    while (!reader.closed()) {
+        if (!reader.next(entry)) {
+            // poll hard for a while so a burst is picked up at once, then back off
+            if (++idle < IDLESPINS) sched_yield();
+            else usleep(IDLESLEEP);
+        } else {
+            idle = 0;
+            if (entry.op == TRACEOPEN) {
+                delete db;
+                db = new VacDB(entry.serial, hashCode, (prob_t)entry.arg);
+            } else if (db != nullptr) {
+                diverged += !db->applyChange(entry);
+            }
+            applied++;
+        }
+        if ((applied & 1023) == 0 && steady_clock::now() > report) {
+            printf("%lld changes applied, %lld diverged, at byte %llu\n", applied, diverged,
+                   (unsigned long long)reader.position());
+            fflush(stdout);
+            report = steady_clock::now() + seconds(1);
+        }
+    }
+
+    long long patients = 0;
+    if (db != nullptr)
+        db->forEach([&patients](const Patient&) {patients++;});
+    printf("%lld changes applied, %lld diverged\n", applied, diverged);
+    if (reader.lost())
+        printf("stream lost: the standby fell a whole ring behind and must be seeded again\n");
+    else
+        printf("primary closed the stream, the standby holds %lld patients\n", patients);
+    delete db;
+    return reader.lost() ? 2 : 0;
+}
@@ -0,0 +1,256 @@
+// CMSC 341 - Spring 2024 - Project 4
+#include "workload.h"
+#include "vacdb.h"
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <unordered_set>
+
+// SplitMix64, a counter based generator: every value is a pure function of the state
+static uint64_t splitMix(uint64_t& state) {
+    uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// Returns a number below bound from 64 random bits
+static uint64_t below(uint64_t bits, uint64_t bound) {
+    return (uint64_t)(((unsigned __int128)bits * bound) >> 64);
+}
+
+
+/**
+ * Name: ZipfTable Constructor
+ * Desc: Builds the alias table with Vose's method: columns below the average weight are
+ *       topped up from columns above it, so each column holds at most two ranks.
+ * Preconditions: n is at least 1 and s is not negative.
+ * Postconditions: sample returns rank r with probability (r + 1)^-s over the sum of them all.
+ */
+ZipfTable::ZipfTable(int n, double s) : m_threshold(n), m_alias(n) {
+    vector<double> weight(n);
+    double total = 0;
+    for (int r = 0; r < n; r++)
+        total += weight[r] = pow(r + 1.0, -s);
+    vector<int> small, large;
+    for (int r = 0; r < n; r++) {
+        weight[r] *= n / total;
+        (weight[r] < 1.0 ? small : large).push_back(r);
+    }
+    while (!small.empty() && !large.empty()) {
+        int low = small.back(), high = large.back();
+        small.pop_back();
+        m_threshold[low] = (uint32_t)(weight[low] * 4294967296.0);
+        m_alias[low] = high;
+        weight[high] -= 1.0 - weight[low];
+        if (weight[high] < 1.0) {
+            large.pop_back();
+            small.push_back(high);
+        }
+    }
+    // what is left is 1 up to rounding
+    for (int r : small) {m_threshold[r] = UINT32_MAX; m_alias[r] = r;}
+    for (int r : large) {m_threshold[r] = UINT32_MAX; m_alias[r] = r;}
+}
+
+
+int ZipfTable::sample(uint64_t bits) const {
+    // the high half picks the column, the low half tosses the coin
+    uint32_t column = (uint32_t)(((bits >> 32) * m_alias.size()) >> 32);
+    return ((uint32_t)bits < m_threshold[column]) ? column : m_alias[column];
+}
+
+
+/**
+ * Name: Workload Constructor
+ * Desc: Builds the name corpus and the shares of a full chunk. Surnames are every two and
+ *       three syllable word, in a fixed shuffled order so the popular ones vary in length.
+ * Preconditions: The shares are not negative and not all 0.
+ * Postconditions: The corpus does not depend on the seed, only the draws from it do.
+ */
+Workload::Workload(const WorkloadConfig& config) : m_config(config) {
+    static const char* given[] = {"john", "serina", "mike", "celina", "alexander", "jessica",
+        "maria", "james", "linda", "robert", "patricia", "david", "jennifer", "william",
+        "elizabeth", "richard", "susan", "joseph", "karen", "thomas", "nancy", "daniel",
+        "lisa", "matthew", "betty", "anthony", "sandra", "mark", "ashley", "steven",
+        "emily", "paul", "donna", "andrew", "michelle", "joshua", "carol", "kevin", "amanda",
+        "brian", "melissa", "george", "deborah", "edward", "stephanie", "ronald", "rebecca",
+        "timothy", "laura", "jason", "sharon", "jeffrey", "cynthia", "ryan", "kathleen",
+        "jacob", "amy", "gary", "angela", "nicholas"};
+    static const char* syllables[] = {"an", "ber", "cal", "do", "er", "fin", "gar", "hol",
+        "in", "jo", "kel", "lan", "mor", "nel", "os", "per", "qui", "ros", "son", "ter",
+        "ul", "van", "wel", "xi", "yor", "zan", "ste", "mac", "ley", "ford", "ton", "ham"};
+    m_given.assign(begin(given), end(given));
+    for (const char* first : syllables) {
+        for (const char* second : syllables) {
+            m_surnames.push_back(string(first) + second);
+            for (const char* third : syllables)
+                m_surnames.push_back(string(first) + second + third);
+        }
+    }
+    shuffle(m_surnames.begin(), m_surnames.end(), mt19937(341));
+    m_surnames.resize(max(1, min<int>(m_config.surnames, m_surnames.size())));
+    m_givenZipf = ZipfTable(m_given.size(), m_config.zipf);
+    m_surnameZipf = ZipfTable(m_surnames.size(), m_config.zipf);
+
+    long long total = m_config.insertShare + m_config.searchShare + m_config.cancelShare;
+    m_insertsPerChunk = (int)(WORKCHUNK * m_config.insertShare / total);
+    m_searchesPerChunk = (int)(WORKCHUNK * m_config.searchShare / total);
+}
+
+
+long long Workload::chunks() const {
+    return (m_config.operations + WORKCHUNK - 1) / WORKCHUNK;
+}
+
+
+// builds the name of a patient into name, reusing its buffer. Returns the name ranks and
+// serial packed in one number, equal only for patients that VacDB takes as the same
+uint64_t Workload::nameOf(long long patient, string& name) const {
+    uint64_t state = m_config.seed * 0xd1342543de82ef95ULL + patient;
+    uint64_t first = m_givenZipf.sample(splitMix(state));
+    uint64_t last = m_surnameZipf.sample(splitMix(state));
+    name.assign(m_given[first]);
+    name += ' ';
+    name += m_surnames[last];
+    return ((first * m_surnames.size() + last) << 14) | (uint64_t)(patientSerial(patient) - MINID);
+}
+
+
+string Workload::patientName(long long patient) const {
+    string name;
+    nameOf(patient, name);
+    return name;
+}
+
+
+int Workload::patientSerial(long long patient) const {
+    uint64_t state = m_config.seed * 0xd1342543de82ef95ULL + patient;
+    splitMix(state);
+    splitMix(state);
+    return MINID + (int)below(splitMix(state), MAXID - MINID + 1);
+}
+
+
+/**
+ * Name: generate
+ * Desc: Lays out the operation kinds of a chunk in their exact shares, shuffles them with a
+ *       generator seeded by the chunk number, then fills in the patients. The first patient
+ *       a chunk inserts is chunk times the inserts of a full chunk, since only the last chunk
+ *       may be short. Searches and cancels take any patient inserted before them, so popular
+ *       names are searched and cancelled as often as they are inserted. Those with nobody to
+ *       take, at the very start, name a negative patient, which is never inserted.
+ * Preconditions: chunk is below chunks().
+ * Postconditions: ops holds the operations of the chunk and identities the identity of the
+ *                 patient of each. The vectors and the name buffers are reused, so passing
+ *                 the same vectors for every chunk allocates little.
+ */
+void Workload::generate(long long chunk, vector<TraceEntry>& ops, vector<uint64_t>& identities) const {
+    const int count = (int)min<long long>(WORKCHUNK, m_config.operations - chunk * WORKCHUNK);
+    long long total = m_config.insertShare + m_config.searchShare + m_config.cancelShare;
+    const int inserts = (count == WORKCHUNK) ? m_insertsPerChunk : (int)(count * m_config.insertShare / total);
+    const int searches = (count == WORKCHUNK) ? m_searchesPerChunk : (int)(count * m_config.searchShare / total);
+    ops.resize(count);
+    identities.resize(count);
+    for (int i = 0; i < count; i++)
+        ops[i].op = (i < inserts) ? TRACEINSERT : (i < inserts + searches) ? TRACEGET : TRACEREMOVE;
+    uint64_t state = m_config.seed ^ (0x632be59bd9b4e019ULL * (chunk + 1));
+    for (int i = count - 1; i > 0; i--)
+        swap(ops[i].op, ops[below(splitMix(state), i + 1)].op);
+
+    long long inserted = chunk * m_insertsPerChunk;
+    for (int i = 0; i < count; i++) {
+        TraceEntry& entry = ops[i];
+        long long patient = -1 - (chunk * WORKCHUNK + i);
+        entry.outcome = false;
+        if (entry.op == TRACEINSERT) {
+            patient = inserted++;
+            entry.outcome = true;
+        } else if (inserted > 0) {
+            patient = (long long)below(splitMix(state), inserted);
+            entry.outcome = true;
+        }
+        identities[i] = nameOf(patient, entry.name);
+        entry.serial = patientSerial(patient);
+        entry.arg = 0;
+    }
+}
+
+
+void Workload::generate(long long chunk, vector<TraceEntry>& ops) const {
+    vector<uint64_t> identities;
+    generate(chunk, ops, identities);
+}
+
+
+/**
+ * Name: run
+ * Desc: Workers take chunk numbers in order and fill a window of buffers, two per worker,
+ *       while the calling thread hands the finished buffers to the sink in chunk order. A
+ *       worker waits when its chunk would overwrite a buffer the sink has not taken yet.
+ *       Before that the calling thread sets the outcomes from a set of the identities of the
+ *       live patients: an insert fails if the patient is live, a search or cancel if not.
+ * Preconditions: sink does not keep references into the vector it is given.
+ * Postconditions: sink has seen every chunk once, in order.
+ */
+void Workload::run(int threads, const function<void(vector<TraceEntry>&)>& sink) const {
+    if (threads <= 0)
+        threads = max(1u, thread::hardware_concurrency());
+    const long long total = chunks();
+    const int window = 2 * threads;
+    vector<vector<TraceEntry>> buffers(window);
+    vector<vector<uint64_t>> identities(window);
+    vector<long long> ready(window, -1);       // chunk a buffer holds, -1 while it is filled
+    long long next = 0;                         // next chunk to generate
+    long long taken = 0;                        // chunks the sink is done with
+    mutex lock;
+    condition_variable changed;
+    unordered_set<uint64_t> live;               // identities of the patients stored
+    live.reserve(m_config.operations * m_config.insertShare /
+                 (m_config.insertShare + m_config.searchShare + m_config.cancelShare));
+
+    auto work = [&]() {
+        while (true) {
+            long long chunk;
+            {
+                unique_lock<mutex> guard(lock);
+                changed.wait(guard, [&]() {return next >= total || next < taken + window;});
+                if (next >= total) return;
+                chunk = next++;
+            }
+            generate(chunk, buffers[chunk % window], identities[chunk % window]);
+            lock_guard<mutex> guard(lock);
+            ready[chunk % window] = chunk;
+            changed.notify_all();
+        }
+    };
+    vector<thread> workers;
+    for (int t = 0; t < threads; t++)
+        workers.emplace_back(work);
+    for (long long chunk = 0; chunk < total; chunk++) {
+        {
+            unique_lock<mutex> guard(lock);
+            changed.wait(guard, [&]() {return ready[chunk % window] == chunk;});
+        }
+        vector<TraceEntry>& ops = buffers[chunk % window];
+        const vector<uint64_t>& ids = identities[chunk % window];
+        for (size_t i = 0; i < ops.size(); i++) {
+            if (ops[i].op == TRACEINSERT)
+                ops[i].outcome = live.insert(ids[i]).second;
+            else if (ops[i].op == TRACEGET)
+                ops[i].outcome = live.count(ids[i]) > 0;
+            else
+                ops[i].outcome = live.erase(ids[i]) > 0;
+        }
+        sink(ops);
+        lock_guard<mutex> guard(lock);
+        ready[chunk % window] = -1;
+        taken++;
+        changed.notify_all();
+    }
+    for (thread& worker : workers)
+        worker.join();
+}
@@ -0,0 +1,74 @@
+// CMSC 341 - Spring 2024 - Project 4
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+#include "tracelog.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+using namespace std;
+const int WORKCHUNK = 1 << 16;      // operations of a chunk, the unit of work of a thread
+
+// Samples ranks 0..n-1 with probability proportional to 1 / (rank + 1)^s
+// in constant time with Walker's alias method
+class ZipfTable{
+    public:
+    ZipfTable(int n = 1, double s = 1.0);
+    // maps 64 random bits to a rank
+    int sample(uint64_t bits) const;
+    int size() const {return (int)m_alias.size();}
+    private:
+    vector<uint32_t> m_threshold;   // chance of keeping the column, scaled to 32 bits
+    vector<uint32_t> m_alias;
+};
+
+// What to generate. The shares are relative weights, 50:40:10 by default
+struct WorkloadConfig{
+    uint64_t seed;
+    long long operations;
+    int insertShare;
+    int searchShare;
+    int cancelShare;
+    double zipf;                    // exponent of name popularity, 0 for uniform
+    int surnames;                   // size of the surname corpus, at most 33792
+};
+const WorkloadConfig DEFWORKLOAD = {1, 1000000, 50, 40, 10, 0.7, 33792};
+
+// Deterministic synthetic population and operation mix for load tests.
+// Patient k gets a name and serial from a hash of (seed, k): a given name
+// and a surname, each drawn from a Zipf distribution over a fixed corpus,
+// so common names collide the way they do at a real site. Operations come
+// in chunks of WORKCHUNK with exactly the configured shares in a shuffled
+// order, so the number of patients inserted before any chunk is known and
+// every chunk can be generated on its own. Searches and cancels pick any
+// patient inserted earlier and name it by name and serial. run() tracks
+// the live patients, so every expected outcome is exact. The output
+// depends only on the config, never on the number of threads.
+class Workload{
+    public:
+    explicit Workload(const WorkloadConfig& config);
+    long long chunks() const;
+    // replaces ops with the operations of a chunk as TRACEINSERT, TRACEGET and
+    // TRACEREMOVE entries, outcome true where they name an inserted patient.
+    // Whether that patient is still stored only run() knows
+    void generate(long long chunk, vector<TraceEntry>& ops) const;
+    // generates every chunk on threads workers (0 for every core) and passes
+    // them to sink in order, on the calling thread, with exact outcomes.
+    // The sink may run the entries in place, e.g. with VacDB::runBatch
+    void run(int threads, const function<void(vector<TraceEntry>&)>& sink) const;
+    string patientName(long long patient) const;
+    int patientSerial(long long patient) const;
+
+    private:
+    WorkloadConfig m_config;
+    int m_insertsPerChunk;
+    int m_searchesPerChunk;
+    vector<string> m_given;
+    vector<string> m_surnames;
+    ZipfTable m_givenZipf;
+    ZipfTable m_surnameZipf;
+
+    uint64_t nameOf(long long patient, string& name) const;
+    void generate(long long chunk, vector<TraceEntry>& ops, vector<uint64_t>& identities) const;
+};
+#endif